@@ -0,0 +1,75 @@
+/**
+ * Checks decoder.ts against the fixtures written by
+ * `make -C src/program-c fixtures`, which hold accounts built through the
+ * program and the records the program reads from them.
+ *
+ * Usage: ts-node src/client/check_decoder.ts FIXTURES_PREFIX
+ */
+
+import fs from 'mz/fs';
+import {postRecords, recordText, PostRecord} from './decoder';
+import {compressBody, decompressBody} from './compression';
+
+// Key and data length that precede each account in the dump
+const DUMP_KEY_SIZE = 32;
+const DUMP_HEADER_SIZE = DUMP_KEY_SIZE + 8;
+
+function recordJson(record: PostRecord | null): any {
+  if (record === null) {
+    return null;
+  }
+  const counters = record.counters;
+  return {
+    index: record.index,
+    slot: record.slot,
+    selector: String.fromCharCode(record.selector),
+    redacted: record.redacted,
+    counters: counters && [counters.likes, counters.replies, counters.reports],
+    target: record.target && {
+      poster: record.target.poster.toString('hex'),
+      index: record.target.index,
+    },
+    body: record.body.toString('hex'),
+    compressed: record.compressed,
+    text: recordText(record)!.toString('hex'),
+  };
+}
+
+async function main() {
+  const prefix = process.argv[2];
+  const dump = await fs.readFile(prefix + '.bin');
+  const expected = JSON.parse(await fs.readFile(prefix + '.json', 'utf8'));
+  let failures = 0;
+  let offset = 0;
+  for (const account of expected) {
+    const key = dump.subarray(offset, offset + DUMP_KEY_SIZE).toString('hex');
+    const length = Number(dump.readBigUInt64LE(offset + DUMP_KEY_SIZE));
+    const data = dump.subarray(offset + DUMP_HEADER_SIZE, offset + DUMP_HEADER_SIZE + length);
+    offset += DUMP_HEADER_SIZE + length;
+    const records = [...postRecords(data)];
+    const decoded = JSON.stringify({key, records: records.map(recordJson)});
+    if (decoded != JSON.stringify(account)) {
+      console.log('Mismatch for account', account.key);
+      console.log('  expected', JSON.stringify(account.records));
+      console.log('  decoded ', decoded);
+      failures++;
+    }
+    // Every body survives a round trip through the client's compressor
+    for (const record of records) {
+      const text = record && recordText(record);
+      if (text && text.length > 0 && !decompressBody(compressBody(text))!.equals(text)) {
+        console.log('Compression round trip failed for', account.key, record!.index);
+        failures++;
+      }
+    }
+  }
+  console.log(`${expected.length - failures}/${expected.length} fixture accounts decoded`);
+  if (failures > 0) {
+    process.exit(1);
+  }
+}
+
+main().catch(err => {
+  console.error(err);
+  process.exit(1);
+});
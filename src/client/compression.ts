@@ -0,0 +1,144 @@
+/**
+ * Compressed post bodies
+ *
+ * Implements the compressed body format described in helloworld.c: a
+ * uint16 decoded length followed by literal, dictionary word and match
+ * tokens. The program only validates these bodies, the client encodes
+ * them and decodes them for display.
+ */
+
+import * as layout from './layout';
+
+const MAX_LITERAL_RUN = layout.LITERAL_TOKEN_LIMIT;
+const MAX_MATCH = layout.MIN_BODY_MATCH + (0xff - layout.WORD_TOKEN_LIMIT);
+const MAX_DISTANCE = 0xffff;
+
+/**
+ * Decode a compressed body, or return null if it is malformed
+ */
+export function decompressBody(body: Buffer): Buffer | null {
+  if (body.length < 2) {
+    return null;
+  }
+  const out = Buffer.alloc(body.readUInt16LE(0));
+  let decoded = 0;
+  let i = 2;
+  while (i < body.length) {
+    const token = body[i++];
+    if (token < layout.LITERAL_TOKEN_LIMIT) {
+      const n = token + 1;
+      if (n > body.length - i || n > out.length - decoded) {
+        return null;
+      }
+      decoded += body.copy(out, decoded, i, i + n);
+      i += n;
+    } else if (token < layout.WORD_TOKEN_LIMIT) {
+      const word = layout.BODY_DICTIONARY[token - layout.LITERAL_TOKEN_LIMIT];
+      if (word.length > out.length - decoded) {
+        return null;
+      }
+      decoded += word.copy(out, decoded);
+    } else {
+      if (body.length - i < 2) {
+        return null;
+      }
+      const distance = body.readUInt16LE(i);
+      i += 2;
+      const n = token - layout.WORD_TOKEN_LIMIT + layout.MIN_BODY_MATCH;
+      if (distance == 0 || distance > decoded || n > out.length - decoded) {
+        return null;
+      }
+      // Byte by byte, since matches may overlap the bytes they produce
+      for (let j = 0; j < n; j++, decoded++) {
+        out[decoded] = out[decoded - distance];
+      }
+    }
+  }
+  return decoded == out.length ? out : null;
+}
+
+/**
+ * Compress a body of at most 65535 bytes. Greedily takes the longest of a
+ * dictionary word and a match found through a hash of the next 4 bytes.
+ */
+export function compressBody(text: Buffer): Buffer {
+  const tokens: number[] = [];
+  const recent = new Map<number, number>();
+  let literalStart = 0;
+  const flushLiterals = (end: number) => {
+    while (literalStart < end) {
+      const n = Math.min(end - literalStart, MAX_LITERAL_RUN);
+      tokens.push(n - 1);
+      for (let j = 0; j < n; j++) {
+        tokens.push(text[literalStart + j]);
+      }
+      literalStart += n;
+    }
+  };
+
+  let i = 0;
+  while (i < text.length) {
+    let word = -1;
+    let wordLength = 1;
+    layout.BODY_DICTIONARY.forEach((entry, w) => {
+      if (
+        entry.length > wordLength &&
+        i + entry.length <= text.length &&
+        text.compare(entry, 0, entry.length, i, i + entry.length) == 0
+      ) {
+        word = w;
+        wordLength = entry.length;
+      }
+    });
+    let matchLength = 0;
+    let distance = 0;
+    if (i + layout.MIN_BODY_MATCH <= text.length) {
+      const key = text.readUInt32LE(i);
+      const candidate = recent.get(key);
+      recent.set(key, i);
+      if (candidate !== undefined && i - candidate <= MAX_DISTANCE) {
+        while (
+          matchLength < MAX_MATCH &&
+          i + matchLength < text.length &&
+          text[candidate + matchLength] == text[i + matchLength]
+        ) {
+          matchLength++;
+        }
+        distance = i - candidate;
+      }
+    }
+    // A word token saves wordLength - 1 bytes, a match matchLength - 3
+    if (matchLength >= layout.MIN_BODY_MATCH && matchLength - 3 >= wordLength - 1) {
+      flushLiterals(i);
+      tokens.push(layout.WORD_TOKEN_LIMIT + matchLength - layout.MIN_BODY_MATCH, distance & 0xff, distance >> 8);
+      i += matchLength;
+      literalStart = i;
+    } else if (word >= 0) {
+      flushLiterals(i);
+      tokens.push(layout.LITERAL_TOKEN_LIMIT + word);
+      i += wordLength;
+      literalStart = i;
+    } else {
+      i++;
+    }
+  }
+  flushLiterals(text.length);
+
+  const body = Buffer.alloc(2 + tokens.length);
+  body.writeUInt16LE(text.length, 0);
+  Buffer.from(tokens).copy(body, 2);
+  return body;
+}
+
+/**
+ * The body to send for text: compressed if that is shorter
+ */
+export function encodeBody(text: Buffer): {compressed: boolean; body: Buffer} {
+  if (text.length > 0 && text.length <= 0xffff) {
+    const body = compressBody(text);
+    if (body.length < text.length) {
+      return {compressed: true, body};
+    }
+  }
+  return {compressed: false, body: text};
+}
@@ -0,0 +1,220 @@
+/**
+ * Zero-copy decoder for user accounts and continuation pages
+ *
+ * Follows the post format and user account layout described in
+ * helloworld.c through the generated offsets in layout.ts. Records are
+ * read in place: bodies and poster keys are Buffer views into the account
+ * data, so nothing is copied until a caller converts them.
+ */
+
+import * as layout from './layout';
+import {decompressBody} from './compression';
+
+/**
+ * A post referenced by a reply, like or report
+ */
+export interface RecordTarget {
+  poster: Buffer;
+  index: number;
+}
+
+/**
+ * A single record of a user account or page
+ */
+export interface PostRecord {
+  index: number; // PostID index
+  slot: number | null; // Clock slot the record was written in, if stamped
+  selector: number; // without COUNTERS_FLAG, REDACTED_FLAG and COMPRESSED_FLAG
+  redacted: boolean;
+  compressed: boolean; // body is in the compressed body format
+  counters: {likes: number; replies: number; reports: number} | null;
+  target: RecordTarget | null;
+  body: Buffer;
+}
+
+/**
+ * Header fields the decoder needs from a user account or page
+ */
+export interface PostAccountHeader {
+  accountType: number;
+  legacy: boolean; // version 1 account from before the post index
+  current: boolean; // version 2 layout, whose records may carry slot stamps
+  idSize: number; // width of the PostIDs stored in records
+  numPosts: number;
+  firstPost: number; // PostID index of the first post stored here
+  tailOffset: number;
+}
+
+/**
+ * Header of a user account or page, or null for any other account
+ */
+export function decodePostAccountHeader(data: Buffer): PostAccountHeader | null {
+  if (data.length < layout.USER_V1_HEADER_SIZE) {
+    return null;
+  }
+  const accountType = data.readUInt8(layout.AccountMetadata.accountType);
+  const current = data.readUInt8(layout.AccountMetadata.version) == layout.USER_VERSION_2;
+  if (current && data.length < layout.AccountMetadata.size) {
+    return null;
+  }
+  const tailOffset = data.readUInt32LE(layout.AccountMetadata.tailOffset);
+  if (accountType == layout.USER_PAGE_ACCOUNT_TYPE) {
+    return {
+      accountType,
+      legacy: false,
+      current: true,
+      idSize: layout.PostID.size,
+      numPosts: data.readUInt32LE(layout.UserPageMeta.numPosts),
+      firstPost: data.readUInt32LE(layout.UserPageMeta.firstPost),
+      tailOffset,
+    };
+  }
+  if (accountType != layout.USER_ACCOUNT_TYPE) {
+    return null;
+  }
+  return {
+    accountType,
+    legacy: tailOffset == 0,
+    current,
+    idSize: current ? layout.PostID.size : layout.PostIDV1.size,
+    numPosts: current
+      ? data.readUInt32LE(layout.AccountMetadata.numPosts)
+      : data.readUInt16LE(layout.AccountMetadata.numPostsV1),
+    firstPost: 0,
+    tailOffset,
+  };
+}
+
+/**
+ * Parse the record whose length prefix is at offset, mirroring
+ * parseRecord() in helloworld.c. Returns null if it is invalid.
+ */
+export function decodeRecord(
+  data: Buffer,
+  offset: number,
+  idSize: number,
+  index: number,
+): PostRecord | null {
+  if (offset + 2 > data.length) {
+    return null;
+  }
+  const length = data.readUInt16LE(offset);
+  const start = offset + 2;
+  if (length < 2 || start + length > data.length) {
+    return null;
+  }
+  const raw = data.readUInt8(start);
+  let selector = raw & ~(layout.COUNTERS_FLAG | layout.REDACTED_FLAG) & 0xff;
+  const compressed =
+    selector == (layout.POST_SELECTOR | layout.COMPRESSED_FLAG) ||
+    selector == (layout.REPLY_SELECTOR | layout.COMPRESSED_FLAG) ||
+    selector == (layout.REPORT_SELECTOR | layout.COMPRESSED_FLAG);
+  if (compressed) {
+    selector &= ~layout.COMPRESSED_FLAG;
+  }
+  let header = 1;
+  let counters = null;
+  if (raw & layout.COUNTERS_FLAG) {
+    if (selector == layout.LIKE_SELECTOR || length < 1 + layout.PostCounters.size + 1) {
+      return null;
+    }
+    counters = {
+      likes: data.readUInt32LE(start + 1 + layout.PostCounters.likes),
+      replies: data.readUInt32LE(start + 1 + layout.PostCounters.replies),
+      reports: data.readUInt32LE(start + 1 + layout.PostCounters.reports),
+    };
+    header += layout.PostCounters.size;
+  }
+  const end = start + length;
+  const record = {index, slot: null, selector, redacted: (raw & layout.REDACTED_FLAG) != 0, compressed, counters};
+  switch (selector) {
+    case layout.POST_SELECTOR:
+      return {...record, target: null, body: data.subarray(start + header, end)};
+    case layout.REPLY_SELECTOR:
+    case layout.REPORT_SELECTOR:
+      if (length < header + idSize + 1) {
+        return null;
+      }
+      return {
+        ...record,
+        target: decodeTarget(data, start + header, idSize),
+        body: data.subarray(start + header + idSize, end),
+      };
+    case layout.LIKE_SELECTOR:
+      if (length != 1 + idSize) {
+        return null;
+      }
+      return {...record, target: decodeTarget(data, start + 1, idSize), body: data.subarray(end, end)};
+    default:
+      return null;
+  }
+}
+
+function decodeTarget(data: Buffer, offset: number, idSize: number): RecordTarget {
+  const indexOffset = offset + layout.PostID.index;
+  return {
+    poster: data.subarray(offset + layout.PostID.poster, offset + layout.PostID.poster + layout.SIZE_PUBKEY),
+    index: idSize == layout.PostIDV1.size ? data.readUInt16LE(indexOffset) : data.readUInt32LE(indexOffset),
+  };
+}
+
+/**
+ * The record at position i of the post index of a user account or page
+ * that has one, or null if it was dropped by compaction or fails to
+ * parse. Stamped records carry the slot stored right before them.
+ */
+export function postRecordAt(data: Buffer, header: PostAccountHeader, i: number): PostRecord | null {
+  const slot = data.readUInt32LE(data.length - (i + 1) * layout.POST_SLOT_SIZE);
+  // Version 1 records are not aligned, so their offsets keep every bit
+  const stamped = header.current && (slot & layout.STAMPED_RECORD) != 0;
+  const offset = stamped ? slot - layout.STAMPED_RECORD : slot;
+  if (offset == 0 || (stamped && offset < layout.SLOT_STAMP_SIZE)) {
+    return null;
+  }
+  const record = decodeRecord(data, offset, header.idSize, header.firstPost + i);
+  if (record !== null && stamped) {
+    record.slot = Number(data.readBigUInt64LE(offset - layout.SLOT_STAMP_SIZE));
+  }
+  return record;
+}
+
+/**
+ * Every record of a user account or page in PostID order, decoded as it
+ * is reached. Records dropped by compaction or that fail to parse come
+ * back as null, so the position of each entry is its PostID index minus
+ * firstPost. Legacy accounts are walked record by record and stop at the
+ * first one that would overrun the account.
+ */
+export function* postRecords(data: Buffer): Generator<PostRecord | null> {
+  const header = decodePostAccountHeader(data);
+  if (header === null) {
+    return;
+  }
+  if (header.legacy) {
+    // No index, records are packed from the end of the header
+    let offset = layout.USER_V1_HEADER_SIZE;
+    for (let i = 0; i < header.numPosts; i++) {
+      const record = decodeRecord(data, offset, header.idSize, i);
+      if (record === null) {
+        return;
+      }
+      yield record;
+      offset += 2 + data.readUInt16LE(offset);
+    }
+    return;
+  }
+  if (header.numPosts * layout.POST_SLOT_SIZE > data.length) {
+    return;
+  }
+  for (let i = 0; i < header.numPosts; i++) {
+    yield postRecordAt(data, header, i);
+  }
+}
+
+/**
+ * The body text of a record. Only compressed bodies are copied, as they
+ * are decoded; null if a compressed body is malformed.
+ */
+export function recordText(record: PostRecord): Buffer | null {
+  return record.compressed ? decompressBody(record.body) : record.body;
+}
@@ -11,6 +11,7 @@ import {
   PublicKey,
   LAMPORTS_PER_SOL,
   SystemProgram,
+  SYSVAR_CLOCK_PUBKEY,
   TransactionInstruction,
   Transaction,
   sendAndConfirmTransaction,
@@ -23,7 +24,12 @@ const lo = BufferLayout;
 
 import {url, urlTls} from './util/url';
 import {Store} from './util/store';
+import * as layout from './layout';
+import {decodePostAccountHeader, postRecords, recordText} from './decoder';
+import {encodeBody} from './compression';
+import {Timeline} from './timeline';
 import {newAccountWithLamports} from './util/new-account-with-lamports';
+import {PipelineOptions, TransactionPipeline} from './util/transaction-pipeline';
 import BaseConverter from 'base-x';
 const bs58 = BaseConverter("base58");
 /**
@@ -74,66 +80,29 @@ const greetedAccountDataLayout = BufferLayout.struct([
 ]);
 
 function printAccountPosts(d: Buffer) {
-  const postCount = d.readUInt16LE(0);
-  console.log("# of posts on account:", postCount);
-  //const accountData = accountLayout.decode(d);
-  //console.log(accountData.posts);
-  // For now, just print with a for loop
-  let readType = false;
-  let currentPost = "";
-  let i = 2;
-  for(; i < d.length; i++) {
-    // Stop after reading 2 terminators in a row
-    if(d.readUInt8(i) == 0 && d.readUInt8(i - 1) == 0) {
-      return;
-    }
-    if(!readType) {
-      process.stdout.write("Type: " + String.fromCharCode(d.readUInt8(i)));
-      readType = true;
-    }
-    else if(d.readUInt8(i) == 0) {
-      console.log("\tBody:", currentPost);
-      currentPost = "";
-      readType = false;
-    }
-    else {
-      currentPost += String.fromCharCode(d.readUInt8(i));
+  const header = decodePostAccountHeader(d);
+  if (header === null) {
+    console.log("Not a user account");
+    return;
+  }
+  console.log("# of posts on account:", header.numPosts);
+  for (const record of postRecords(d)) {
+    if (record !== null) {
+      console.log("Type: " + String.fromCharCode(record.selector) + "\tBody:", String(recordText(record)));
     }
   }
-  console.log("Account has used", i, "out of", d.length, "available bytes");
+  console.log("Account has used", header.tailOffset, "out of", d.length, "available bytes");
 }
 
 export function arrayOfPosts(d: Buffer, key: PublicKey):string[] {
-  let readType = false;
-  let currentPost = "";
-  let i = 2;
-  let x = 1;
-  const postCount = d.readUInt16LE(0);
-  var ret = new Array("")
-  for(; i < d.length; i++) {
-    // Stop after reading 2 terminators in a row
-    if(d.readUInt8(i) == 0 && d.readUInt8(i - 1) == 0) {
-      return ret;
-    }
-    if(!readType) {
-      // process.stdout.write("Type: " + String.fromCharCode(d.readUInt8(i)));
-      currentPost += "Type: " + String.fromCharCode(d.readUInt8(i)) + " - ";
-      readType = true;
-    }
-    else if(d.readUInt8(i) == 0) {
-      // console.log("\tBody:", currentPost);
-      let toPush = (x + " - " + currentPost + " - Posted By: " + key);
-      x++;
-      ret.push(toPush)
-      currentPost = "";
-      readType = false;
-    }
-    else {
-      currentPost += String.fromCharCode(d.readUInt8(i));
+  const ret: string[] = [];
+  for (const record of postRecords(d)) {
+    if (record === null) {
+      continue;
     }
+    const type = String.fromCharCode(record.selector);
+    ret.push((record.index + 1) + " - Type: " + type + " - " + String(recordText(record)) + " - Posted By: " + key);
   }
-  // console.log("Account has used", i, "out of", d.length, "available bytes");
-  // console.log(ret)
   return ret;
 }
 
@@ -255,6 +224,31 @@ export async function loadProgram(): Promise<void> {
   });
 }
 
+/**
+ * Instruction posting body from the greeted account. The Clock sysvar
+ * goes last so the post is stamped with its slot for the timeline.
+ */
+function helloInstruction(body: string, type: string): TransactionInstruction {
+  let post = Buffer.from("");
+  if (type == "post") {
+    // Compressed when that saves rent
+    const encoded = encodeBody(Buffer.from(body + '\0'));
+    const selector = encoded.compressed ? layout.POST_SELECTOR | layout.COMPRESSED_FLAG : layout.POST_SELECTOR;
+    post = Buffer.concat([Buffer.from([selector]), encoded.body]);
+  }
+  else if (type == "like") {
+    post = Buffer.from('L' + body + '\0');
+  }
+  return new TransactionInstruction({
+    keys: [
+      {pubkey: greetedAccount.publicKey, isSigner: true, isWritable: true},
+      {pubkey: SYSVAR_CLOCK_PUBKEY, isSigner: false, isWritable: false},
+    ],
+    programId,
+    data: post,//Buffer.alloc(0), // All instructions are hellos
+  });
+}
+
 /**
  * Say hello
  */
@@ -268,19 +262,8 @@ export async function sayHello(body: string, type: string): Promise<void> {
   });
   */
   //const post = Buffer.from('Ptest\0');
-  let post = Buffer.from("");
-  if (type == "post") {
-    post = Buffer.from('P' + body + '\0');
-  }
-  else if (type == "like") {
-    post = Buffer.from('L' + body + '\0');
-  }
-  console.log("Length of post:", post.length);
-  const instruction = new TransactionInstruction({
-    keys: [{pubkey: greetedAccount.publicKey, isSigner: true, isWritable: true}],
-    programId,
-    data: post,//Buffer.alloc(0), // All instructions are hellos
-  });
+  const instruction = helloInstruction(body, type);
+  console.log("Length of post:", instruction.data.length);
   await sendAndConfirmTransaction(
     connection,
     new Transaction().add(instruction),
@@ -292,6 +275,30 @@ export async function sayHello(body: string, type: string): Promise<void> {
   );
 }
 
+/**
+ * Post many bodies from the greeted account through a transaction
+ * pipeline, for imports. Posts may land in any order. Returns the number
+ * that confirmed.
+ */
+export async function sayHellos(
+  bodies: string[],
+  options: PipelineOptions = {},
+): Promise<number> {
+  const pipeline = new TransactionPipeline(connection, payerAccount, options);
+  let confirmed = 0;
+  const start = Date.now();
+  for (const body of bodies) {
+    pipeline.submit([helloInstruction(body, "post")], [greetedAccount]).then(
+      () => confirmed++,
+      err => console.log("Post failed:", err.message),
+    );
+  }
+  await pipeline.drain();
+  const seconds = (Date.now() - start) / 1000;
+  console.log("Posted", confirmed, "of", bodies.length, "in", seconds, "s");
+  return confirmed;
+}
+
 /**
  * Report the number of times the greeted account has been said hello to
  */
@@ -330,12 +337,11 @@ async function printAccountData(account: PublicKey): Promise<void> {
  * Report the accounts owned by the program
  */
 export async function reportAccounts(): Promise<void> {
-  const accounts = await connection.getProgramAccounts(programId);
+  const forum = await loadForum();
   console.log("Accounts owned by program:");
-  for(let i = 0; i < accounts.length; i++) {
-    console.log(accounts[i].pubkey.toBase58());
-    let posts = await getArrayOfPosts(accounts[i].pubkey);
-    console.log(posts);
+  for (const user of forum) {
+    console.log(user.pubkey.toBase58());
+    console.log(arrayOfPosts(user.data, user.pubkey));
   }
 }
 
@@ -344,11 +350,250 @@ export async function getArrayOfPosts(pk: PublicKey): Promise<string[]> {
   if (accountInfo === null) {
     throw 'Error: cannot get data for account ';
   }
-  if (arrayOfPosts(accountInfo.data, pk) != null) {
-    return arrayOfPosts(accountInfo.data, pk);
+  return arrayOfPosts(accountInfo.data, pk);
+}
+
+/**
+ * Raw account data returned by the batched fetch helpers
+ */
+export interface FetchedAccount {
+  pubkey: PublicKey;
+  data: Buffer;
+}
+
+// Accounts per getMultipleAccounts call, the RPC node's limit
+const MULTIPLE_ACCOUNTS_BATCH = 100;
+// getMultipleAccounts calls kept in flight at once
+const FETCH_CONCURRENCY = 4;
+
+/**
+ * Send a JSON RPC request through the connection, throwing on RPC errors.
+ * getProgramAccounts filters, dataSlice and getMultipleAccounts are not
+ * all wrapped by the web3.js release this client is pinned to.
+ */
+async function rpcRequest(method: string, params: any[]): Promise<any> {
+  // @ts-ignore
+  const res = await connection._rpcRequest(method, params);
+  if (res.error) {
+    throw new Error(method + ' failed: ' + res.error.message);
   }
-  else {
-    let x: string[] = [""];
-    return x;
+  return res.result;
+}
+
+/**
+ * Program accounts whose first byte is the given account type. With
+ * headerBytes set only that many leading bytes of each account are
+ * downloaded.
+ */
+export async function getProgramAccountsOfType(
+  accountType: number,
+  headerBytes?: number,
+): Promise<FetchedAccount[]> {
+  const config: any = {
+    encoding: 'base64',
+    filters: [{memcmp: {offset: 0, bytes: bs58.encode(Buffer.from([accountType]))}}],
+  };
+  if (headerBytes !== undefined) {
+    config.dataSlice = {offset: 0, length: headerBytes};
   }
+  const result = await rpcRequest('getProgramAccounts', [programId.toBase58(), config]);
+  return result.map((entry: any) => ({
+    pubkey: new PublicKey(entry.pubkey),
+    data: Buffer.from(entry.account.data[0], 'base64'),
+  }));
+}
+
+/**
+ * Data of many accounts in as few round trips as possible. Keys are split
+ * into getMultipleAccounts batches with at most FETCH_CONCURRENCY requests
+ * in flight. Missing accounts and accounts not owned by the program come
+ * back as null, in key order.
+ */
+export async function getMultipleAccounts(keys: PublicKey[]): Promise<(Buffer | null)[]> {
+  const results: (Buffer | null)[] = new Array(keys.length).fill(null);
+  let nextBatch = 0;
+  const worker = async () => {
+    while (nextBatch * MULTIPLE_ACCOUNTS_BATCH < keys.length) {
+      const start = nextBatch++ * MULTIPLE_ACCOUNTS_BATCH;
+      const batch = keys.slice(start, start + MULTIPLE_ACCOUNTS_BATCH);
+      const result = await rpcRequest('getMultipleAccounts', [
+        batch.map(key => key.toBase58()),
+        {encoding: 'base64'},
+      ]);
+      result.value.forEach((info: any, i: number) => {
+        if (info !== null && info.owner == programId.toBase58()) {
+          results[start + i] = Buffer.from(info.data[0], 'base64');
+        }
+      });
+    }
+  };
+  await Promise.all([...Array(FETCH_CONCURRENCY)].map(worker));
+  return results;
+}
+
+/**
+ * Every user account of the forum with its full data. One filtered
+ * getProgramAccounts call lists the users by header only, then the bodies
+ * of accounts that have posts are fetched in batches.
+ */
+export async function loadForum(): Promise<FetchedAccount[]> {
+  const headers = await getProgramAccountsOfType(
+    layout.USER_ACCOUNT_TYPE,
+    layout.AccountMetadata.size,
+  );
+  // Skip the bodies of accounts that have no records
+  const posted = headers.filter(h => {
+    const header = decodePostAccountHeader(h.data);
+    return header === null || header.numPosts > 0;
+  });
+  const bodies = await getMultipleAccounts(posted.map(h => h.pubkey));
+  const forum: FetchedAccount[] = [];
+  posted.forEach((header, i) => {
+    const data = bodies[i];
+    if (data !== null) {
+      forum.push({pubkey: header.pubkey, data});
+    }
+  });
+  return forum;
+}
+
+/**
+ * Aggregate like, reply and report counts of a post
+ */
+export interface PostCounters {
+  likes: number;
+  replies: number;
+  reports: number;
+}
+
+/**
+ * Address of a post's counter shard, derived from the poster's key.
+ * createCounterShard only accepts a shard at this address.
+ */
+export async function counterShardAddress(
+  poster: PublicKey,
+  index: number,
+  shard: number,
+): Promise<PublicKey> {
+  return PublicKey.createWithSeed(poster, `shard:${index}:${shard}`, programId);
+}
+
+/**
+ * Shard a signer should write to, matching counterShard() in helloworld.c
+ */
+export function pickCounterShard(signer: PublicKey, shardCount: number): number {
+  const key = signer.toBuffer();
+  // First 8 key bytes as a little-endian uint64, mod shardCount
+  const low = key.readUInt32LE(0);
+  const high = key.readUInt32LE(4);
+  return ((high % shardCount) * (2 ** 32 % shardCount) + low) % shardCount;
+}
+
+/**
+ * Sum the counters held in every shard of a post
+ */
+export async function getShardedCounters(
+  poster: PublicKey,
+  index: number,
+  shardCount: number,
+): Promise<PostCounters> {
+  const total: PostCounters = {likes: 0, replies: 0, reports: 0};
+  const addresses = await Promise.all(
+    [...Array(shardCount).keys()].map(shard =>
+      counterShardAddress(poster, index, shard),
+    ),
+  );
+  const infos = await getMultipleAccounts(addresses);
+  for (const data of infos) {
+    if (
+      data === null ||
+      data.length < layout.CounterShardMeta.size ||
+      data.readUInt8(layout.CounterShardMeta.accountType) != layout.COUNTER_SHARD_ACCOUNT_TYPE
+    ) {
+      continue;
+    }
+    const post = layout.CounterShardMeta.post;
+    const counters = layout.CounterShardMeta.counters;
+    const shardPoster = data.subarray(
+      post + layout.PostID.poster,
+      post + layout.PostID.poster + layout.SIZE_PUBKEY,
+    );
+    if (
+      !poster.toBuffer().equals(shardPoster) ||
+      data.readUInt32LE(post + layout.PostID.index) != index
+    ) {
+      continue;
+    }
+    total.likes += data.readUInt32LE(counters + layout.PostCounters.likes);
+    total.replies += data.readUInt32LE(counters + layout.PostCounters.replies);
+    total.reports += data.readUInt32LE(counters + layout.PostCounters.reports);
+  }
+  return total;
+}
+
+/**
+ * Address of a user's continuation page, derived from the user's key.
+ * openPage only accepts a page at this address. Pages are numbered from 1.
+ */
+export async function userPageAddress(
+  owner: PublicKey,
+  page: number,
+): Promise<PublicKey> {
+  return PublicKey.createWithSeed(owner, `page:${page}`, programId);
+}
+
+/**
+ * Account holding the post with the given PostID index: the user's own
+ * account or one of its pages. Pages hold contiguous index ranges in page
+ * order, so only the page headers on a binary search path are fetched.
+ */
+export async function findPostAccount(
+  owner: PublicKey,
+  index: number,
+): Promise<PublicKey | null> {
+  const user = await connection.getAccountInfo(owner);
+  if (user === null || user.data.length < layout.AccountMetadata.size) {
+    return null;
+  }
+  // Accounts from before versioning have no pages
+  const numPages =
+    user.data.readUInt8(layout.AccountMetadata.version) == layout.USER_VERSION_2
+      ? user.data.readUInt32LE(layout.AccountMetadata.numPages)
+      : 0;
+  let low = 1;
+  let high = numPages;
+  let found: PublicKey = owner;
+  while (low <= high) {
+    const page = (low + high) >> 1;
+    const address = await userPageAddress(owner, page);
+    const info = await connection.getAccountInfo(address);
+    if (
+      info === null ||
+      !info.owner.equals(programId) ||
+      info.data.length < layout.UserPageMeta.size ||
+      info.data.readUInt8(layout.UserPageMeta.accountType) != layout.USER_PAGE_ACCOUNT_TYPE
+    ) {
+      return null;
+    }
+    if (info.data.readUInt32LE(layout.UserPageMeta.firstPost) <= index) {
+      found = address;
+      low = page + 1;
+    } else {
+      high = page - 1;
+    }
+  }
+  return found;
+}
+
+/**
+ * Global timeline of the forum, newest posts first. Lists the users by
+ * header only; their records are fetched page by page as the timeline is
+ * read.
+ */
+export async function openTimeline(): Promise<Timeline> {
+  const users = await getProgramAccountsOfType(
+    layout.USER_ACCOUNT_TYPE,
+    layout.AccountMetadata.size,
+  );
+  return new Timeline(users, getMultipleAccounts, userPageAddress);
 }
@@ -0,0 +1,154 @@
+// Generated by src/program-c/native/schema_helloworld.c from the structs in
+// helloworld.c. Do not edit, run `make -C src/program-c schema` instead.
+
+/** PostID in helloworld.c */
+export const PostID = {
+  size: 36,
+  poster: 0,
+  index: 32,
+} as const;
+
+/** PostIDV1 in helloworld.c */
+export const PostIDV1 = {
+  size: 34,
+  poster: 0,
+  index: 32,
+} as const;
+
+/** AccountMetadata in helloworld.c */
+export const AccountMetadata = {
+  size: 56,
+  accountType: 0,
+  version: 1,
+  numPostsV1: 2,
+  username: 4,
+  tailOffset: 36,
+  reputation: 40,
+  numPosts: 48,
+  numPages: 52,
+} as const;
+
+/** UserPageMeta in helloworld.c */
+export const UserPageMeta = {
+  size: 56,
+  accountType: 0,
+  version: 1,
+  owner: 4,
+  tailOffset: 36,
+  firstPost: 40,
+  page: 44,
+  numPosts: 48,
+} as const;
+
+/** PostCounters in helloworld.c */
+export const PostCounters = {
+  size: 12,
+  likes: 0,
+  replies: 4,
+  reports: 8,
+} as const;
+
+/** CounterShardMeta in helloworld.c */
+export const CounterShardMeta = {
+  size: 52,
+  accountType: 0,
+  shard: 1,
+  shardCount: 2,
+  post: 4,
+  counters: 40,
+} as const;
+
+/** PetitionAccountMeta in helloworld.c */
+export const PetitionAccountMeta = {
+  size: 56,
+  accountType: 0,
+  layout: 1,
+  completed: 2,
+  offendingPost: 4,
+  netTally: 40,
+  reputationRequirement: 48,
+  numSignatures: 52,
+  hashSlots: 54,
+} as const;
+
+/** PetitionAccountMetaV1 in helloworld.c */
+export const PetitionAccountMetaV1 = {
+  size: 56,
+  accountType: 0,
+  layout: 1,
+  offendingPost: 2,
+  completed: 36,
+  votesFor: 38,
+  netTally: 40,
+  reputationRequirement: 48,
+  numSignatures: 52,
+  hashSlots: 54,
+} as const;
+
+/** PetitionPoolMeta in helloworld.c */
+export const PetitionPoolMeta = {
+  size: 16,
+  accountType: 0,
+  numSlots: 2,
+  firstUnused: 4,
+  freeHead: 6,
+  slotSize: 8,
+  openPetitions: 12,
+} as const;
+
+/** PetitionPoolSlot in helloworld.c */
+export const PetitionPoolSlot = {
+  size: 8,
+  generation: 0,
+  nextFree: 4,
+  unclaimed: 6,
+} as const;
+
+// Account types
+export const USER_ACCOUNT_TYPE = 1;
+export const PETITION_ACCOUNT_TYPE = 2;
+export const COUNTER_SHARD_ACCOUNT_TYPE = 3;
+export const USER_PAGE_ACCOUNT_TYPE = 4;
+export const PETITION_POOL_ACCOUNT_TYPE = 5;
+
+// User accounts and records
+export const SIZE_PUBKEY = 32;
+export const USER_VERSION_1 = 0;
+export const USER_VERSION_2 = 2;
+export const USER_V1_HEADER_SIZE = 48;
+export const RECORD_ALIGNMENT = 4;
+export const POST_SLOT_SIZE = 4;
+export const STAMPED_RECORD = 1;
+export const SLOT_STAMP_SIZE = 8;
+export const POST_SELECTOR = 80;
+export const REPLY_SELECTOR = 82;
+export const LIKE_SELECTOR = 76;
+export const REPORT_SELECTOR = 88;
+export const COUNTERS_FLAG = 128;
+export const REDACTED_FLAG = 32;
+export const COMPRESSED_FLAG = 1;
+
+// Compressed bodies
+export const MIN_BODY_MATCH = 4;
+export const LITERAL_TOKEN_LIMIT = 128;
+export const WORD_TOKEN_LIMIT = 192;
+export const BODY_DICTIONARY = [
+  "2074686520", "20616e6420", "20746f20", "206f6620", "206120", "20696e20", "20697320", "207468617420",
+  "20666f7220", "20697420", "20796f7520", "207769746820", "206f6e20", "207468697320", "20626520", "2061726520",
+  "206e6f7420", "206861766520", "2077617320", "2062757420", "207468657920", "20617420", "206f7220", "2066726f6d20",
+  "206d7920", "20696620", "206a75737420", "207768617420", "2063616e20", "2077696c6c20", "20616c6c20", "2061626f7574",
+  "20776520", "20736f20", "20616e20", "206c696b6520", "20796f757220", "20776f756c64", "207468657265", "207468696e6b",
+  "20706f7374", "207265706c79", "687474703a2f2f", "68747470733a2f", "2e636f6d", "7777772e", "696e6720", "74696f6e",
+  "656420", "657220", "277320", "6e277420", "2e20", "2c20", "2120", "3f20",
+  "204920", "54686520", "5468697320", "4920", "2e2e2e", "0a0a", "6c7920", "657320",
+].map(word => Buffer.from(word, 'hex'));
+
+// Petitions
+export const PETITION_LAYOUT_RECORDS = 0;
+export const PETITION_LAYOUT_COLUMNS = 1;
+export const PETITION_LAYOUT_V2 = 2;
+export const PETITION_OPEN = 0;
+export const PETITION_SETTLED = 1;
+export const PETITION_FINALIZED = 2;
+export const PETITION_REF_SIZE = 6;
+export const CREATE_POOL_SELECTOR = 79;
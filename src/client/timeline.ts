@@ -0,0 +1,190 @@
+/**
+ * Global timeline of slot-stamped posts
+ *
+ * Each user's records are stamped in slot order across the user account
+ * and its continuation pages, so the newest posts of the whole forum are
+ * a k-way merge of the per-user logs read from their tails. A Timeline
+ * keeps one cursor per user in a heap and only fetches an older page of a
+ * user once the merge reaches it, so a page of the timeline downloads the
+ * tail pages it needs and nothing else. Unstamped records are skipped, as
+ * they have no slot to be ordered by.
+ */
+
+import {PublicKey} from '@solana/web3.js';
+
+import * as layout from './layout';
+import {decodePostAccountHeader, postRecordAt, PostAccountHeader, PostRecord} from './decoder';
+
+/**
+ * A stamped record and the user who posted it
+ */
+export interface TimelineEntry {
+  poster: PublicKey;
+  slot: number;
+  record: PostRecord;
+}
+
+/**
+ * Data of many accounts in key order, null for missing ones
+ */
+export type AccountFetcher = (keys: PublicKey[]) => Promise<(Buffer | null)[]>;
+
+/**
+ * Address of a user's continuation page, numbered from 1
+ */
+export type PageAddress = (owner: PublicKey, page: number) => Promise<PublicKey>;
+
+// Walks one user's records from newest to oldest
+interface Cursor {
+  poster: PublicKey;
+  posterKey: Buffer;
+  page: number; // segment being walked, 0 for the user account itself
+  data: Buffer | null; // null until the segment is fetched
+  header: PostAccountHeader | null;
+  post: number; // records of the segment not yet walked
+  current: TimelineEntry | null;
+}
+
+// Positive if a comes before b: newer slots first, then larger poster
+// keys and indexes, matching the native timeline
+function compareEntries(a: Cursor, b: Cursor): number {
+  const x = a.current!;
+  const y = b.current!;
+  if (x.slot != y.slot) {
+    return x.slot - y.slot;
+  }
+  const poster = a.posterKey.compare(b.posterKey);
+  return poster != 0 ? poster : x.record.index - y.record.index;
+}
+
+export class Timeline {
+  private cursors: Cursor[];
+  private heap: Cursor[] = [];
+  private started = false;
+
+  /**
+   * Timeline over the users whose headers are given, as returned by
+   * getProgramAccountsOfType(USER_ACCOUNT_TYPE, AccountMetadata.size)
+   */
+  constructor(
+    users: {pubkey: PublicKey; data: Buffer}[],
+    private fetchAccounts: AccountFetcher,
+    private pageAddress: PageAddress,
+  ) {
+    this.cursors = [];
+    for (const user of users) {
+      // Only version 2 accounts and their pages hold stamped records
+      if (
+        user.data.length < layout.AccountMetadata.size ||
+        user.data.readUInt8(layout.AccountMetadata.version) != layout.USER_VERSION_2
+      ) {
+        continue;
+      }
+      const page = user.data.readUInt32LE(layout.AccountMetadata.numPages);
+      if (page == 0 && user.data.readUInt32LE(layout.AccountMetadata.numPosts) == 0) {
+        continue;
+      }
+      this.cursors.push({
+        poster: user.pubkey,
+        posterKey: user.pubkey.toBuffer(),
+        page,
+        data: null,
+        header: null,
+        post: 0,
+        current: null,
+      });
+    }
+  }
+
+  /**
+   * The next limit entries of the timeline, newest first. Returns fewer
+   * once every stamped record has been returned.
+   */
+  async nextPage(limit: number): Promise<TimelineEntry[]> {
+    if (!this.started) {
+      this.started = true;
+      await this.advanceAll(this.cursors);
+      this.heap = this.cursors.filter(c => c.current !== null);
+      for (let i = this.heap.length >> 1; i > 0; i--) {
+        this.siftDown(i - 1);
+      }
+    }
+    const entries: TimelineEntry[] = [];
+    while (entries.length < limit && this.heap.length > 0) {
+      const newest = this.heap[0];
+      entries.push(newest.current!);
+      await this.advanceAll([newest]);
+      if (newest.current === null) {
+        this.heap[0] = this.heap[this.heap.length - 1];
+        this.heap.pop();
+      }
+      this.siftDown(0);
+    }
+    return entries;
+  }
+
+  // Moves each cursor to its next older stamped record, fetching the
+  // segments they reach in shared batches
+  private async advanceAll(cursors: Cursor[]): Promise<void> {
+    let waiting = cursors;
+    while (waiting.length > 0) {
+      const unfetched = waiting.filter(c => c.data === null);
+      if (unfetched.length > 0) {
+        const keys = await Promise.all(
+          unfetched.map(c => (c.page == 0 ? c.poster : this.pageAddress(c.poster, c.page))),
+        );
+        const segments = await this.fetchAccounts(keys);
+        unfetched.forEach((cursor, i) => this.openSegment(cursor, segments[i]));
+      }
+      waiting = waiting.filter(c => !this.advance(c));
+    }
+  }
+
+  private openSegment(cursor: Cursor, data: Buffer | null): void {
+    const header = data === null ? null : decodePostAccountHeader(data);
+    const usable =
+      header !== null &&
+      header.current &&
+      header.numPosts * layout.POST_SLOT_SIZE <= data!.length;
+    cursor.data = data === null ? Buffer.alloc(0) : data;
+    cursor.header = usable ? header : null;
+    cursor.post = usable ? header!.numPosts : 0;
+  }
+
+  // Steps back through the fetched segment. Returns false if the cursor
+  // moved to an older segment that still has to be fetched.
+  private advance(cursor: Cursor): boolean {
+    cursor.current = null;
+    while (cursor.post > 0) {
+      const record = postRecordAt(cursor.data!, cursor.header!, --cursor.post);
+      if (record !== null && record.slot !== null) {
+        cursor.current = {poster: cursor.poster, slot: record.slot, record};
+        return true;
+      }
+    }
+    if (cursor.page == 0) {
+      return true;
+    }
+    cursor.page--;
+    cursor.data = null;
+    cursor.header = null;
+    return false;
+  }
+
+  private siftDown(i: number): void {
+    const heap = this.heap;
+    for (;;) {
+      let first = i;
+      for (const child of [2 * i + 1, 2 * i + 2]) {
+        if (child < heap.length && compareEntries(heap[child], heap[first]) > 0) {
+          first = child;
+        }
+      }
+      if (first == i) {
+        return;
+      }
+      [heap[i], heap[first]] = [heap[first], heap[i]];
+      i = first;
+    }
+  }
+}
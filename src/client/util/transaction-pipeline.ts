@@ -0,0 +1,188 @@
+import {
+  Account,
+  Connection,
+  Transaction,
+  TransactionInstruction,
+} from '@solana/web3.js';
+
+import {sleep} from './sleep';
+
+export interface PipelineOptions {
+  // Transactions sent but not yet confirmed
+  window?: number;
+  // Resends of a transaction that has not confirmed in time
+  maxRetries?: number;
+  // Time to wait for a confirmation before resending
+  confirmTimeoutMs?: number;
+  // Age after which the cached blockhash is refreshed. Blockhashes stay
+  // valid for about a minute, so a cached one leaves room for retries.
+  blockhashTtlMs?: number;
+}
+
+/**
+ * Sends transactions without waiting for each to confirm first
+ *
+ * Up to `window` transactions are in flight at once. They are signed with
+ * a shared recent blockhash, sent without preflight, and confirmed through
+ * signature subscriptions. A transaction that does not confirm in time is
+ * resent as the same signed bytes, so a retry can never post twice, up to
+ * maxRetries times. Transactions confirm in any order.
+ */
+export class TransactionPipeline {
+  private window: number;
+  private maxRetries: number;
+  private confirmTimeoutMs: number;
+  private blockhashTtlMs: number;
+  private blockhash: Promise<string> | null = null;
+  private blockhashTime = 0;
+  private inFlight = new Set<string>();
+  private active = 0;
+  private waiting: (() => void)[] = [];
+  private pending = new Set<Promise<string>>();
+
+  constructor(
+    private connection: Connection,
+    private payer: Account,
+    options: PipelineOptions = {},
+  ) {
+    this.window = options.window ?? 32;
+    this.maxRetries = options.maxRetries ?? 3;
+    this.confirmTimeoutMs = options.confirmTimeoutMs ?? 15000;
+    this.blockhashTtlMs = options.blockhashTtlMs ?? 20000;
+  }
+
+  /**
+   * Queue a transaction of the given instructions, signed by the payer and
+   * signers. Resolves with its signature once confirmed, and rejects if it
+   * fails on chain or never confirms.
+   */
+  submit(instructions: TransactionInstruction[], signers: Account[] = []): Promise<string> {
+    const result = this.run(instructions, signers);
+    this.pending.add(result);
+    const settle = () => this.pending.delete(result);
+    result.then(settle, settle);
+    return result;
+  }
+
+  /**
+   * Wait for every submitted transaction to confirm or fail
+   */
+  async drain(): Promise<void> {
+    await Promise.all([...this.pending].map(p => p.catch(() => undefined)));
+  }
+
+  private async run(instructions: TransactionInstruction[], signers: Account[]): Promise<string> {
+    await this.acquire();
+    try {
+      const transaction = await this.sign(instructions, signers);
+      const signature = transaction.signature!.toString('base64');
+      this.inFlight.add(signature);
+      try {
+        return await this.sendAndConfirm(transaction.serialize());
+      } finally {
+        this.inFlight.delete(signature);
+      }
+    } finally {
+      this.release();
+    }
+  }
+
+  private async acquire(): Promise<void> {
+    if (this.active < this.window) {
+      this.active++;
+      return;
+    }
+    // release() hands its slot straight to the next waiter
+    await new Promise<void>(resolve => this.waiting.push(resolve));
+  }
+
+  private release(): void {
+    const next = this.waiting.shift();
+    if (next) {
+      next();
+    } else {
+      this.active--;
+    }
+  }
+
+  private recentBlockhash(): Promise<string> {
+    if (this.blockhash === null || Date.now() - this.blockhashTime > this.blockhashTtlMs) {
+      this.blockhashTime = Date.now();
+      this.blockhash = this.connection.getRecentBlockhash().then(r => r.blockhash);
+      // Fetch again next time rather than caching a failure
+      this.blockhash.catch(() => (this.blockhash = null));
+    }
+    return this.blockhash;
+  }
+
+  // Identical instructions signed with the same blockhash are the same
+  // transaction, which the cluster would drop as a duplicate. Those wait
+  // for a newer blockhash instead.
+  private async sign(instructions: TransactionInstruction[], signers: Account[]): Promise<Transaction> {
+    for (let attempt = 0; ; attempt++) {
+      const transaction = new Transaction().add(...instructions);
+      transaction.recentBlockhash = await this.recentBlockhash();
+      transaction.sign(this.payer, ...signers);
+      if (!this.inFlight.has(transaction.signature!.toString('base64'))) {
+        return transaction;
+      }
+      if (attempt >= this.maxRetries) {
+        throw new Error('No fresh blockhash for a duplicate transaction');
+      }
+      await sleep(500);
+      this.blockhash = null;
+    }
+  }
+
+  private async sendAndConfirm(raw: Buffer): Promise<string> {
+    let lastError: any = null;
+    for (let attempt = 0; attempt <= this.maxRetries; attempt++) {
+      let signature: string;
+      try {
+        signature = await this.connection.sendRawTransaction(raw, {skipPreflight: true});
+      } catch (err) {
+        lastError = err;
+        await sleep(500);
+        continue;
+      }
+      const confirmed = await this.confirm(signature);
+      if (confirmed !== null) {
+        if (confirmed.err) {
+          throw new Error(`Transaction ${signature} failed: ${JSON.stringify(confirmed.err)}`);
+        }
+        return signature;
+      }
+      lastError = new Error(`Transaction ${signature} was not confirmed`);
+    }
+    throw lastError;
+  }
+
+  // Resolves with the signature result, or null after confirmTimeoutMs
+  private confirm(signature: string): Promise<{err: any} | null> {
+    return new Promise(resolve => {
+      let done = false;
+      const subscription = this.connection.onSignature(
+        signature,
+        result => {
+          if (!done) {
+            done = true;
+            clearTimeout(timer);
+            resolve(result);
+          }
+        },
+        'singleGossip',
+      );
+      const timer = setTimeout(async () => {
+        if (done) {
+          return;
+        }
+        done = true;
+        this.connection.removeSignatureListener(subscription).catch(() => undefined);
+        // The notification may have been missed rather than the transaction
+        const status = await this.connection.getSignatureStatus(signature).catch(() => null);
+        const value = status && status.value;
+        resolve(value && value.confirmations !== 0 ? {err: value.err} : null);
+      }, this.confirmTimeoutMs);
+    });
+  }
+}
@@ -0,0 +1,578 @@
+/**
+ * @brief Native micro-benchmarks for the forum program's instruction handlers
+ *
+ * Builds helloworld.c for the host against stub syscalls and times each
+ * handler over synthetic accounts (1 KB to 10 MB) and petitions (1 to
+ * MAX_PETITION_SIZE signatures). Every group prints ns/op per size and a
+ * fitted scaling exponent, so an O(n) regression shows up as an exponent
+ * near 1 instead of near 0.
+ *
+ * Usage: bench_helloworld [name filter]
+ */
+#include "../src/helloworld/helloworld.c"
+#include "syscall_stubs.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// Minimum wall time spent timing a single benchmark case
+#define MIN_BENCH_NANOS 20000000ULL
+// Body length of the posts used to fill synthetic accounts
+#define FILL_BODY_LENGTH 96
+// Number of likes sent in one batch instruction
+#define BATCH_LIKES 8
+// Exponents above this are flagged as linear (or worse) scaling
+#define LINEAR_EXPONENT 0.5
+
+static const uint64_t accountSizes[] = { 1024, 10240, 102400, 1048576, 10485760 };
+static const uint64_t petitionSizes[] = { 1, 8, 64, 256, MAX_PETITION_SIZE };
+
+static SolPubkey programId = {.x = { 1, }};
+static uint64_t lamports = 1;
+static const char* filter = NULL;
+
+// Keeps the compiler from discarding results of pure functions
+static volatile uint64_t sink;
+
+#define STRINGIFY_(x) #x
+#define STRINGIFY(x) STRINGIFY_(x)
+
+typedef void (*BenchFn)(void* ctx);
+
+// A single measured point of a scaling curve
+typedef struct {
+  uint64_t size;
+  double nanosPerOp;
+  double logsPerOp;
+} BenchPoint;
+
+static uint64_t nowNanos() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Runs fn in doubling batches until MIN_BENCH_NANOS have elapsed
+static BenchPoint timeOp(BenchFn fn, void* ctx, uint64_t size) {
+  uint64_t iterations = 1;
+  for(;;) {
+    uint64_t logsBefore = stubLogCount;
+    uint64_t start = nowNanos();
+    for(uint64_t i = 0; i < iterations; i++) {
+      fn(ctx);
+    }
+    uint64_t elapsed = nowNanos() - start;
+    if(elapsed >= MIN_BENCH_NANOS || iterations >= (1ULL << 30)) {
+      BenchPoint point = {
+        .size = size,
+        .nanosPerOp = (double)elapsed / iterations,
+        .logsPerOp = (double)(stubLogCount - logsBefore) / iterations,
+      };
+      return point;
+    }
+    iterations *= 2;
+  }
+}
+
+static bool selected(const char* name) {
+  return filter == NULL || strstr(name, filter) != NULL;
+}
+
+static void printHeader(const char* name, const char* unit) {
+  printf("\n%s\n", name);
+  printf("  %12s %14s %10s %10s\n", unit, "ns/op", "vs first", "logs/op");
+}
+
+static void printPoint(BenchPoint* point, BenchPoint* first) {
+  printf("  %12lu %14.1f %9.2fx %10.1f\n", point->size, point->nanosPerOp,
+         point->nanosPerOp / first->nanosPerOp, point->logsPerOp);
+}
+
+// Prints the exponent k of the best fit ns/op ~ size^k between the end points
+static void printScaling(BenchPoint* points, int count) {
+  if(count < 2) {
+    return;
+  }
+  double exponent = log(points[count - 1].nanosPerOp / points[0].nanosPerOp) /
+                    log((double)points[count - 1].size / points[0].size);
+  printf("  scaling exponent %.2f%s\n", exponent,
+         exponent > LINEAR_EXPONENT ? "  <-- grows with size" : "");
+}
+
+// Synthetic accounts
+// ----------------------------------------------------------------------------
+static void makeAccount(SolAccountInfo* account, SolPubkey* key, uint8_t* data, uint64_t length) {
+  SolAccountInfo info = { key, &lamports, length, data, &programId, 0, true, true, false };
+  *account = info;
+}
+
+static void setParams(SolParameters* params, SolAccountInfo* accounts, uint64_t numAccounts,
+                      const uint8_t* data, uint64_t dataLength) {
+  SolParameters p = { accounts, numAccounts, data, dataLength, &programId };
+  *params = p;
+}
+
+// Builds the instruction data for a post of the given type targeting post 0 of key
+static uint64_t makeInstruction(uint8_t* out, uint8_t selector, SolPubkey* key, uint64_t bodyLength) {
+  uint64_t length = 0;
+  out[length++] = selector;
+  if(selector & COUNTERS_FLAG) {
+    sol_memset(&out[length], 0, sizeof(PostCounters));
+    length += sizeof(PostCounters);
+    selector &= ~COUNTERS_FLAG;
+  }
+  if(selector != POST_SELECTOR) {
+    PostID id = { .poster = *key, .index = 0 };
+    sol_memcpy(&out[length], &id, sizeof(PostID));
+    length += sizeof(PostID);
+  }
+  if(selector != LIKE_SELECTOR) {
+    sol_memset(&out[length], 'b', bodyLength);
+    length += bodyLength;
+  }
+  return length;
+}
+
+// Builds a batch instruction of BATCH_LIKES likes of post 0 of key
+static uint64_t makeLikeBatch(uint8_t* out, SolPubkey* key) {
+  uint64_t length = 0;
+  out[length++] = BATCH_SELECTOR;
+  for(int i = 0; i < BATCH_LIKES; i++) {
+    uint16_t opLength = 1 + sizeof(PostID);
+    sol_memcpy(&out[length], &opLength, sizeof(uint16_t));
+    length += sizeof(uint16_t);
+    length += makeInstruction(&out[length], LIKE_SELECTOR, key, 0);
+  }
+  return length;
+}
+
+// Fills half of an account with posts of the given selector through the
+// program itself
+static void fillAccount(SolAccountInfo* account, uint8_t selector) {
+  uint8_t instruction[1 + sizeof(PostCounters) + FILL_BODY_LENGTH];
+  uint64_t length = makeInstruction(instruction, selector, account->key, FILL_BODY_LENGTH);
+  SolParameters params;
+  setParams(&params, account, 1, instruction, length);
+  sol_memset(account->data, 0, account->data_len);
+  while(newPostOffset(account->data, account->data_len) < account->data_len / 2) {
+    if(helloworld(&params) != SUCCESS) {
+      break;
+    }
+  }
+}
+
+// Fills half of an account with posts in the version 1 legacy layout, which
+// the program no longer writes itself
+static void fillLegacyAccount(SolAccountInfo* account) {
+  uint8_t instruction[1 + FILL_BODY_LENGTH];
+  uint16_t length = makeInstruction(instruction, POST_SELECTOR, account->key, FILL_BODY_LENGTH);
+  sol_memset(account->data, 0, account->data_len);
+  AccountMetadata* meta = (AccountMetadata*)account->data;
+  meta->accountType = User;
+  meta->version = USER_VERSION_1;
+  meta->reputation = 5;
+  uint64_t offset = USER_V1_HEADER_SIZE;
+  while(offset < account->data_len / 2 && meta->numPostsV1 < UINT16_MAX) {
+    sol_memcpy(&account->data[offset], &length, sizeof(uint16_t));
+    sol_memcpy(&account->data[offset + sizeof(uint16_t)], instruction, length);
+    offset += sizeof(uint16_t) + length;
+    meta->numPostsV1++;
+  }
+}
+
+// Post benchmarks
+// ----------------------------------------------------------------------------
+typedef struct {
+  SolParameters params;
+  AccountMetadata saved;
+  uint8_t* data;
+  uint64_t length;
+  // Untouched copy of a legacy account for benchmarks that upgrade it
+  uint8_t* legacy;
+} PostCtx;
+
+// Appends one post, then rolls the header back so the account never fills
+static void runPost(void* ctx) {
+  PostCtx* c = ctx;
+  sink += helloworld(&c->params);
+  *(AccountMetadata*)c->data = c->saved;
+}
+
+static void runNewPostOffset(void* ctx) {
+  PostCtx* c = ctx;
+  sink += newPostOffset(c->data, c->length);
+}
+
+// Runs on a legacy account, so lookups take the linear walk
+static void runLegacyNewPostOffset(void* ctx) {
+  PostCtx* c = ctx;
+  sink += newPostOffset(c->data, c->length);
+}
+
+static void runPostOffset(void* ctx) {
+  PostCtx* c = ctx;
+  AccountMetadata* meta = (AccountMetadata*)c->data;
+  sink += postOffset(c->data, c->length, meta->numPosts - 1);
+}
+
+// Likes post 0 of the account with the account itself passed as the target,
+// bumping its counters
+static void runCountedLike(void* ctx) {
+  runPost(ctx);
+}
+
+// Restores the legacy account and migrates it again. The restore is an
+// O(n) copy, so it is included in the time of this already O(n) handler.
+static void runMigrate(void* ctx) {
+  PostCtx* c = ctx;
+  sol_memcpy(c->data, c->legacy, c->length);
+  sink += helloworld(&c->params);
+}
+
+static void benchAccounts(const char* name, uint8_t selector, BenchFn fn) {
+  if(!selected(name)) {
+    return;
+  }
+  printHeader(name, "account B");
+  int count = SOL_ARRAY_SIZE(accountSizes);
+  BenchPoint points[SOL_ARRAY_SIZE(accountSizes)];
+  SolPubkey key = {.x = { 2, }};
+  uint8_t instruction[1024];
+  uint64_t instructionLength = 1;
+  instruction[0] = selector;
+  if(selector == BATCH_SELECTOR) {
+    instructionLength = makeLikeBatch(instruction, &key);
+  }
+  else if(selector != MIGRATE_SELECTOR) {
+    instructionLength = makeInstruction(instruction, selector, &key, FILL_BODY_LENGTH);
+  }
+
+  for(int i = 0; i < count; i++) {
+    PostCtx ctx;
+    SolAccountInfo account;
+    ctx.length = accountSizes[i];
+    ctx.data = calloc(1, ctx.length);
+    makeAccount(&account, &key, ctx.data, ctx.length);
+    SolAccountInfo accounts[] = { account, account };
+    ctx.legacy = NULL;
+    if(fn == runLegacyNewPostOffset || fn == runMigrate) {
+      fillLegacyAccount(&account);
+      ctx.legacy = malloc(ctx.length);
+      sol_memcpy(ctx.legacy, ctx.data, ctx.length);
+    }
+    else {
+      fillAccount(&account, fn == runCountedLike ? POST_SELECTOR | COUNTERS_FLAG : POST_SELECTOR);
+    }
+    setParams(&ctx.params, accounts, fn == runCountedLike ? 2 : 1, instruction, instructionLength);
+    ctx.saved = *(AccountMetadata*)ctx.data;
+    if((fn == runPost || fn == runCountedLike || fn == runMigrate) &&
+       helloworld(&ctx.params) != SUCCESS) {
+      fprintf(stderr, "%s: setup failed at %lu bytes\n", name, ctx.length);
+      exit(1);
+    }
+    *(AccountMetadata*)ctx.data = ctx.saved;
+    points[i] = timeOp(fn, &ctx, ctx.length);
+    printPoint(&points[i], &points[0]);
+    free(ctx.data);
+    free(ctx.legacy);
+  }
+  printScaling(points, count);
+}
+
+static void runParsePost(void* ctx) {
+  PostCtx* c = ctx;
+  Post post;
+  sink += parsePost(c->params.data, c->params.data_len, &post);
+}
+
+static void benchParsePost(const char* name, uint8_t selector) {
+  if(!selected(name)) {
+    return;
+  }
+  printHeader(name, "body B");
+  static const uint64_t bodySizes[] = { 1, 64, 1024, 16384 };
+  int count = SOL_ARRAY_SIZE(bodySizes);
+  BenchPoint points[SOL_ARRAY_SIZE(bodySizes)];
+  SolPubkey key = {.x = { 2, }};
+  uint8_t* instruction = malloc(1 + sizeof(PostID) + bodySizes[count - 1]);
+  for(int i = 0; i < count; i++) {
+    PostCtx ctx;
+    uint64_t length = makeInstruction(instruction, selector, &key, bodySizes[i]);
+    setParams(&ctx.params, NULL, 0, instruction, length);
+    points[i] = timeOp(runParsePost, &ctx, bodySizes[i]);
+    printPoint(&points[i], &points[0]);
+  }
+  printScaling(points, count);
+  free(instruction);
+}
+
+// Petition benchmarks
+// ----------------------------------------------------------------------------
+typedef struct {
+  uint64_t size;
+  SolPubkey* keys;          // [offender, petition, voters..., outsider]
+  uint8_t* voterData;
+  uint8_t offenderData[1024];
+  uint8_t* petitionData;
+  uint64_t petitionLength;
+  SolAccountInfo* accounts; // [petition, offender, voters...]
+  SolAccountInfo outsider;
+  SolParameters params;
+  uint8_t instruction[3];
+} PetitionCtx;
+
+#define VOTER_DATA_LENGTH 256
+
+static SolPubkey* voterKey(PetitionCtx* c, uint64_t i) {
+  return &c->keys[2 + i];
+}
+
+// Creates a petition with the given number of slots and fills all but
+// the last numEmpty of them through the program's vote instruction
+static void makePetition(PetitionCtx* c, uint64_t size, uint64_t numEmpty) {
+  c->size = size;
+  c->keys = calloc(size + 3, sizeof(SolPubkey));
+  for(uint64_t i = 0; i < size + 3; i++) {
+    sol_memcpy(c->keys[i].x, &i, sizeof(i));
+    c->keys[i].x[31] = 0xAA;
+  }
+  c->voterData = calloc(size + 1, VOTER_DATA_LENGTH);
+  c->petitionLength = PETITION_ACCOUNT_SIZE(size);
+  c->petitionData = calloc(1, c->petitionLength);
+  c->accounts = calloc(size + 2, sizeof(SolAccountInfo));
+
+  makeAccount(&c->accounts[0], &c->keys[1], c->petitionData, c->petitionLength);
+  makeAccount(&c->accounts[1], &c->keys[0], c->offenderData, sizeof(c->offenderData));
+  sol_memset(c->offenderData, 0, sizeof(c->offenderData));
+  fillAccount(&c->accounts[1], POST_SELECTOR);
+  for(uint64_t i = 0; i <= size; i++) {
+    uint8_t* data = &c->voterData[i * VOTER_DATA_LENGTH];
+    initializeUserAccount(data, VOTER_DATA_LENGTH);
+    ((AccountMetadata*)data)->reputation = 1000000;
+    makeAccount(i < size ? &c->accounts[2 + i] : &c->outsider, voterKey(c, i), data, VOTER_DATA_LENGTH);
+  }
+
+  PostID offender = { .poster = c->keys[0], .index = 0 };
+  initializePetitionAccount(c->petitionData, c->petitionLength, &offender,
+                            c->offenderData, sizeof(c->offenderData));
+  uint8_t vote[] = { VOTE_SELECTOR, 1 };
+  for(uint64_t i = 0; i + numEmpty < size; i++) {
+    SolAccountInfo voteAccounts[] = { c->accounts[2 + i], c->accounts[0] };
+    vote[1] = i % 3 != 0;
+    SolParameters params;
+    setParams(&params, voteAccounts, 2, vote, sizeof(vote));
+    if(helloworld(&params) != SUCCESS) {
+      fprintf(stderr, "petition setup failed at %lu signatures\n", i);
+      exit(1);
+    }
+  }
+}
+
+static void freePetition(PetitionCtx* c) {
+  free(c->keys);
+  free(c->voterData);
+  free(c->petitionData);
+  free(c->accounts);
+}
+
+// Worst case duplicate check: the voter is not in the petition
+static void runHasVoted(void* ctx) {
+  PetitionCtx* c = ctx;
+  sink += hasVoted(&c->outsider, &c->accounts[0]);
+}
+
+// Removes the last vote, which is always a vote for, so it can be cast again
+static void undoVote(PetitionCtx* c) {
+  PetitionAccountMeta* meta = (PetitionAccountMeta*)c->petitionData;
+  meta->numSignatures--;
+  meta->netTally--;
+  *findVoterSlot(c->petitionData, c->params.ka[0].key) = 0;
+}
+
+// Casts the last vote, then removes it again
+static void runVote(void* ctx) {
+  PetitionCtx* c = ctx;
+  sink += helloworld(&c->params);
+  undoVote(c);
+}
+
+// Settles a full petition, then reopens it
+static void runOutcome(void* ctx) {
+  PetitionCtx* c = ctx;
+  sink += helloworld(&c->params);
+  ((PetitionAccountMeta*)c->petitionData)->completed = PETITION_OPEN;
+}
+
+// Finalizes a full petition without voter accounts, then reopens it
+static void runFinalize(void* ctx) {
+  runOutcome(ctx);
+}
+
+// Restores the last signer key cleared by a claim
+static void undoClaim(PetitionCtx* c) {
+  sol_memcpy(petitionSigner(c->petitionData, c->size - 1), voterKey(c, c->size - 1), sizeof(SolPubkey));
+}
+
+// Claims the last voter's reward, then unclaims it
+static void runClaim(void* ctx) {
+  PetitionCtx* c = ctx;
+  sink += helloworld(&c->params);
+  undoClaim(c);
+}
+
+static void benchPetitions(const char* name, BenchFn fn) {
+  if(!selected(name)) {
+    return;
+  }
+  printHeader(name, "signatures");
+  int count = SOL_ARRAY_SIZE(petitionSizes);
+  BenchPoint points[SOL_ARRAY_SIZE(petitionSizes)];
+  for(int i = 0; i < count; i++) {
+    PetitionCtx ctx;
+    uint64_t size = petitionSizes[i];
+    makePetition(&ctx, size, fn == runVote ? 1 : 0);
+    if(fn == runVote || fn == runClaim) {
+      // The last voter and the petition
+      SolAccountInfo* accounts = calloc(2, sizeof(SolAccountInfo));
+      accounts[0] = ctx.accounts[2 + size - 1];
+      accounts[1] = ctx.accounts[0];
+      uint16_t index = size - 1;
+      ctx.instruction[0] = fn == runVote ? VOTE_SELECTOR : CLAIM_REWARD_SELECTOR;
+      ctx.instruction[1] = 1;
+      if(fn == runClaim) {
+        sol_memcpy(&ctx.instruction[1], &index, sizeof(uint16_t));
+        ((PetitionAccountMeta*)ctx.petitionData)->completed = PETITION_FINALIZED;
+      }
+      setParams(&ctx.params, accounts, 2, ctx.instruction, fn == runVote ? 2 : 3);
+    }
+    else {
+      // Finalizing passes no voter accounts
+      ctx.instruction[0] = PROCESS_PETITION_SELECTOR;
+      setParams(&ctx.params, ctx.accounts, fn == runFinalize ? 2 : size + 2, ctx.instruction, 1);
+    }
+    if(fn != runHasVoted) {
+      // Verify the setup, then undo the verification run
+      if(helloworld(&ctx.params) != SUCCESS) {
+        fprintf(stderr, "%s: setup failed at %lu signatures\n", name, size);
+        exit(1);
+      }
+      if(fn == runVote) {
+        undoVote(&ctx);
+      }
+      else if(fn == runClaim) {
+        undoClaim(&ctx);
+      }
+      else {
+        ((PetitionAccountMeta*)ctx.petitionData)->completed = PETITION_OPEN;
+      }
+    }
+    points[i] = timeOp(fn, &ctx, size);
+    printPoint(&points[i], &points[0]);
+    if(fn == runVote || fn == runClaim) {
+      free(ctx.params.ka);
+    }
+    freePetition(&ctx);
+  }
+  printScaling(points, count);
+}
+
+// Fixed-size benchmarks
+// ----------------------------------------------------------------------------
+static void runHelloworld(void* ctx) {
+  PostCtx* c = ctx;
+  sink += helloworld(&c->params);
+  sol_memset(c->data, 0, sizeof(PetitionAccountMeta));
+}
+
+static void benchCreatePetition(const char* name) {
+  if(!selected(name)) {
+    return;
+  }
+  printHeader(name, "signatures");
+  int count = SOL_ARRAY_SIZE(petitionSizes);
+  BenchPoint points[SOL_ARRAY_SIZE(petitionSizes)];
+  SolPubkey petitionKey = {.x = { 3, }};
+  SolPubkey offenderKey = {.x = { 4, }};
+  uint8_t offenderData[1024] = { 0 };
+  uint8_t instruction[] = { CREATE_PETITION_SELECTOR, 0, 0, 0, 0 };
+  for(int i = 0; i < count; i++) {
+    PostCtx ctx;
+    SolAccountInfo accounts[2];
+    ctx.length = PETITION_ACCOUNT_SIZE(petitionSizes[i]);
+    ctx.data = calloc(1, ctx.length);
+    makeAccount(&accounts[0], &petitionKey, ctx.data, ctx.length);
+    makeAccount(&accounts[1], &offenderKey, offenderData, sizeof(offenderData));
+    fillAccount(&accounts[1], POST_SELECTOR);
+    setParams(&ctx.params, accounts, 2, instruction, sizeof(instruction));
+    points[i] = timeOp(runHelloworld, &ctx, petitionSizes[i]);
+    printPoint(&points[i], &points[0]);
+    free(ctx.data);
+  }
+  printScaling(points, count);
+}
+
+static void runSetUsername(void* ctx) {
+  PostCtx* c = ctx;
+  sink += helloworld(&c->params);
+}
+
+static void benchSetUsername(const char* name) {
+  if(!selected(name)) {
+    return;
+  }
+  printHeader(name, "account B");
+  int count = SOL_ARRAY_SIZE(accountSizes);
+  BenchPoint points[SOL_ARRAY_SIZE(accountSizes)];
+  SolPubkey key = {.x = { 2, }};
+  uint8_t instruction[] = "sbenchmark";
+  for(int i = 0; i < count; i++) {
+    PostCtx ctx;
+    SolAccountInfo account;
+    ctx.length = accountSizes[i];
+    ctx.data = calloc(1, ctx.length);
+    makeAccount(&account, &key, ctx.data, ctx.length);
+    fillAccount(&account, POST_SELECTOR);
+    setParams(&ctx.params, &account, 1, instruction, sizeof(instruction) - 1);
+    points[i] = timeOp(runSetUsername, &ctx, ctx.length);
+    printPoint(&points[i], &points[0]);
+    free(ctx.data);
+  }
+  printScaling(points, count);
+}
+
+int main(int argc, char** argv) {
+  if(argc > 1) {
+    filter = argv[1];
+  }
+  printf("Forum program native benchmarks (stubbed syscalls, %llu ms per case)\n",
+         MIN_BENCH_NANOS / 1000000ULL);
+
+  benchParsePost("parsePost P", POST_SELECTOR);
+  benchParsePost("parsePost R", REPLY_SELECTOR);
+  benchParsePost("parsePost L", LIKE_SELECTOR);
+  benchParsePost("parsePost X", REPORT_SELECTOR);
+
+  benchAccounts("newPostOffset", POST_SELECTOR, runNewPostOffset);
+  benchAccounts("newPostOffset (legacy walk)", POST_SELECTOR, runLegacyNewPostOffset);
+  benchAccounts("postOffset (last post)", POST_SELECTOR, runPostOffset);
+
+  benchAccounts("helloworld P", POST_SELECTOR, runPost);
+  benchAccounts("helloworld R", REPLY_SELECTOR, runPost);
+  benchAccounts("helloworld L", LIKE_SELECTOR, runPost);
+  benchAccounts("helloworld L (counted target)", LIKE_SELECTOR, runCountedLike);
+  benchAccounts("helloworld X", REPORT_SELECTOR, runPost);
+  benchAccounts("helloworld B (" STRINGIFY(BATCH_LIKES) " likes)", BATCH_SELECTOR, runPost);
+  benchAccounts("helloworld M (migrate)", MIGRATE_SELECTOR, runMigrate);
+  benchSetUsername("helloworld s");
+
+  benchPetitions("hasVoted (absent voter)", runHasVoted);
+  benchPetitions("helloworld V (last vote)", runVote);
+  benchCreatePetition("helloworld C");
+  benchPetitions("helloworld F (processPetitionOutcome)", runOutcome);
+  benchPetitions("helloworld F (finalize only)", runFinalize);
+  benchPetitions("helloworld W (claim)", runClaim);
+
+  return 0;
+}
@@ -0,0 +1,209 @@
+/**
+ * @brief Reading dumps of the forum program's accounts
+ *
+ * Shared by the native tools that work on account dumps. Include once per
+ * tool, after helloworld.c. Dumps are memory-mapped and accounts are read
+ * in place.
+ *
+ * Dump format, repeated until the end of the file:
+ *
+ * width       name          type          description
+ * -----------------------------------------------------------------------------
+ * 32          key           SolPubkey     the account's address
+ * 8           length        uint64_t      size of the account data
+ * length      data          uint8_t[]     the account data
+ */
+#pragma once
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// Timing
+// ----------------------------------------------------------------------------
+static inline uint64_t nowNanos() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static inline double millisSince(uint64_t start) {
+  return (nowNanos() - start) / 1e6;
+}
+
+// Base58 keys
+// ----------------------------------------------------------------------------
+static const char base58Alphabet[] = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
+
+// Writes the base58 form of key to out, which must hold 45 bytes
+static inline void encodeKey(const SolPubkey* key, char* out) {
+  uint8_t digits[44] = {0};
+  uint64_t length = 0;
+  for(int i = 0; i < SIZE_PUBKEY; i++) {
+    uint64_t carry = key->x[i];
+    for(uint64_t j = 0; j < length; j++) {
+      carry += (uint64_t)digits[j] << 8;
+      digits[j] = carry % 58;
+      carry /= 58;
+    }
+    while(carry > 0) {
+      digits[length++] = carry % 58;
+      carry /= 58;
+    }
+  }
+  uint64_t o = 0;
+  for(int i = 0; i < SIZE_PUBKEY && key->x[i] == 0; i++) {
+    out[o++] = '1';
+  }
+  while(length > 0) {
+    out[o++] = base58Alphabet[digits[--length]];
+  }
+  out[o] = '\0';
+}
+
+// Parses a base58 key. Returns false if it is not a valid 32-byte key.
+static inline bool decodeKey(const char* text, SolPubkey* key) {
+  uint8_t bytes[SIZE_PUBKEY] = {0};
+  uint64_t leadingZeros = 0;
+  for(const char* c = text; *c == '1'; c++) {
+    leadingZeros++;
+  }
+  for(const char* c = text; *c != '\0'; c++) {
+    const char* digit = strchr(base58Alphabet, *c);
+    if(digit == NULL) {
+      return false;
+    }
+    uint64_t carry = digit - base58Alphabet;
+    for(int i = SIZE_PUBKEY - 1; i >= 0; i--) {
+      carry += (uint64_t)bytes[i] * 58;
+      bytes[i] = carry & 0xFF;
+      carry >>= 8;
+    }
+    if(carry != 0) {
+      return false;
+    }
+  }
+  uint64_t significant = SIZE_PUBKEY;
+  while(significant > 0 && bytes[SIZE_PUBKEY - significant] == 0) {
+    significant--;
+  }
+  if(leadingZeros + significant > SIZE_PUBKEY) {
+    return false;
+  }
+  sol_memcpy(key->x, bytes, SIZE_PUBKEY);
+  return true;
+}
+
+// Account dumps
+// ----------------------------------------------------------------------------
+typedef struct {
+  const uint8_t* data;
+  uint64_t length;
+} Dump;
+
+// A single account of a dump
+typedef struct {
+  const SolPubkey* key;
+  uint8_t* data;
+  uint64_t length;
+} DumpAccount;
+
+static inline bool mapDump(const char* path, Dump* dump) {
+  int fd = open(path, O_RDONLY);
+  if(fd < 0) {
+    perror(path);
+    return false;
+  }
+  struct stat st;
+  if(fstat(fd, &st) != 0 || st.st_size == 0) {
+    fprintf(stderr, "%s: empty or unreadable dump\n", path);
+    close(fd);
+    return false;
+  }
+  // Private so the program's helpers may take non-const account data
+  void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(data == MAP_FAILED) {
+    perror("mmap");
+    return false;
+  }
+  dump->data = data;
+  dump->length = st.st_size;
+  return true;
+}
+
+// Reads the account at *offset and advances past it. Returns false at the
+// end of the dump or on a truncated entry.
+static inline bool nextAccount(Dump* dump, uint64_t* offset, DumpAccount* account) {
+  uint64_t header = sizeof(SolPubkey) + sizeof(uint64_t);
+  if(*offset + header > dump->length) {
+    return false;
+  }
+  uint64_t length;
+  sol_memcpy(&length, &dump->data[*offset + sizeof(SolPubkey)], sizeof(uint64_t));
+  if(length > dump->length - *offset - header) {
+    fprintf(stderr, "Truncated account at dump offset %lu\n", *offset);
+    return false;
+  }
+  account->key = (const SolPubkey*)&dump->data[*offset];
+  account->data = (uint8_t*)&dump->data[*offset + header];
+  account->length = length;
+  *offset += header + length;
+  return true;
+}
+
+// Returns the owner of the posts in a user account or page, or NULL if the
+// account holds no posts
+static inline const SolPubkey* postOwner(DumpAccount* account) {
+  if(account->length >= sizeof(UserPageMeta) && account->data[0] == UserPage) {
+    return &((UserPageMeta*)account->data)->owner;
+  }
+  if(account->length >= USER_V1_HEADER_SIZE && account->data[0] == User) {
+    return account->key;
+  }
+  return NULL;
+}
+
+// Calls visit(ctx, owner, index, record, idSize) for every live record of a
+// user account or page. Stops at the first record that would overrun the
+// account, so a corrupt account cannot make the indexer read out of bounds.
+typedef void (*RecordVisitor)(void* ctx, const SolPubkey* owner, uint64_t index,
+                              const uint8_t* record, uint64_t idSize);
+
+static inline void visitRecords(DumpAccount* account, RecordVisitor visit, void* ctx) {
+  const SolPubkey* owner = postOwner(account);
+  if(owner == NULL) {
+    return;
+  }
+  uint8_t* data = account->data;
+  uint64_t length = account->length;
+  if(isCurrentUser(data) && length < sizeof(AccountMetadata)) {
+    return;
+  }
+  uint64_t count = postCount(data);
+  uint64_t first = firstPostIndex(data);
+  uint64_t idSize = recordIdSize(data);
+  bool legacy = isLegacyUser(data);
+  if(!legacy && count * sizeof(PostSlot) > length) {
+    return;
+  }
+  uint64_t offset = USER_V1_HEADER_SIZE;
+  for(uint64_t i = 0; i < count; i++) {
+    if(!legacy) {
+      offset = postOffset(data, length, i);
+      if(offset == 0) {
+        continue;
+      }
+    }
+    if(offset + sizeof(uint16_t) > length ||
+       offset + sizeof(uint16_t) + *((uint16_t*)&data[offset]) > length) {
+      return;
+    }
+    visit(ctx, owner, first + i, &data[offset], idSize);
+    offset += sizeof(uint16_t) + *((uint16_t*)&data[offset]);
+  }
+}
@@ -0,0 +1,616 @@
+/**
+ * @brief Off-chain indexer for dumps of the forum program's accounts
+ *
+ * Memory-maps a dump of program accounts and builds a graph of every
+ * reply, like and report keyed by the PostID it references. Records are
+ * parsed in place with parseRecord() from helloworld.c, so the indexer
+ * follows the on-chain format of every account version and page. See
+ * dumps.h for the dump format.
+ *
+ * Usage:
+ *   index_helloworld DUMP                       print graph statistics
+ *   index_helloworld DUMP thread POSTER INDEX   print the thread of a post
+ *   index_helloworld DUMP reactions POSTER INDEX
+ *                                               print replies, likes and
+ *                                               reports of a post
+ *   index_helloworld DUMP timeline COUNT [SLOT POSTER INDEX]
+ *                                               print COUNT stamped posts of
+ *                                               every user, newest first,
+ *                                               after the given post
+ *   index_helloworld DUMP generate USERS POSTS  write a synthetic dump of
+ *                                               USERS accounts of POSTS posts
+ * POSTER is a base58 key. The timeline skips posts written without the
+ * Clock sysvar, as they have no slot to order them by.
+ */
+#include "../src/helloworld/helloworld.c"
+#include "syscall_stubs.h"
+#include "dumps.h"
+
+// Node index meaning "none"
+#define NO_NODE UINT32_MAX
+// Characters of a post body printed per line
+#define BODY_PREVIEW_LENGTH 60
+// Body length of synthetic posts
+#define GENERATED_BODY_LENGTH 16
+
+static SolPubkey programId = {.x = { 1, }};
+static uint64_t lamports = 1;
+
+// Post graph
+// ----------------------------------------------------------------------------
+// A post, or a post that is referenced but missing from the dump
+typedef struct {
+  PostID id;
+  const uint8_t* record; // NULL if missing from the dump
+  uint64_t idSize;       // PostID width of the record's account
+  uint32_t target;       // node referenced by a reply, like or report
+  uint32_t firstEdge;    // first entry of this node in Graph.edges
+} Node;
+
+// Nodes in an open-addressed hash table keyed by PostID, with the posts
+// referencing each node stored contiguously (compressed sparse rows)
+typedef struct {
+  Node* nodes;
+  uint64_t numNodes;
+  uint64_t capacity;
+  uint32_t* table;  // node index + 1, or 0 if empty
+  uint64_t tableMask;
+  uint32_t* edges;  // referencing nodes, grouped by referenced node
+  uint64_t numEdges;
+} Graph;
+
+static uint64_t hashPostID(const PostID* id) {
+  // Keys are ed25519 points, so any 8 of their bytes are well mixed
+  uint64_t h = *((uint64_t*)id->poster.x) ^ ((uint64_t)id->index * 0x9E3779B97F4A7C15ULL);
+  return h ^ (h >> 29);
+}
+
+// Returns the node of a PostID, adding a missing node for it if create is set
+static uint32_t findNode(Graph* graph, const PostID* id, bool create) {
+  uint64_t slot = hashPostID(id) & graph->tableMask;
+  while(graph->table[slot] != 0) {
+    uint32_t node = graph->table[slot] - 1;
+    if(samePost(&graph->nodes[node].id, id)) {
+      return node;
+    }
+    slot = (slot + 1) & graph->tableMask;
+  }
+  if(!create || graph->numNodes == graph->capacity) {
+    return NO_NODE;
+  }
+  uint32_t node = graph->numNodes++;
+  Node blank = { .id = *id, .record = NULL, .idSize = 0, .target = NO_NODE, .firstEdge = 0 };
+  graph->nodes[node] = blank;
+  graph->table[slot] = node + 1;
+  return node;
+}
+
+// Parses a node's record. Returns false for missing or invalid records.
+static bool nodePost(const Node* node, Post* post) {
+  if(node->record == NULL) {
+    return false;
+  }
+  return parseRecord(&node->record[sizeof(uint16_t)], *((uint16_t*)node->record),
+                     node->idSize, post) != 0;
+}
+
+static void countRecord(void* ctx, const SolPubkey* owner, uint64_t index,
+                        const uint8_t* record, uint64_t idSize) {
+  (*(uint64_t*)ctx)++;
+}
+
+static void addRecord(void* ctx, const SolPubkey* owner, uint64_t index,
+                      const uint8_t* record, uint64_t idSize) {
+  Graph* graph = ctx;
+  PostID id = { .poster = *owner, .index = index };
+  uint32_t node = findNode(graph, &id, true);
+  graph->nodes[node].record = record;
+  graph->nodes[node].idSize = idSize;
+}
+
+static bool buildGraph(Dump* dump, Graph* graph) {
+  // Size everything from a first pass over the headers and indexes. Every
+  // post references at most one missing post, so twice the post count
+  // bounds the nodes.
+  uint64_t numPosts = 0;
+  uint64_t offset = 0;
+  DumpAccount account;
+  while(nextAccount(dump, &offset, &account)) {
+    visitRecords(&account, countRecord, &numPosts);
+  }
+  graph->capacity = 2 * numPosts + 1;
+  uint64_t tableSize = 1;
+  while(tableSize < 2 * graph->capacity) {
+    tableSize <<= 1;
+  }
+  graph->tableMask = tableSize - 1;
+  graph->nodes = malloc(graph->capacity * sizeof(Node));
+  graph->table = calloc(tableSize, sizeof(uint32_t));
+  graph->numNodes = 0;
+  if(graph->nodes == NULL || graph->table == NULL) {
+    fprintf(stderr, "Not enough memory for %lu posts\n", numPosts);
+    return false;
+  }
+
+  offset = 0;
+  while(nextAccount(dump, &offset, &account)) {
+    visitRecords(&account, addRecord, graph);
+  }
+
+  // Resolve references, counting the edges into each node
+  uint64_t numPostNodes = graph->numNodes;
+  uint32_t* counts = calloc(graph->capacity + 1, sizeof(uint32_t));
+  for(uint64_t i = 0; i < numPostNodes; i++) {
+    Post post;
+    if(!nodePost(&graph->nodes[i], &post) || post.typeSelector == POST_SELECTOR) {
+      continue;
+    }
+    uint32_t target = findNode(graph, &post.id, true);
+    graph->nodes[i].target = target;
+    counts[target]++;
+  }
+
+  // Lay the edges out by referenced node, in dump order within each node
+  uint64_t total = 0;
+  for(uint64_t i = 0; i < graph->numNodes; i++) {
+    graph->nodes[i].firstEdge = total;
+    total += counts[i];
+    counts[i] = graph->nodes[i].firstEdge;
+  }
+  graph->edges = malloc((total + 1) * sizeof(uint32_t));
+  graph->numEdges = total;
+  for(uint64_t i = 0; i < numPostNodes; i++) {
+    uint32_t target = graph->nodes[i].target;
+    if(target != NO_NODE) {
+      graph->edges[counts[target]++] = i;
+    }
+  }
+  free(counts);
+  return graph->edges != NULL;
+}
+
+// Returns the end of a node's edges in Graph.edges
+static uint64_t edgesEnd(Graph* graph, uint32_t node) {
+  return node + 1 < graph->numNodes ? graph->nodes[node + 1].firstEdge : graph->numEdges;
+}
+
+// Queries
+// ----------------------------------------------------------------------------
+// Prints a post's ID, selector and the start of its body. record is NULL
+// for posts missing from the dump.
+static void printRecord(const PostID* id, const uint8_t* record, uint64_t idSize, uint64_t depth) {
+  char key[45];
+  encodeKey(&id->poster, key);
+  printf("%*s%s:%u ", (int)(2 * depth), "", key, id->index);
+  Post post;
+  if(record == NULL ||
+     parseRecord(&record[sizeof(uint16_t)], *((uint16_t*)record), idSize, &post) == 0) {
+    printf("(not in dump)\n");
+    return;
+  }
+  const uint8_t* body = post.body.immutable;
+  uint64_t bodyLength = post.bodyLength;
+  uint8_t decoded[UINT16_MAX];
+  if(post.compressed) {
+    bodyLength = decompressBody(post.body.immutable, post.bodyLength, decoded);
+    body = decoded;
+  }
+  uint64_t preview = bodyLength < BODY_PREVIEW_LENGTH ? bodyLength : BODY_PREVIEW_LENGTH;
+  printf("%c%s %.*s\n", post.typeSelector,
+         (record[sizeof(uint16_t)] & REDACTED_FLAG) ? " (redacted)" : "",
+         (int)preview, bodyLength > 0 ? (const char*)body : "");
+}
+
+static void printNode(Graph* graph, uint32_t node, uint64_t depth) {
+  Node* n = &graph->nodes[node];
+  printRecord(&n->id, n->record, n->idSize, depth);
+}
+
+static uint8_t nodeSelector(Graph* graph, uint32_t node) {
+  Post post;
+  return nodePost(&graph->nodes[node], &post) ? post.typeSelector : 0;
+}
+
+// Prints the thread containing a post: its root post and every reply
+// below it, depth first
+static void printThread(Graph* graph, uint32_t node) {
+  // Walk up through the posts this one replies to. The hop limit stops
+  // at cycles, which a dump can hold since replies are not validated.
+  uint32_t root = node;
+  for(uint64_t hops = 0; hops < graph->numNodes &&
+      nodeSelector(graph, root) == REPLY_SELECTOR && graph->nodes[root].target != NO_NODE; hops++) {
+    root = graph->nodes[root].target;
+  }
+
+  // Depth first with an explicit stack of (node, depth)
+  uint64_t capacity = 64;
+  uint64_t size = 0;
+  uint64_t* stack = malloc(capacity * sizeof(uint64_t));
+  uint8_t* visited = calloc(graph->numNodes, 1);
+  stack[size++] = (uint64_t)root << 32;
+  uint64_t printed = 0;
+  while(size > 0) {
+    uint64_t entry = stack[--size];
+    uint32_t current = entry >> 32;
+    uint32_t depth = entry & 0xFFFFFFFF;
+    if(visited[current]) {
+      continue;
+    }
+    visited[current] = 1;
+    printNode(graph, current, depth);
+    printed++;
+    // Push in reverse so replies print in dump order
+    uint64_t end = edgesEnd(graph, current);
+    for(uint64_t e = end; e > graph->nodes[current].firstEdge; e--) {
+      uint32_t child = graph->edges[e - 1];
+      if(nodeSelector(graph, child) != REPLY_SELECTOR) {
+        continue;
+      }
+      if(size == capacity) {
+        capacity *= 2;
+        stack = realloc(stack, capacity * sizeof(uint64_t));
+      }
+      stack[size++] = ((uint64_t)child << 32) | (depth + 1);
+    }
+  }
+  printf("%lu posts in thread\n", printed);
+  free(stack);
+  free(visited);
+}
+
+// Prints every reply, like and report of a post
+static void printReactions(Graph* graph, uint32_t node) {
+  uint64_t replies = 0, likes = 0, reports = 0;
+  printNode(graph, node, 0);
+  for(uint64_t e = graph->nodes[node].firstEdge; e < edgesEnd(graph, node); e++) {
+    uint32_t child = graph->edges[e];
+    switch(nodeSelector(graph, child)) {
+    case REPLY_SELECTOR:
+      replies++;
+      break;
+    case LIKE_SELECTOR:
+      likes++;
+      break;
+    case REPORT_SELECTOR:
+      reports++;
+      break;
+    default:
+      break;
+    }
+    printNode(graph, child, 1);
+  }
+  printf("%lu replies, %lu likes, %lu reports\n", replies, likes, reports);
+}
+
+// Global timeline
+// ----------------------------------------------------------------------------
+// A stamped post, ordered newest first by slot, then by poster key and
+// index so posts of the same slot have a stable order
+typedef struct {
+  uint64_t slot;
+  PostID id;
+  const uint8_t* record;
+  uint64_t idSize;
+} TimelineEntry;
+
+// A user account or continuation page
+typedef struct {
+  const SolPubkey* owner;
+  DumpAccount account;
+  uint64_t firstPost;
+} Segment;
+
+// Walks one user's posts from newest to oldest. Segments are sorted oldest
+// first and a segment is only read once every newer one is used up, so a
+// page of the timeline only touches the tail pages it needs.
+typedef struct {
+  Segment* segments;
+  uint64_t numSegments;
+  uint64_t segment; // current segment + 1, 0 once every one is used up
+  uint64_t post;    // posts of the current segment not yet walked
+  TimelineEntry current;
+} Cursor;
+
+// Returns a positive number if a comes before b in the timeline
+static int compareEntries(const TimelineEntry* a, const TimelineEntry* b) {
+  if(a->slot != b->slot) {
+    return a->slot > b->slot ? 1 : -1;
+  }
+  int poster = sol_memcmp(a->id.poster.x, b->id.poster.x, SIZE_PUBKEY);
+  if(poster != 0) {
+    return poster;
+  }
+  return a->id.index == b->id.index ? 0 : (a->id.index > b->id.index ? 1 : -1);
+}
+
+static int compareSegments(const void* a, const void* b) {
+  const Segment* x = a;
+  const Segment* y = b;
+  int owner = sol_memcmp(x->owner->x, y->owner->x, SIZE_PUBKEY);
+  if(owner != 0) {
+    return owner;
+  }
+  return x->firstPost == y->firstPost ? 0 : (x->firstPost > y->firstPost ? 1 : -1);
+}
+
+// Returns the number of posts indexed in a segment. Only version 2 records
+// carry stamps, so older accounts and corrupt indexes count as empty.
+static uint64_t segmentPosts(Segment* segment) {
+  uint8_t* data = segment->account.data;
+  uint64_t length = segment->account.length;
+  if(!isCurrentUser(data) || (data[0] == User && length < sizeof(AccountMetadata))) {
+    return 0;
+  }
+  uint64_t count = postCount(data);
+  return count * sizeof(PostSlot) > length ? 0 : count;
+}
+
+// Moves a cursor to the user's next older stamped post. Returns false once
+// there is none left.
+static bool advanceCursor(Cursor* cursor) {
+  while(cursor->segment > 0) {
+    Segment* segment = &cursor->segments[cursor->segment - 1];
+    uint8_t* data = segment->account.data;
+    uint64_t length = segment->account.length;
+    while(cursor->post > 0) {
+      uint64_t i = --cursor->post;
+      uint64_t offset = postOffset(data, length, i);
+      if(offset < sizeof(SlotStamp) || offset + sizeof(uint16_t) > length ||
+         offset + sizeof(uint16_t) + *((uint16_t*)&data[offset]) > length) {
+        continue;
+      }
+      uint64_t slot = postStamp(data, length, i);
+      if(slot == 0) {
+        continue;
+      }
+      cursor->current.slot = slot;
+      cursor->current.id.poster = *segment->owner;
+      cursor->current.id.index = segment->firstPost + i;
+      cursor->current.record = &data[offset];
+      cursor->current.idSize = recordIdSize(data);
+      return true;
+    }
+    if(--cursor->segment > 0) {
+      cursor->post = segmentPosts(&cursor->segments[cursor->segment - 1]);
+    }
+  }
+  return false;
+}
+
+// Restores the max-heap order of heap[i] and its children
+static void siftDown(Cursor** heap, uint64_t size, uint64_t i) {
+  while(true) {
+    uint64_t first = i;
+    for(uint64_t child = 2 * i + 1; child <= 2 * i + 2 && child < size; child++) {
+      if(compareEntries(&heap[child]->current, &heap[first]->current) > 0) {
+        first = child;
+      }
+    }
+    if(first == i) {
+      return;
+    }
+    Cursor* swap = heap[i];
+    heap[i] = heap[first];
+    heap[first] = swap;
+    i = first;
+  }
+}
+
+// Prints count stamped posts of every user, newest first, starting after
+// the entry after if it is not NULL. Each user's posts are already in slot
+// order, so a k-way merge over a heap of per-user cursors produces the
+// timeline without sorting or indexing the dump.
+static int printTimeline(Dump* dump, uint64_t count, const TimelineEntry* after) {
+  uint64_t numSegments = 0;
+  uint64_t offset = 0;
+  DumpAccount account;
+  while(nextAccount(dump, &offset, &account)) {
+    numSegments += postOwner(&account) != NULL;
+  }
+  Segment* segments = malloc((numSegments + 1) * sizeof(Segment));
+  Cursor* cursors = malloc((numSegments + 1) * sizeof(Cursor));
+  Cursor** heap = malloc((numSegments + 1) * sizeof(Cursor*));
+  if(segments == NULL || cursors == NULL || heap == NULL) {
+    fprintf(stderr, "Not enough memory for %lu accounts\n", numSegments);
+    return 1;
+  }
+  uint64_t s = 0;
+  offset = 0;
+  while(nextAccount(dump, &offset, &account)) {
+    const SolPubkey* owner = postOwner(&account);
+    if(owner != NULL) {
+      segments[s].owner = owner;
+      segments[s].account = account;
+      segments[s].firstPost = firstPostIndex(account.data);
+      s++;
+    }
+  }
+  qsort(segments, numSegments, sizeof(Segment), compareSegments);
+
+  // One cursor per user, positioned at its newest post after the given one
+  uint64_t size = 0;
+  uint64_t numCursors = 0;
+  for(uint64_t first = 0; first < numSegments; ) {
+    uint64_t end = first + 1;
+    while(end < numSegments && SolPubkey_same(segments[end].owner, segments[first].owner)) {
+      end++;
+    }
+    Cursor* cursor = &cursors[numCursors++];
+    cursor->segments = &segments[first];
+    cursor->numSegments = end - first;
+    cursor->segment = cursor->numSegments;
+    cursor->post = segmentPosts(&segments[end - 1]);
+    bool found = advanceCursor(cursor);
+    while(found && after != NULL && compareEntries(&cursor->current, after) >= 0) {
+      found = advanceCursor(cursor);
+    }
+    if(found) {
+      heap[size++] = cursor;
+    }
+    first = end;
+  }
+  for(uint64_t i = size / 2; i > 0; i--) {
+    siftDown(heap, size, i - 1);
+  }
+
+  TimelineEntry last = {0};
+  uint64_t printed = 0;
+  while(printed < count && size > 0) {
+    Cursor* newest = heap[0];
+    last = newest->current;
+    printf("%lu ", last.slot);
+    printRecord(&last.id, last.record, last.idSize, 0);
+    printed++;
+    if(!advanceCursor(newest)) {
+      heap[0] = heap[--size];
+    }
+    siftDown(heap, size, 0);
+  }
+
+  uint64_t segmentsRead = 0;
+  for(uint64_t i = 0; i < numCursors; i++) {
+    segmentsRead += cursors[i].numSegments - cursors[i].segment + (cursors[i].segment > 0);
+  }
+  printf("%lu posts from %lu of %lu accounts and pages\n", printed, segmentsRead, numSegments);
+  if(printed == count && size > 0) {
+    char key[45];
+    encodeKey(&last.id.poster, key);
+    printf("Next page after: %lu %s %u\n", last.slot, key, last.id.index);
+  }
+  free(heap);
+  free(cursors);
+  free(segments);
+  return 0;
+}
+
+// Synthetic dumps
+// ----------------------------------------------------------------------------
+static SolPubkey generatedKey(uint64_t user) {
+  SolPubkey key = {0};
+  uint64_t value = (user + 1) * 0x9E3779B97F4A7C15ULL;
+  sol_memcpy(key.x, &value, sizeof(uint64_t));
+  sol_memcpy(&key.x[sizeof(uint64_t)], &user, sizeof(uint64_t));
+  return key;
+}
+
+// Writes users accounts of posts posts each, created through the program
+// itself. A quarter are posts and the rest reply to, like or report a
+// random earlier post. Posts are stamped as if the users took turns
+// posting one per slot.
+static int generateDump(const char* path, uint64_t users, uint64_t posts) {
+  FILE* out = fopen(path, "wb");
+  if(out == NULL) {
+    perror(path);
+    return 1;
+  }
+  uint64_t recordSize = sizeof(SlotStamp) + alignRecord(sizeof(uint16_t) + 1 + sizeof(PostID) + GENERATED_BODY_LENGTH);
+  uint64_t length = sizeof(AccountMetadata) + posts * (recordSize + sizeof(PostSlot));
+  uint8_t* data = malloc(length);
+  uint8_t instruction[1 + sizeof(PostID) + GENERATED_BODY_LENGTH];
+  static const uint8_t selectors[] = { POST_SELECTOR, REPLY_SELECTOR, LIKE_SELECTOR, REPORT_SELECTOR };
+  uint64_t seed = 1;
+  for(uint64_t u = 0; u < users; u++) {
+    SolPubkey key = generatedKey(u);
+    uint64_t clock = 0;
+    SolAccountInfo accounts[] = {
+      { &key, &lamports, length, data, &programId, 0, true, true, false },
+      { (SolPubkey*)&clockSysvarId, &lamports, sizeof(clock), (uint8_t*)&clock, &programId, 0, false, false, false },
+    };
+    sol_memset(data, 0, length);
+    for(uint64_t p = 0; p < posts; p++) {
+      seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+      uint8_t selector = p == 0 ? POST_SELECTOR : selectors[(seed >> 33) % 4];
+      uint64_t l = 0;
+      instruction[l++] = selector;
+      if(selector != POST_SELECTOR) {
+        PostID target = { .poster = generatedKey((seed >> 17) % (u + 1)), .index = (seed >> 40) % p };
+        sol_memcpy(&instruction[l], &target, sizeof(PostID));
+        l += sizeof(PostID);
+      }
+      if(selector != LIKE_SELECTOR) {
+        int body = snprintf((char*)&instruction[l], GENERATED_BODY_LENGTH, "post %lu of %lu", p, u);
+        l += body < GENERATED_BODY_LENGTH ? body : GENERATED_BODY_LENGTH - 1;
+      }
+      clock = p * users + u + 1;
+      SolParameters params = { accounts, 2, instruction, l, &programId };
+      if(helloworld(&params) != SUCCESS) {
+        fprintf(stderr, "Failed to generate post %lu of user %lu\n", p, u);
+        return 1;
+      }
+    }
+    fwrite(&key, sizeof(SolPubkey), 1, out);
+    fwrite(&length, sizeof(uint64_t), 1, out);
+    fwrite(data, length, 1, out);
+  }
+  free(data);
+  fclose(out);
+  printf("Wrote %lu accounts with %lu posts to %s\n", users, users * posts, path);
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  if(argc < 2) {
+    fprintf(stderr, "Usage: %s DUMP [thread|reactions POSTER INDEX | timeline COUNT [SLOT POSTER INDEX] | "
+            "generate USERS POSTS]\n", argv[0]);
+    return 1;
+  }
+  if(argc == 5 && strcmp(argv[2], "generate") == 0) {
+    return generateDump(argv[1], strtoull(argv[3], NULL, 10), strtoull(argv[4], NULL, 10));
+  }
+
+  Dump dump;
+  if(!mapDump(argv[1], &dump)) {
+    return 1;
+  }
+  uint64_t start = nowNanos();
+
+  // The timeline merges per-user logs straight from the dump, no graph
+  if((argc == 4 || argc == 7) && strcmp(argv[2], "timeline") == 0) {
+    TimelineEntry after;
+    if(argc == 7) {
+      after.slot = strtoull(argv[4], NULL, 10);
+      if(!decodeKey(argv[5], &after.id.poster)) {
+        fprintf(stderr, "Invalid poster key: %s\n", argv[5]);
+        return 1;
+      }
+      after.id.index = strtoul(argv[6], NULL, 10);
+    }
+    int result = printTimeline(&dump, strtoull(argv[3], NULL, 10), argc == 7 ? &after : NULL);
+    printf("Timeline took %.3f ms\n", millisSince(start));
+    return result;
+  }
+
+  Graph graph;
+  if(!buildGraph(&dump, &graph)) {
+    return 1;
+  }
+  printf("Indexed %lu posts (with referenced placeholders) and %lu references in %.1f ms\n",
+         graph.numNodes, graph.numEdges, millisSince(start));
+
+  if(argc == 5) {
+    PostID id;
+    if(!decodeKey(argv[3], &id.poster)) {
+      fprintf(stderr, "Invalid poster key: %s\n", argv[3]);
+      return 1;
+    }
+    id.index = strtoul(argv[4], NULL, 10);
+    start = nowNanos();
+    uint32_t node = findNode(&graph, &id, false);
+    if(node == NO_NODE) {
+      fprintf(stderr, "Post %s:%u is not in the dump\n", argv[3], id.index);
+      return 1;
+    }
+    if(strcmp(argv[2], "thread") == 0) {
+      printThread(&graph, node);
+    }
+    else if(strcmp(argv[2], "reactions") == 0) {
+      printReactions(&graph, node);
+    }
+    else {
+      fprintf(stderr, "Unknown query: %s\n", argv[2]);
+      return 1;
+    }
+    printf("Query took %.3f ms\n", millisSince(start));
+  }
+  return 0;
+}
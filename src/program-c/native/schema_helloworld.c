@@ -0,0 +1,479 @@
+/**
+ * @brief Generates the client's view of the forum program's accounts
+ *
+ * The client decoder in src/client/decoder.ts reads accounts through the
+ * offsets in src/client/layout.ts, which this tool writes from the struct
+ * definitions in helloworld.c, so the compiler's layout is the only one.
+ *
+ * It also writes decoder fixtures: accounts built through helloworld()
+ * in the scenarios of test_helloworld.c (counted posts and their
+ * reactions, redaction, legacy and version 1 accounts, migration,
+ * compaction, pages and compressed bodies), in the dump format of index_helloworld.c, with
+ * the records the program itself reads from them as JSON.
+ *
+ * Usage:
+ *   schema_helloworld layout OUT.ts       write the generated layout
+ *   schema_helloworld fixtures PREFIX     write PREFIX.bin and PREFIX.json
+ */
+#include "../src/helloworld/helloworld.c"
+#include "syscall_stubs.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// Size of every fixture account
+#define FIXTURE_ACCOUNT_SIZE 256
+
+static SolPubkey programId = {.x = { 1, }};
+static uint64_t lamports = 1;
+
+static void printHex(FILE* out, const uint8_t* bytes, uint64_t length) {
+  fputc('"', out);
+  for(uint64_t i = 0; i < length; i++) {
+    fprintf(out, "%02x", bytes[i]);
+  }
+  fputc('"', out);
+}
+
+// Generated layout
+// ----------------------------------------------------------------------------
+#define BEGIN_STRUCT(type) \
+  fprintf(out, "/** %s in helloworld.c */\nexport const %s = {\n  size: %lu,\n", #type, #type, sizeof(type))
+#define FIELD(type, field) fprintf(out, "  %s: %lu,\n", #field, OFFSETOF(type, field))
+#define END_STRUCT() fprintf(out, "} as const;\n\n")
+#define CONSTANT(name) fprintf(out, "export const %s = %lu;\n", #name, (uint64_t)(name))
+
+static int writeLayout(const char* path) {
+  FILE* out = fopen(path, "w");
+  if(out == NULL) {
+    perror(path);
+    return 1;
+  }
+  fprintf(out, "// Generated by src/program-c/native/schema_helloworld.c from the structs in\n"
+               "// helloworld.c. Do not edit, run `make -C src/program-c schema` instead.\n\n");
+
+  BEGIN_STRUCT(PostID);
+  FIELD(PostID, poster);
+  FIELD(PostID, index);
+  END_STRUCT();
+
+  BEGIN_STRUCT(PostIDV1);
+  FIELD(PostIDV1, poster);
+  FIELD(PostIDV1, index);
+  END_STRUCT();
+
+  BEGIN_STRUCT(AccountMetadata);
+  FIELD(AccountMetadata, accountType);
+  FIELD(AccountMetadata, version);
+  FIELD(AccountMetadata, numPostsV1);
+  FIELD(AccountMetadata, username);
+  FIELD(AccountMetadata, tailOffset);
+  FIELD(AccountMetadata, reputation);
+  FIELD(AccountMetadata, numPosts);
+  FIELD(AccountMetadata, numPages);
+  END_STRUCT();
+
+  BEGIN_STRUCT(UserPageMeta);
+  FIELD(UserPageMeta, accountType);
+  FIELD(UserPageMeta, version);
+  FIELD(UserPageMeta, owner);
+  FIELD(UserPageMeta, tailOffset);
+  FIELD(UserPageMeta, firstPost);
+  FIELD(UserPageMeta, page);
+  FIELD(UserPageMeta, numPosts);
+  END_STRUCT();
+
+  BEGIN_STRUCT(PostCounters);
+  FIELD(PostCounters, likes);
+  FIELD(PostCounters, replies);
+  FIELD(PostCounters, reports);
+  END_STRUCT();
+
+  BEGIN_STRUCT(CounterShardMeta);
+  FIELD(CounterShardMeta, accountType);
+  FIELD(CounterShardMeta, shard);
+  FIELD(CounterShardMeta, shardCount);
+  FIELD(CounterShardMeta, post);
+  FIELD(CounterShardMeta, counters);
+  END_STRUCT();
+
+  BEGIN_STRUCT(PetitionAccountMeta);
+  FIELD(PetitionAccountMeta, accountType);
+  FIELD(PetitionAccountMeta, layout);
+  FIELD(PetitionAccountMeta, completed);
+  FIELD(PetitionAccountMeta, offendingPost);
+  FIELD(PetitionAccountMeta, netTally);
+  FIELD(PetitionAccountMeta, reputationRequirement);
+  FIELD(PetitionAccountMeta, numSignatures);
+  FIELD(PetitionAccountMeta, hashSlots);
+  END_STRUCT();
+
+  BEGIN_STRUCT(PetitionAccountMetaV1);
+  FIELD(PetitionAccountMetaV1, accountType);
+  FIELD(PetitionAccountMetaV1, layout);
+  FIELD(PetitionAccountMetaV1, offendingPost);
+  FIELD(PetitionAccountMetaV1, completed);
+  FIELD(PetitionAccountMetaV1, votesFor);
+  FIELD(PetitionAccountMetaV1, netTally);
+  FIELD(PetitionAccountMetaV1, reputationRequirement);
+  FIELD(PetitionAccountMetaV1, numSignatures);
+  FIELD(PetitionAccountMetaV1, hashSlots);
+  END_STRUCT();
+
+  BEGIN_STRUCT(PetitionPoolMeta);
+  FIELD(PetitionPoolMeta, accountType);
+  FIELD(PetitionPoolMeta, numSlots);
+  FIELD(PetitionPoolMeta, firstUnused);
+  FIELD(PetitionPoolMeta, freeHead);
+  FIELD(PetitionPoolMeta, slotSize);
+  FIELD(PetitionPoolMeta, openPetitions);
+  END_STRUCT();
+
+  BEGIN_STRUCT(PetitionPoolSlot);
+  FIELD(PetitionPoolSlot, generation);
+  FIELD(PetitionPoolSlot, nextFree);
+  FIELD(PetitionPoolSlot, unclaimed);
+  END_STRUCT();
+
+  fprintf(out, "// Account types\n");
+  fprintf(out, "export const USER_ACCOUNT_TYPE = %d;\n", User);
+  fprintf(out, "export const PETITION_ACCOUNT_TYPE = %d;\n", Petition);
+  fprintf(out, "export const COUNTER_SHARD_ACCOUNT_TYPE = %d;\n", CounterShard);
+  fprintf(out, "export const USER_PAGE_ACCOUNT_TYPE = %d;\n", UserPage);
+  fprintf(out, "export const PETITION_POOL_ACCOUNT_TYPE = %d;\n\n", PetitionPool);
+
+  fprintf(out, "// User accounts and records\n");
+  CONSTANT(SIZE_PUBKEY);
+  CONSTANT(USER_VERSION_1);
+  CONSTANT(USER_VERSION_2);
+  CONSTANT(USER_V1_HEADER_SIZE);
+  CONSTANT(RECORD_ALIGNMENT);
+  fprintf(out, "export const POST_SLOT_SIZE = %lu;\n", sizeof(PostSlot));
+  CONSTANT(STAMPED_RECORD);
+  fprintf(out, "export const SLOT_STAMP_SIZE = %lu;\n", sizeof(SlotStamp));
+  CONSTANT(POST_SELECTOR);
+  CONSTANT(REPLY_SELECTOR);
+  CONSTANT(LIKE_SELECTOR);
+  CONSTANT(REPORT_SELECTOR);
+  CONSTANT(COUNTERS_FLAG);
+  CONSTANT(REDACTED_FLAG);
+  CONSTANT(COMPRESSED_FLAG);
+
+  fprintf(out, "\n// Compressed bodies\n");
+  CONSTANT(MIN_BODY_MATCH);
+  CONSTANT(LITERAL_TOKEN_LIMIT);
+  CONSTANT(WORD_TOKEN_LIMIT);
+  fprintf(out, "export const BODY_DICTIONARY = [");
+  for(uint64_t i = 0; i < SOL_ARRAY_SIZE(bodyDictionary); i++) {
+    fprintf(out, i % 8 == 0 ? "\n  " : " ");
+    printHex(out, (const uint8_t*)bodyDictionary[i].text, bodyDictionary[i].length);
+    fprintf(out, ",");
+  }
+  fprintf(out, "\n].map(word => Buffer.from(word, 'hex'));\n");
+  fprintf(out, "\n// Petitions\n");
+  CONSTANT(PETITION_LAYOUT_RECORDS);
+  CONSTANT(PETITION_LAYOUT_COLUMNS);
+  CONSTANT(PETITION_LAYOUT_V2);
+  CONSTANT(PETITION_OPEN);
+  CONSTANT(PETITION_SETTLED);
+  CONSTANT(PETITION_FINALIZED);
+  CONSTANT(PETITION_REF_SIZE);
+  CONSTANT(CREATE_POOL_SELECTOR);
+
+  fclose(out);
+  return 0;
+}
+
+// Fixtures
+// ----------------------------------------------------------------------------
+typedef struct {
+  SolPubkey key;
+  uint8_t data[FIXTURE_ACCOUNT_SIZE];
+} Fixture;
+
+static SolAccountInfo fixtureAccount(Fixture* fixture, bool isSigner) {
+  SolAccountInfo account = { &fixture->key, &lamports, sizeof(fixture->data), fixture->data,
+                             &programId, 0, isSigner, true, false };
+  return account;
+}
+
+static bool run(SolAccountInfo* accounts, uint64_t count, const uint8_t* instruction, uint64_t length) {
+  SolParameters params = { accounts, count, instruction, length, &programId };
+  return helloworld(&params) == SUCCESS;
+}
+
+// Writes a record to a version 1 account and returns the offset after it
+static uint64_t writeRecordV1(uint8_t* data, uint64_t offset, const uint8_t* record, uint16_t length) {
+  sol_memcpy(&data[offset], &length, sizeof(uint16_t));
+  sol_memcpy(&data[offset + sizeof(uint16_t)], record, length);
+  return offset + sizeof(uint16_t) + length;
+}
+
+// A counted post and a plain one, liked, replied to and reported by a fan,
+// then the counted post redacted
+static bool buildCounters(Fixture* poster, Fixture* fan) {
+  SolAccountInfo accounts[] = { fixtureAccount(fan, true), fixtureAccount(poster, false) };
+  uint8_t counted[1 + sizeof(PostCounters) + 3] = { POST_SELECTOR | COUNTERS_FLAG };
+  sol_memcpy(&counted[1 + sizeof(PostCounters)], "hot", 3);
+  accounts[1].is_signer = true;
+  if(!run(&accounts[1], 1, counted, sizeof(counted)) ||
+     !run(&accounts[1], 1, (const uint8_t*)"Pcold", 5)) {
+    return false;
+  }
+  accounts[1].is_signer = false;
+  PostID hot = { .poster = poster->key, .index = 0 };
+  uint8_t like[1 + sizeof(PostID)] = { LIKE_SELECTOR };
+  sol_memcpy(&like[1], &hot, sizeof(PostID));
+  uint8_t reply[1 + sizeof(PostID) + 2] = { REPLY_SELECTOR };
+  sol_memcpy(&reply[1], &hot, sizeof(PostID));
+  sol_memcpy(&reply[1 + sizeof(PostID)], "me", 2);
+  uint8_t report[1 + sizeof(PostID) + 2] = { REPORT_SELECTOR };
+  sol_memcpy(&report[1], &hot, sizeof(PostID));
+  sol_memcpy(&report[1 + sizeof(PostID)], "no", 2);
+  if(!run(accounts, 2, like, sizeof(like)) || !run(accounts, 2, like, sizeof(like)) ||
+     !run(accounts, 2, reply, sizeof(reply)) || !run(accounts, 2, report, sizeof(report))) {
+    return false;
+  }
+  redactPost(&accounts[1], 0);
+  return true;
+}
+
+// A legacy account: a post, a like of it and a counted report of it, with
+// 16-bit PostIDs and no index
+static void buildLegacy(Fixture* fixture) {
+  uint8_t* data = fixture->data;
+  AccountMetadata* meta = (AccountMetadata*)data;
+  meta->accountType = User;
+  meta->version = USER_VERSION_1;
+  meta->reputation = 5;
+  meta->numPostsV1 = 3;
+  PostIDV1 target = { .poster = fixture->key, .index = 0 };
+  uint8_t like[1 + sizeof(PostIDV1)] = { LIKE_SELECTOR };
+  sol_memcpy(&like[1], &target, sizeof(PostIDV1));
+  uint8_t report[1 + sizeof(PostCounters) + sizeof(PostIDV1) + 4] = { REPORT_SELECTOR | COUNTERS_FLAG };
+  PostCounters counters = { .likes = 1, .replies = 2, .reports = 3 };
+  sol_memcpy(&report[1], &counters, sizeof(PostCounters));
+  sol_memcpy(&report[1 + sizeof(PostCounters)], &target, sizeof(PostIDV1));
+  sol_memcpy(&report[1 + sizeof(PostCounters) + sizeof(PostIDV1)], "spam", 4);
+  uint64_t offset = writeRecordV1(data, USER_V1_HEADER_SIZE, (const uint8_t*)"Ptest", 5);
+  offset = writeRecordV1(data, offset, like, sizeof(like));
+  writeRecordV1(data, offset, report, sizeof(report));
+}
+
+// An indexed version 1 account after compaction: a tombstone, then a
+// redacted reply stored past a gap
+static void buildIndexedV1(Fixture* fixture) {
+  uint8_t* data = fixture->data;
+  AccountMetadata* meta = (AccountMetadata*)data;
+  meta->accountType = User;
+  meta->version = USER_VERSION_1;
+  meta->numPostsV1 = 3;
+  PostIDV1 target = { .poster = fixture->key, .index = 1 };
+  uint8_t reply[1 + sizeof(PostIDV1) + 5] = { REPLY_SELECTOR };
+  sol_memcpy(&reply[1], &target, sizeof(PostIDV1));
+  sol_memcpy(&reply[1 + sizeof(PostIDV1)], "Reply", 5);
+  uint64_t offset = writeRecordV1(data, USER_V1_HEADER_SIZE, (const uint8_t*)"Pfirst", 6);
+  *postSlot(data, sizeof(fixture->data), 0) = USER_V1_HEADER_SIZE;
+  *postSlot(data, sizeof(fixture->data), 1) = 0;
+  *postSlot(data, sizeof(fixture->data), 2) = offset + 3;
+  meta->tailOffset = writeRecordV1(data, offset + 3, reply, sizeof(reply));
+  SolAccountInfo account = fixtureAccount(fixture, true);
+  redactPost(&account, 2);
+}
+
+static bool buildMigrated(Fixture* fixture) {
+  buildLegacy(fixture);
+  SolAccountInfo account = fixtureAccount(fixture, true);
+  return run(&account, 1, (const uint8_t*)"M", 1) && run(&account, 1, (const uint8_t*)"Pnew", 4);
+}
+
+// Post, like, reply, post, with the first redacted and the like compacted away
+static bool buildCompacted(Fixture* fixture) {
+  SolAccountInfo account = fixtureAccount(fixture, true);
+  PostID target = { .poster = fixture->key, .index = 0 };
+  uint8_t like[1 + sizeof(PostID)] = { LIKE_SELECTOR };
+  sol_memcpy(&like[1], &target, sizeof(PostID));
+  uint8_t reply[1 + sizeof(PostID) + 5] = { REPLY_SELECTOR };
+  sol_memcpy(&reply[1], &target, sizeof(PostID));
+  sol_memcpy(&reply[1 + sizeof(PostID)], "reply", 5);
+  if(!run(&account, 1, (const uint8_t*)"Pa rude post", 12) || !run(&account, 1, like, sizeof(like)) ||
+     !run(&account, 1, reply, sizeof(reply)) || !run(&account, 1, (const uint8_t*)"Plast", 5)) {
+    return false;
+  }
+  redactPost(&account, 0);
+  uint8_t compact[COMPACT_INSTRUCTION_SIZE] = { COMPACT_SELECTOR, COMPACT_DROP_LIKES, 0, 0, 0, 0, 4, 0, 0, 0 };
+  return run(&account, 1, compact, sizeof(compact));
+}
+
+// A post in the user account and a counted one in its first page
+static bool buildPages(Fixture* poster, Fixture* page) {
+  pageAddress(&poster->key, 1, &programId, &page->key);
+  SolAccountInfo accounts[] = { fixtureAccount(poster, true), fixtureAccount(page, false) };
+  uint8_t counted[1 + sizeof(PostCounters) + 4] = { POST_SELECTOR | COUNTERS_FLAG };
+  sol_memcpy(&counted[1 + sizeof(PostCounters)], "page", 4);
+  return run(accounts, 1, (const uint8_t*)"Pfirst", 6) && run(accounts, 2, (const uint8_t*)"N", 1) &&
+         run(accounts, 2, counted, sizeof(counted));
+}
+
+// A compressed post, a counted compressed reply to it, and a compressed
+// post that was then redacted
+static bool buildCompressed(Fixture* fixture) {
+  SolAccountInfo account = fixtureAccount(fixture, true);
+  // "hello", the " the " word, a 10 byte match 10 back, then "hello!"
+  uint8_t post[] = { COMPRESSED_POST_SELECTOR, 26, 0,
+                     4, 'h', 'e', 'l', 'l', 'o', LITERAL_TOKEN_LIMIT, WORD_TOKEN_LIMIT + 10 - MIN_BODY_MATCH, 10, 0,
+                     5, 'h', 'e', 'l', 'l', 'o', '!' };
+  PostID target = { .poster = fixture->key, .index = 0 };
+  uint8_t reply[1 + sizeof(PostCounters) + sizeof(PostID) + 3] = { COMPRESSED_REPLY_SELECTOR | COUNTERS_FLAG };
+  sol_memcpy(&reply[1 + sizeof(PostCounters)], &target, sizeof(PostID));
+  uint8_t replyBody[] = { 4, 0, LITERAL_TOKEN_LIMIT + 57 }; // "The "
+  sol_memcpy(&reply[1 + sizeof(PostCounters) + sizeof(PostID)], replyBody, sizeof(replyBody));
+  if(!run(&account, 1, post, sizeof(post)) || !run(&account, 1, reply, sizeof(reply)) ||
+     !run(&account, 1, post, sizeof(post))) {
+    return false;
+  }
+  redactPost(&account, 2);
+  return true;
+}
+
+// A post stamped in slot 7, an unstamped like of it and a reply stamped in
+// slot 9, compacted after redacting the post so the stamps move
+static bool buildStamped(Fixture* fixture) {
+  uint64_t clock = 7;
+  SolAccountInfo accounts[] = {
+    fixtureAccount(fixture, true),
+    { (SolPubkey*)&clockSysvarId, &lamports, sizeof(clock), (uint8_t*)&clock, &programId, 0, false, false, false },
+  };
+  PostID target = { .poster = fixture->key, .index = 0 };
+  uint8_t like[1 + sizeof(PostID)] = { LIKE_SELECTOR };
+  sol_memcpy(&like[1], &target, sizeof(PostID));
+  uint8_t reply[1 + sizeof(PostID) + 4] = { REPLY_SELECTOR };
+  sol_memcpy(&reply[1], &target, sizeof(PostID));
+  sol_memcpy(&reply[1 + sizeof(PostID)], "late", 4);
+  if(!run(accounts, 2, (const uint8_t*)"Pstamped post", 13) || !run(accounts, 1, like, sizeof(like))) {
+    return false;
+  }
+  clock = 9;
+  if(!run(accounts, 2, reply, sizeof(reply))) {
+    return false;
+  }
+  redactPost(&accounts[0], 0);
+  uint8_t compact[COMPACT_INSTRUCTION_SIZE] = { COMPACT_SELECTOR, 0, 0, 0, 0, 0, 3, 0, 0, 0 };
+  return run(accounts, 1, compact, sizeof(compact));
+}
+
+// Writes the records of a user account or page as the program reads them,
+// with null for dropped records
+static void printRecords(FILE* out, Fixture* fixture) {
+  uint8_t* data = fixture->data;
+  uint64_t idSize = recordIdSize(data);
+  uint64_t first = firstPostIndex(data);
+  fprintf(out, "{\"key\": ");
+  printHex(out, fixture->key.x, SIZE_PUBKEY);
+  fprintf(out, ", \"records\": [");
+  for(uint64_t i = 0; i < postCount(data); i++) {
+    fprintf(out, i == 0 ? "\n    " : ",\n    ");
+    uint64_t offset = postOffset(data, sizeof(fixture->data), i);
+    Post p;
+    if(offset == 0 ||
+       parseRecord(&data[offset + sizeof(uint16_t)], *(uint16_t*)&data[offset], idSize, &p) == 0) {
+      fprintf(out, "null");
+      continue;
+    }
+    const uint8_t* record = &data[offset + sizeof(uint16_t)];
+    fprintf(out, "{\"index\": %lu, \"slot\": ", first + i);
+    uint64_t slot = postStamp(data, sizeof(fixture->data), i);
+    if(slot != 0) {
+      fprintf(out, "%lu", slot);
+    }
+    else {
+      fprintf(out, "null");
+    }
+    fprintf(out, ", \"selector\": \"%c\", \"redacted\": %s, \"counters\": ",
+            p.typeSelector, (*record & REDACTED_FLAG) ? "true" : "false");
+    if(p.hasCounters) {
+      PostCounters* counters = (PostCounters*)&record[1];
+      fprintf(out, "[%u, %u, %u]", counters->likes, counters->replies, counters->reports);
+    }
+    else {
+      fprintf(out, "null");
+    }
+    fprintf(out, ", \"target\": ");
+    if(p.typeSelector == POST_SELECTOR) {
+      fprintf(out, "null");
+    }
+    else {
+      fprintf(out, "{\"poster\": ");
+      printHex(out, p.id.poster.x, SIZE_PUBKEY);
+      fprintf(out, ", \"index\": %u}", p.id.index);
+    }
+    fprintf(out, ", \"body\": ");
+    printHex(out, p.typeSelector == LIKE_SELECTOR ? NULL : p.body.immutable, p.bodyLength);
+    fprintf(out, ", \"compressed\": %s, \"text\": ", p.compressed ? "true" : "false");
+    if(p.compressed) {
+      uint8_t text[UINT16_MAX];
+      printHex(out, text, decompressBody(p.body.immutable, p.bodyLength, text));
+    }
+    else {
+      printHex(out, p.typeSelector == LIKE_SELECTOR ? NULL : p.body.immutable, p.bodyLength);
+    }
+    fprintf(out, "}");
+  }
+  fprintf(out, "]}");
+}
+
+static int writeFixtures(const char* prefix) {
+  static Fixture fixtures[10];
+  uint64_t count = SOL_ARRAY_SIZE(fixtures);
+  for(uint64_t i = 0; i < count; i++) {
+    fixtures[i].key.x[0] = i + 2;
+  }
+  buildLegacy(&fixtures[2]);
+  buildIndexedV1(&fixtures[3]);
+  if(!buildCounters(&fixtures[0], &fixtures[1]) || !buildMigrated(&fixtures[4]) ||
+     !buildCompacted(&fixtures[5]) || !buildPages(&fixtures[6], &fixtures[7]) ||
+     !buildCompressed(&fixtures[8]) || !buildStamped(&fixtures[9])) {
+    fprintf(stderr, "Failed to build fixtures\n");
+    return 1;
+  }
+
+  char path[4096];
+  snprintf(path, sizeof(path), "%s.bin", prefix);
+  FILE* dump = fopen(path, "wb");
+  if(dump == NULL) {
+    perror(path);
+    return 1;
+  }
+  snprintf(path, sizeof(path), "%s.json", prefix);
+  FILE* expected = fopen(path, "w");
+  if(expected == NULL) {
+    perror(path);
+    fclose(dump);
+    return 1;
+  }
+  fprintf(expected, "[");
+  for(uint64_t i = 0; i < count; i++) {
+    uint64_t length = sizeof(fixtures[i].data);
+    fwrite(&fixtures[i].key, sizeof(SolPubkey), 1, dump);
+    fwrite(&length, sizeof(uint64_t), 1, dump);
+    fwrite(fixtures[i].data, length, 1, dump);
+    fprintf(expected, i == 0 ? "\n  " : ",\n  ");
+    printRecords(expected, &fixtures[i]);
+  }
+  fprintf(expected, "\n]\n");
+  fclose(dump);
+  fclose(expected);
+  printf("Wrote %lu fixture accounts to %s.bin\n", count, prefix);
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  if(argc == 3 && strcmp(argv[1], "layout") == 0) {
+    return writeLayout(argv[2]);
+  }
+  if(argc == 3 && strcmp(argv[1], "fixtures") == 0) {
+    return writeFixtures(argv[2]);
+  }
+  fprintf(stderr, "Usage: %s layout OUT.ts | fixtures PREFIX\n", argv[0]);
+  return 1;
+}
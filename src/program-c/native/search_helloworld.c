@@ -0,0 +1,747 @@
+/**
+ * @brief Local full-text index over the post bodies of account dumps
+ *
+ * Keeps an inverted index from words to the posts whose bodies contain
+ * them, and updates it from dumps of changed accounts instead of
+ * reindexing the forum. Bodies are read in place with parseRecord() from
+ * helloworld.c, so only posts and replies the program would accept are
+ * indexed, compressed bodies are decoded first, and redacted posts drop
+ * out of the results.
+ *
+ * Every indexed post gets a document number in the order it was indexed.
+ * A word's posting list holds the document numbers of its posts as
+ * varint-coded gaps, with a skip entry every POSTING_BLOCK postings so
+ * queries seek through long lists rather than decoding them. Documents
+ * map back to PostIDs, and redacted or compacted posts are only marked
+ * deleted, so applying a changed account costs its records and the
+ * postings of its new posts.
+ *
+ * Usage:
+ *   search_helloworld INDEX apply DUMP          index the accounts of a dump,
+ *                                               replacing what INDEX held for
+ *                                               them, creating INDEX if needed
+ *   search_helloworld INDEX query WORD...       print the newest posts that
+ *                                               contain every word
+ *   search_helloworld INDEX serve               run apply DUMP and query
+ *                                               WORD... commands read from
+ *                                               stdin, then save INDEX
+ * Dumps are in the format described in dumps.h, and a dump of only the
+ * accounts that changed since the last apply is enough.
+ */
+#include "../src/helloworld/helloworld.c"
+#include "syscall_stubs.h"
+#include "dumps.h"
+
+#include <errno.h>
+
+// Words are cut to this many bytes
+#define MAX_TERM_LENGTH 32
+// Postings between skip entries
+#define POSTING_BLOCK 128
+// Matches printed per query
+#define QUERY_RESULTS 20
+// Distinct words per query
+#define MAX_QUERY_TERMS 16
+// Identifies index files, followed by the format version
+#define INDEX_MAGIC 0x49534857 // "WHSI"
+#define INDEX_VERSION 1
+
+// Index
+// ----------------------------------------------------------------------------
+// A user account or page whose posts are indexed
+typedef struct {
+  SolPubkey key;
+  SolPubkey owner;
+  uint32_t* docs; // documents of its posts, in PostID order
+  uint32_t numDocs;
+  uint32_t capacity;
+} Segment;
+
+// Where a document's post lives
+typedef struct {
+  uint32_t segment;
+  uint32_t index; // PostID index
+} Document;
+
+// Position in a posting list just before the postings of a block
+typedef struct {
+  uint32_t lastDoc; // last document of the previous block
+  uint32_t offset;  // byte offset of the block
+} Skip;
+
+typedef struct {
+  uint8_t length;
+  uint8_t term[MAX_TERM_LENGTH];
+  uint32_t count;
+  uint32_t lastDoc;
+  uint8_t* bytes; // varint gaps between documents, the first from -1
+  uint32_t numBytes;
+  uint32_t byteCapacity;
+  Skip* skips; // skips[k] starts block k + 1
+  uint32_t skipCapacity;
+} PostingList;
+
+typedef struct {
+  Segment* segments;
+  uint64_t numSegments;
+  uint64_t segmentCapacity;
+  uint32_t* segmentTable; // segment + 1, or 0 if empty
+  uint64_t segmentMask;
+  Document* docs;
+  uint64_t numDocs;
+  uint64_t docCapacity;
+  uint64_t* deleted; // one bit per document
+  uint64_t deletedCapacity;
+  PostingList* lists;
+  uint64_t numLists;
+  uint64_t listCapacity;
+  uint32_t* listTable; // list + 1, or 0 if empty
+  uint64_t listMask;
+} Index;
+
+// Grows an array to hold at least count elements of size bytes, doubling
+// its capacity. Exits if memory runs out, as the index cannot be kept
+// consistent past that point.
+static void* reserve(void* array, uint64_t* capacity, uint64_t count, uint64_t size) {
+  if(count <= *capacity) {
+    return array;
+  }
+  uint64_t grown = *capacity < 16 ? 16 : *capacity;
+  while(grown < count) {
+    grown *= 2;
+  }
+  array = realloc(array, grown * size);
+  if(array == NULL) {
+    fprintf(stderr, "Not enough memory for the index\n");
+    exit(1);
+  }
+  *capacity = grown;
+  return array;
+}
+
+static uint64_t hashBytes(const uint8_t* bytes, uint64_t length) {
+  // FNV-1a
+  uint64_t h = 0xCBF29CE484222325ULL;
+  for(uint64_t i = 0; i < length; i++) {
+    h = (h ^ bytes[i]) * 0x100000001B3ULL;
+  }
+  return h;
+}
+
+// Builds an empty open-addressed table for twice as many entries as count
+static uint32_t* newTable(uint64_t count, uint64_t* mask) {
+  uint64_t size = 64;
+  while(size < 2 * count) {
+    size <<= 1;
+  }
+  *mask = size - 1;
+  uint32_t* table = calloc(size, sizeof(uint32_t));
+  if(table == NULL) {
+    fprintf(stderr, "Not enough memory for the index\n");
+    exit(1);
+  }
+  return table;
+}
+
+static void initIndex(Index* index) {
+  sol_memset(index, 0, sizeof(Index));
+  index->segmentTable = newTable(0, &index->segmentMask);
+  index->listTable = newTable(0, &index->listMask);
+}
+
+static uint64_t segmentSlot(Index* index, const SolPubkey* key) {
+  // Keys are ed25519 points, so any 8 of their bytes are well mixed
+  uint64_t slot = *((uint64_t*)key->x) & index->segmentMask;
+  while(index->segmentTable[slot] != 0 &&
+        !SolPubkey_same(&index->segments[index->segmentTable[slot] - 1].key, key)) {
+    slot = (slot + 1) & index->segmentMask;
+  }
+  return slot;
+}
+
+static void rebuildSegmentTable(Index* index) {
+  free(index->segmentTable);
+  index->segmentTable = newTable(index->numSegments, &index->segmentMask);
+  for(uint64_t s = 0; s < index->numSegments; s++) {
+    index->segmentTable[segmentSlot(index, &index->segments[s].key)] = s + 1;
+  }
+}
+
+// Returns the segment of an account, adding it if it is new
+static Segment* findSegment(Index* index, const SolPubkey* key, const SolPubkey* owner) {
+  uint64_t slot = segmentSlot(index, key);
+  if(index->segmentTable[slot] != 0) {
+    return &index->segments[index->segmentTable[slot] - 1];
+  }
+  index->segments = reserve(index->segments, &index->segmentCapacity, index->numSegments + 1, sizeof(Segment));
+  Segment* segment = &index->segments[index->numSegments++];
+  sol_memset(segment, 0, sizeof(Segment));
+  segment->key = *key;
+  segment->owner = *owner;
+  if(2 * index->numSegments > index->segmentMask) {
+    rebuildSegmentTable(index);
+  }
+  else {
+    index->segmentTable[slot] = index->numSegments;
+  }
+  return segment;
+}
+
+static uint64_t listSlot(Index* index, const uint8_t* term, uint64_t length) {
+  uint64_t slot = hashBytes(term, length) & index->listMask;
+  while(index->listTable[slot] != 0) {
+    PostingList* list = &index->lists[index->listTable[slot] - 1];
+    if(list->length == length && sol_memcmp(list->term, term, length) == 0) {
+      break;
+    }
+    slot = (slot + 1) & index->listMask;
+  }
+  return slot;
+}
+
+static void rebuildListTable(Index* index) {
+  free(index->listTable);
+  index->listTable = newTable(index->numLists, &index->listMask);
+  for(uint64_t l = 0; l < index->numLists; l++) {
+    PostingList* list = &index->lists[l];
+    index->listTable[listSlot(index, list->term, list->length)] = l + 1;
+  }
+}
+
+// Returns the posting list of a term, or NULL if no post contains it
+static PostingList* findList(Index* index, const uint8_t* term, uint64_t length) {
+  uint32_t entry = index->listTable[listSlot(index, term, length)];
+  return entry == 0 ? NULL : &index->lists[entry - 1];
+}
+
+static PostingList* addList(Index* index, const uint8_t* term, uint64_t length) {
+  uint64_t slot = listSlot(index, term, length);
+  if(index->listTable[slot] != 0) {
+    return &index->lists[index->listTable[slot] - 1];
+  }
+  index->lists = reserve(index->lists, &index->listCapacity, index->numLists + 1, sizeof(PostingList));
+  PostingList* list = &index->lists[index->numLists++];
+  sol_memset(list, 0, sizeof(PostingList));
+  list->length = length;
+  sol_memcpy(list->term, term, length);
+  if(2 * index->numLists > index->listMask) {
+    rebuildListTable(index);
+  }
+  else {
+    index->listTable[slot] = index->numLists;
+  }
+  return list;
+}
+
+static void appendPosting(PostingList* list, uint32_t doc) {
+  // Documents are appended in order, so a repeated word repeats the last one
+  if(list->count > 0 && list->lastDoc == doc) {
+    return;
+  }
+  if(list->count > 0 && list->count % POSTING_BLOCK == 0) {
+    uint64_t capacity = list->skipCapacity;
+    list->skips = reserve(list->skips, &capacity, list->count / POSTING_BLOCK, sizeof(Skip));
+    list->skipCapacity = capacity;
+    Skip skip = { .lastDoc = list->lastDoc, .offset = list->numBytes };
+    list->skips[list->count / POSTING_BLOCK - 1] = skip;
+  }
+  uint32_t gap = list->count == 0 ? doc : doc - list->lastDoc - 1;
+  uint64_t capacity = list->byteCapacity;
+  list->bytes = reserve(list->bytes, &capacity, list->numBytes + 5, 1);
+  list->byteCapacity = capacity;
+  while(gap >= 0x80) {
+    list->bytes[list->numBytes++] = (gap & 0x7F) | 0x80;
+    gap >>= 7;
+  }
+  list->bytes[list->numBytes++] = gap;
+  list->count++;
+  list->lastDoc = doc;
+}
+
+static bool isDeleted(const Index* index, uint32_t doc) {
+  return (index->deleted[doc / 64] >> (doc % 64)) & 1;
+}
+
+static void deleteDoc(Index* index, uint32_t doc) {
+  index->deleted[doc / 64] |= 1ULL << (doc % 64);
+}
+
+// Tokenizing
+// ----------------------------------------------------------------------------
+// ASCII letters and digits, and every byte of multi-byte UTF-8 sequences
+// so words in other scripts stay whole
+static bool isWordByte(uint8_t c) {
+  return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c >= 0x80;
+}
+
+typedef void (*WordVisitor)(void* ctx, const uint8_t* word, uint64_t length);
+
+// Calls visit(ctx, word, length) for every word of text, lowercased and cut
+// to MAX_TERM_LENGTH bytes
+static void visitWords(const uint8_t* text, uint64_t length, WordVisitor visit, void* ctx) {
+  uint8_t word[MAX_TERM_LENGTH];
+  uint64_t i = 0;
+  while(i < length) {
+    while(i < length && !isWordByte(text[i])) {
+      i++;
+    }
+    uint64_t wordLength = 0;
+    while(i < length && isWordByte(text[i])) {
+      uint8_t c = text[i++];
+      if(wordLength < MAX_TERM_LENGTH) {
+        word[wordLength++] = (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+      }
+    }
+    if(wordLength > 0) {
+      visit(ctx, word, wordLength);
+    }
+  }
+}
+
+// Returns the text of a record that is indexed, decoding compressed bodies
+// into buffer, or NULL for likes, reports, redacted and invalid records
+static const uint8_t* recordText(const uint8_t* record, uint64_t idSize, uint8_t* buffer,
+                                 uint64_t* length) {
+  Post post;
+  if(parseRecord(&record[sizeof(uint16_t)], *((uint16_t*)record), idSize, &post) == 0 ||
+     (record[sizeof(uint16_t)] & REDACTED_FLAG) ||
+     (post.typeSelector != POST_SELECTOR && post.typeSelector != REPLY_SELECTOR)) {
+    return NULL;
+  }
+  if(!post.compressed) {
+    *length = post.bodyLength;
+    return post.body.immutable;
+  }
+  *length = decompressBody(post.body.immutable, post.bodyLength, buffer);
+  return *length > 0 ? buffer : NULL;
+}
+
+// Applying account changes
+// ----------------------------------------------------------------------------
+typedef struct {
+  Index* index;
+  Segment* segment;
+  uint32_t next; // first document of the segment not yet matched to a record
+  uint32_t doc;  // document being indexed
+  uint64_t added;
+  uint64_t removed;
+} ApplyContext;
+
+static void addWord(void* ctx, const uint8_t* word, uint64_t length) {
+  ApplyContext* apply = ctx;
+  appendPosting(addList(apply->index, word, length), apply->doc);
+}
+
+static void removeDoc(ApplyContext* apply, uint32_t doc) {
+  if(!isDeleted(apply->index, doc)) {
+    deleteDoc(apply->index, doc);
+    apply->removed++;
+  }
+}
+
+// Matches a live record against the documents the segment already has.
+// Records are only appended, redacted or dropped, so documents of records
+// that were skipped have been dropped and records past the last document
+// are new.
+static void applyRecord(void* ctx, const SolPubkey* owner, uint64_t postIndex,
+                        const uint8_t* record, uint64_t idSize) {
+  ApplyContext* apply = ctx;
+  Index* index = apply->index;
+  Segment* segment = apply->segment;
+  while(apply->next < segment->numDocs && index->docs[segment->docs[apply->next]].index < postIndex) {
+    removeDoc(apply, segment->docs[apply->next++]);
+  }
+  static uint8_t buffer[UINT16_MAX];
+  uint64_t length = 0;
+  const uint8_t* text = recordText(record, idSize, buffer, &length);
+  if(apply->next < segment->numDocs && index->docs[segment->docs[apply->next]].index == postIndex) {
+    if(text == NULL) {
+      removeDoc(apply, segment->docs[apply->next]);
+    }
+    apply->next++;
+    return;
+  }
+  if(text == NULL || postIndex > UINT32_MAX ||
+     (segment->numDocs > 0 && postIndex < index->docs[segment->docs[segment->numDocs - 1]].index)) {
+    return;
+  }
+
+  index->docs = reserve(index->docs, &index->docCapacity, index->numDocs + 1, sizeof(Document));
+  if(index->numDocs % 64 == 0) {
+    uint64_t words = index->numDocs / 64 + 1;
+    index->deleted = reserve(index->deleted, &index->deletedCapacity, words, sizeof(uint64_t));
+    index->deleted[words - 1] = 0;
+  }
+  apply->doc = index->numDocs++;
+  index->docs[apply->doc].segment = segment - index->segments;
+  index->docs[apply->doc].index = postIndex;
+  uint64_t capacity = segment->capacity;
+  segment->docs = reserve(segment->docs, &capacity, segment->numDocs + 1, sizeof(uint32_t));
+  segment->capacity = capacity;
+  segment->docs[segment->numDocs++] = apply->doc;
+  // Keep the new document past the matching cursor
+  apply->next = segment->numDocs;
+  visitWords(text, length, addWord, apply);
+  apply->added++;
+}
+
+// Indexes the current records of every post account of a dump
+static void applyDump(Index* index, Dump* dump, uint64_t* added, uint64_t* removed) {
+  uint64_t offset = 0;
+  DumpAccount account;
+  while(nextAccount(dump, &offset, &account)) {
+    const SolPubkey* owner = postOwner(&account);
+    if(owner == NULL) {
+      continue;
+    }
+    ApplyContext apply = { .index = index, .segment = findSegment(index, account.key, owner) };
+    visitRecords(&account, applyRecord, &apply);
+    while(apply.next < apply.segment->numDocs) {
+      removeDoc(&apply, apply.segment->docs[apply.next++]);
+    }
+    *added += apply.added;
+    *removed += apply.removed;
+  }
+}
+
+// Queries
+// ----------------------------------------------------------------------------
+typedef struct {
+  const PostingList* list;
+  uint32_t position; // postings decoded
+  uint32_t offset;
+  int64_t doc;       // last decoded document, -1 before the first
+} PostingCursor;
+
+// Decodes the next posting. Returns false at the end of the list.
+static bool nextPosting(PostingCursor* cursor) {
+  if(cursor->position == cursor->list->count) {
+    return false;
+  }
+  const uint8_t* bytes = cursor->list->bytes;
+  uint8_t b = bytes[cursor->offset++];
+  uint32_t gap = b & 0x7F;
+  for(uint32_t shift = 7; b >= 0x80; shift += 7) {
+    b = bytes[cursor->offset++];
+    gap |= (uint32_t)(b & 0x7F) << shift;
+  }
+  cursor->doc += gap + 1;
+  cursor->position++;
+  return true;
+}
+
+// Moves to the first posting at or past target. Returns false if there is
+// none.
+static bool seekPosting(PostingCursor* cursor, int64_t target) {
+  if(cursor->doc >= target) {
+    return true;
+  }
+  // Skip whole blocks whose last document is still below the target, once
+  // the target is past the current block
+  const PostingList* list = cursor->list;
+  uint32_t numSkips = list->count > 0 ? (list->count - 1) / POSTING_BLOCK : 0;
+  uint32_t low = cursor->position / POSTING_BLOCK;
+  uint32_t high = low < numSkips && list->skips[low].lastDoc < target ? numSkips : low;
+  while(low < high) {
+    uint32_t mid = (low + high + 1) / 2;
+    if(list->skips[mid - 1].lastDoc < target) {
+      low = mid;
+    }
+    else {
+      high = mid - 1;
+    }
+  }
+  if(low > 0 && low * POSTING_BLOCK > cursor->position) {
+    cursor->position = low * POSTING_BLOCK;
+    cursor->offset = list->skips[low - 1].offset;
+    cursor->doc = list->skips[low - 1].lastDoc;
+  }
+  while(cursor->doc < target) {
+    if(!nextPosting(cursor)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+typedef struct {
+  Index* index;
+  PostingList* lists[MAX_QUERY_TERMS];
+  uint64_t numLists;
+  bool missing; // a word no post contains
+} Query;
+
+static void addQueryWord(void* ctx, const uint8_t* word, uint64_t length) {
+  Query* query = ctx;
+  PostingList* list = findList(query->index, word, length);
+  if(list == NULL) {
+    query->missing = true;
+    return;
+  }
+  for(uint64_t i = 0; i < query->numLists; i++) {
+    if(query->lists[i] == list) {
+      return;
+    }
+  }
+  if(query->numLists < MAX_QUERY_TERMS) {
+    query->lists[query->numLists++] = list;
+  }
+}
+
+static int compareListCounts(const void* a, const void* b) {
+  uint32_t x = (*(PostingList* const*)a)->count;
+  uint32_t y = (*(PostingList* const*)b)->count;
+  return x < y ? -1 : x > y;
+}
+
+// Prints the newest QUERY_RESULTS posts containing every word of text and
+// the number of posts that do. The posting lists are intersected from the
+// shortest one, each seeking to the largest document seen so far.
+static void runQuery(Index* index, const char* text) {
+  Query query = { .index = index };
+  visitWords((const uint8_t*)text, strlen(text), addQueryWord, &query);
+  uint64_t matches = 0;
+  uint32_t newest[QUERY_RESULTS];
+  if(!query.missing && query.numLists > 0) {
+    qsort(query.lists, query.numLists, sizeof(PostingList*), compareListCounts);
+    PostingCursor cursors[MAX_QUERY_TERMS];
+    for(uint64_t i = 0; i < query.numLists; i++) {
+      PostingCursor cursor = { .list = query.lists[i], .position = 0, .offset = 0, .doc = -1 };
+      cursors[i] = cursor;
+    }
+    int64_t target = 0;
+    while(seekPosting(&cursors[0], target)) {
+      target = cursors[0].doc;
+      bool exhausted = false;
+      uint64_t i = 1;
+      for(; i < query.numLists; i++) {
+        if(!seekPosting(&cursors[i], target)) {
+          exhausted = true;
+          break;
+        }
+        if(cursors[i].doc != target) {
+          break;
+        }
+      }
+      if(exhausted) {
+        break;
+      }
+      if(i < query.numLists) {
+        target = cursors[i].doc;
+        continue;
+      }
+      if(!isDeleted(index, target)) {
+        newest[matches++ % QUERY_RESULTS] = target;
+      }
+      target++;
+    }
+  }
+
+  uint64_t shown = matches < QUERY_RESULTS ? matches : QUERY_RESULTS;
+  for(uint64_t i = 0; i < shown; i++) {
+    Document* doc = &index->docs[newest[(matches - 1 - i) % QUERY_RESULTS]];
+    char key[45];
+    encodeKey(&index->segments[doc->segment].owner, key);
+    printf("%s:%u\n", key, doc->index);
+  }
+  printf("%lu posts match\n", matches);
+}
+
+// Index files
+// ----------------------------------------------------------------------------
+// Segments with their documents, the documents and deleted bits, then the
+// posting lists with their terms and skips, all in host byte order. Hash
+// tables are rebuilt on load.
+
+static void writeAll(FILE* out, const void* data, uint64_t length) {
+  fwrite(data, 1, length, out);
+}
+
+static bool readAll(FILE* in, void* data, uint64_t length) {
+  return fread(data, 1, length, in) == length;
+}
+
+static uint64_t skipCount(const PostingList* list) {
+  return list->count > 0 ? (list->count - 1) / POSTING_BLOCK : 0;
+}
+
+// Writes the index next to path, then moves it over path so a failed save
+// keeps the previous index
+static bool saveIndex(Index* index, const char* path) {
+  char temp[4096];
+  snprintf(temp, sizeof(temp), "%s.tmp", path);
+  FILE* out = fopen(temp, "wb");
+  if(out == NULL) {
+    perror(temp);
+    return false;
+  }
+  uint32_t header[] = { INDEX_MAGIC, INDEX_VERSION };
+  writeAll(out, header, sizeof(header));
+  writeAll(out, &index->numSegments, sizeof(uint64_t));
+  for(uint64_t s = 0; s < index->numSegments; s++) {
+    Segment* segment = &index->segments[s];
+    writeAll(out, &segment->key, sizeof(SolPubkey));
+    writeAll(out, &segment->owner, sizeof(SolPubkey));
+    writeAll(out, &segment->numDocs, sizeof(uint32_t));
+    writeAll(out, segment->docs, segment->numDocs * sizeof(uint32_t));
+  }
+  writeAll(out, &index->numDocs, sizeof(uint64_t));
+  writeAll(out, index->docs, index->numDocs * sizeof(Document));
+  writeAll(out, index->deleted, (index->numDocs + 63) / 64 * sizeof(uint64_t));
+  writeAll(out, &index->numLists, sizeof(uint64_t));
+  for(uint64_t l = 0; l < index->numLists; l++) {
+    PostingList* list = &index->lists[l];
+    writeAll(out, &list->length, sizeof(uint8_t));
+    writeAll(out, list->term, list->length);
+    writeAll(out, &list->count, sizeof(uint32_t));
+    writeAll(out, &list->lastDoc, sizeof(uint32_t));
+    writeAll(out, &list->numBytes, sizeof(uint32_t));
+    writeAll(out, list->bytes, list->numBytes);
+    writeAll(out, list->skips, skipCount(list) * sizeof(Skip));
+  }
+  bool written = !ferror(out);
+  if(fclose(out) != 0 || !written || rename(temp, path) != 0) {
+    perror(path);
+    return false;
+  }
+  return true;
+}
+
+// Loads an index file into an empty index. A missing file leaves the
+// index empty and returns true.
+static bool loadIndex(Index* index, const char* path) {
+  FILE* in = fopen(path, "rb");
+  if(in == NULL) {
+    if(errno == ENOENT) {
+      return true;
+    }
+    perror(path);
+    return false;
+  }
+  uint32_t header[2];
+  bool ok = readAll(in, header, sizeof(header)) && header[0] == INDEX_MAGIC && header[1] == INDEX_VERSION &&
+            readAll(in, &index->numSegments, sizeof(uint64_t));
+  if(ok) {
+    index->segments = reserve(NULL, &index->segmentCapacity, index->numSegments, sizeof(Segment));
+  }
+  for(uint64_t s = 0; ok && s < index->numSegments; s++) {
+    Segment* segment = &index->segments[s];
+    ok = readAll(in, &segment->key, sizeof(SolPubkey)) && readAll(in, &segment->owner, sizeof(SolPubkey)) &&
+         readAll(in, &segment->numDocs, sizeof(uint32_t));
+    uint64_t capacity = 0;
+    segment->docs = ok ? reserve(NULL, &capacity, segment->numDocs, sizeof(uint32_t)) : NULL;
+    segment->capacity = capacity;
+    ok = ok && readAll(in, segment->docs, segment->numDocs * sizeof(uint32_t));
+  }
+  ok = ok && readAll(in, &index->numDocs, sizeof(uint64_t));
+  if(ok) {
+    uint64_t words = (index->numDocs + 63) / 64;
+    index->docs = reserve(NULL, &index->docCapacity, index->numDocs, sizeof(Document));
+    index->deleted = reserve(NULL, &index->deletedCapacity, words + 1, sizeof(uint64_t));
+    ok = readAll(in, index->docs, index->numDocs * sizeof(Document)) &&
+         readAll(in, index->deleted, words * sizeof(uint64_t)) &&
+         readAll(in, &index->numLists, sizeof(uint64_t));
+  }
+  if(ok) {
+    index->lists = reserve(NULL, &index->listCapacity, index->numLists, sizeof(PostingList));
+  }
+  for(uint64_t l = 0; ok && l < index->numLists; l++) {
+    PostingList* list = &index->lists[l];
+    sol_memset(list, 0, sizeof(PostingList));
+    ok = readAll(in, &list->length, sizeof(uint8_t)) && list->length <= MAX_TERM_LENGTH &&
+         readAll(in, list->term, list->length) && readAll(in, &list->count, sizeof(uint32_t)) &&
+         readAll(in, &list->lastDoc, sizeof(uint32_t)) && readAll(in, &list->numBytes, sizeof(uint32_t));
+    if(!ok) {
+      break;
+    }
+    uint64_t capacity = 0;
+    list->bytes = reserve(NULL, &capacity, list->numBytes + 5, 1);
+    list->byteCapacity = capacity;
+    capacity = 0;
+    list->skips = reserve(NULL, &capacity, skipCount(list) + 1, sizeof(Skip));
+    list->skipCapacity = capacity;
+    ok = readAll(in, list->bytes, list->numBytes) && readAll(in, list->skips, skipCount(list) * sizeof(Skip));
+  }
+  fclose(in);
+  if(!ok) {
+    fprintf(stderr, "%s: not a valid index file\n", path);
+    return false;
+  }
+  rebuildSegmentTable(index);
+  rebuildListTable(index);
+  return true;
+}
+
+// Commands
+// ----------------------------------------------------------------------------
+static bool applyPath(Index* index, const char* path) {
+  Dump dump;
+  if(!mapDump(path, &dump)) {
+    return false;
+  }
+  uint64_t start = nowNanos();
+  uint64_t added = 0, removed = 0;
+  applyDump(index, &dump, &added, &removed);
+  munmap((void*)dump.data, dump.length);
+  printf("Indexed %lu new posts and removed %lu in %.1f ms, %lu posts and %lu words in total\n",
+         added, removed, millisSince(start), index->numDocs, index->numLists);
+  return true;
+}
+
+static void timedQuery(Index* index, const char* text) {
+  uint64_t start = nowNanos();
+  runQuery(index, text);
+  printf("Query took %.3f ms\n", millisSince(start));
+}
+
+// Reads "apply DUMP" and "query WORD..." lines until the end of stdin
+static void serve(Index* index) {
+  char line[4096];
+  while(fgets(line, sizeof(line), stdin) != NULL) {
+    line[strcspn(line, "\n")] = '\0';
+    if(strncmp(line, "apply ", 6) == 0) {
+      applyPath(index, &line[6]);
+    }
+    else if(strncmp(line, "query ", 6) == 0) {
+      timedQuery(index, &line[6]);
+    }
+    else if(line[0] != '\0') {
+      fprintf(stderr, "Unknown command: %s\n", line);
+    }
+    fflush(stdout);
+  }
+}
+
+int main(int argc, char** argv) {
+  if(argc < 3 || (strcmp(argv[2], "apply") == 0 && argc != 4) ||
+     (strcmp(argv[2], "query") == 0 && argc < 4)) {
+    fprintf(stderr, "Usage: %s INDEX [apply DUMP | query WORD... | serve]\n", argv[0]);
+    return 1;
+  }
+  Index index;
+  initIndex(&index);
+  uint64_t start = nowNanos();
+  if(!loadIndex(&index, argv[1])) {
+    return 1;
+  }
+  printf("Loaded %lu posts and %lu words in %.1f ms\n", index.numDocs, index.numLists, millisSince(start));
+
+  if(strcmp(argv[2], "apply") == 0) {
+    return applyPath(&index, argv[3]) && saveIndex(&index, argv[1]) ? 0 : 1;
+  }
+  if(strcmp(argv[2], "query") == 0) {
+    char text[4096] = "";
+    for(int i = 3; i < argc; i++) {
+      strncat(text, argv[i], sizeof(text) - strlen(text) - 2);
+      strcat(text, " ");
+    }
+    timedQuery(&index, text);
+    return 0;
+  }
+  if(strcmp(argv[2], "serve") == 0) {
+    serve(&index);
+    return saveIndex(&index, argv[1]) ? 0 : 1;
+  }
+  fprintf(stderr, "Unknown command: %s\n", argv[2]);
+  return 1;
+}
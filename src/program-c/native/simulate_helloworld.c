@@ -0,0 +1,1108 @@
+/**
+ * @brief Deterministic parallel replay of workload traces
+ *
+ * Replays a trace of instructions through the forum program natively, on
+ * worker threads, ending in the same state as a replay one instruction at
+ * a time. Each window of the trace is turned into a graph in which an
+ * instruction waits for the earlier instructions that write an account
+ * it uses, or use an account it writes, as the runtime's account locks
+ * would have it. Instructions that touch disjoint accounts run in
+ * parallel and conflicting ones stay in trace order. Failed instructions
+ * are rolled back, as the runtime would.
+ *
+ * Reports throughput, latency and failures per selector, and a checksum
+ * of the final accounts that is the same for any number of threads.
+ *
+ * Trace format, one JSON object per line:
+ *
+ *   {"account": "alice", "size": 4096}
+ *       declares a program-owned account of size zeroed bytes. "key" may
+ *       give its base58 address, otherwise one is derived from its name.
+ *   {"slot": 7, "text": "Phello", "accounts": ["sw:alice", "clock"]}
+ *   {"slot": 7, "data": "52{alice}00000000", "accounts": ["sw:alice", "w:bob"]}
+ *       an instruction, with its data as text or as hex in which {name}
+ *       stands for the 32-byte address of an account. Accounts are named,
+ *       prefixed with s if they sign and w if they are writable. "clock"
+ *       is the Clock sysvar at the instruction's slot.
+ *
+ * Usage:
+ *   simulate_helloworld TRACE [THREADS [DUMP]]  replay TRACE, optionally
+ *                                               writing the final accounts
+ *                                               to DUMP
+ *   simulate_helloworld TRACE generate USERS INSTRUCTIONS
+ *                                               write a synthetic trace of
+ *                                               posts, replies, likes and
+ *                                               reports
+ * THREADS defaults to the number of CPUs. DUMP is in the format described
+ * in dumps.h.
+ */
+#include "../src/helloworld/helloworld.c"
+#include "syscall_stubs.h"
+#include "dumps.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <signal.h>
+#include <stddef.h>
+
+// Instructions scheduled together. Each window is replayed before the
+// next is read, which bounds memory for traces of any length.
+#define WINDOW_INSTRUCTIONS (1 << 18)
+#define MAX_INSTRUCTION_ACCOUNTS 1024
+#define MAX_THREADS 256
+// Account index of the Clock sysvar in instructions
+#define CLOCK_ACCOUNT UINT32_MAX
+#define ACCOUNT_SIGNER 0x1
+#define ACCOUNT_WRITABLE 0x2
+// Latency histogram buckets: 4 per power of two of nanoseconds
+#define LATENCY_BUCKETS 256
+// Slot length, for reporting how much time a trace covers
+#define SLOT_MILLIS 400
+// Instructions per slot in generated traces
+#define GENERATED_PER_SLOT 8
+// Writable accounts at least this long are rolled back by saving the pages
+// an instruction writes to, caught by write-protecting the account, rather
+// than by copying all of it up front
+#define TRACKED_ACCOUNT_LENGTH (256 * 1024)
+
+static SolPubkey programId = {.x = { 1, }};
+static SolPubkey sysvarOwner = {.x = { 2, }};
+static uint64_t pageSize;
+
+// Accounts
+// ----------------------------------------------------------------------------
+typedef struct {
+  char* name;
+  SolPubkey key;
+  uint8_t* data;
+  uint64_t length;
+  uint64_t lamports;
+  // Scheduling state within the current window
+  int64_t lastWriter;
+  uint32_t* readers; // instructions reading it since lastWriter
+  uint64_t numReaders;
+  uint64_t readerCapacity;
+} Account;
+
+typedef struct {
+  Account* accounts;
+  uint64_t numAccounts;
+  uint64_t capacity;
+  uint32_t* table; // account + 1, or 0 if empty
+  uint64_t mask;
+} Accounts;
+
+// Grows an array to hold at least count elements of size bytes
+static void* reserve(void* array, uint64_t* capacity, uint64_t count, uint64_t size) {
+  if(count <= *capacity) {
+    return array;
+  }
+  uint64_t grown = *capacity < 16 ? 16 : *capacity;
+  while(grown < count) {
+    grown *= 2;
+  }
+  array = realloc(array, grown * size);
+  if(array == NULL) {
+    fprintf(stderr, "Out of memory\n");
+    exit(1);
+  }
+  *capacity = grown;
+  return array;
+}
+
+static uint64_t hashName(const char* name) {
+  // FNV-1a
+  uint64_t h = 0xCBF29CE484222325ULL;
+  for(const char* c = name; *c != '\0'; c++) {
+    h = (h ^ (uint8_t)*c) * 0x100000001B3ULL;
+  }
+  return h;
+}
+
+static uint64_t nameSlot(Accounts* accounts, const char* name) {
+  uint64_t slot = hashName(name) & accounts->mask;
+  while(accounts->table[slot] != 0 && strcmp(accounts->accounts[accounts->table[slot] - 1].name, name) != 0) {
+    slot = (slot + 1) & accounts->mask;
+  }
+  return slot;
+}
+
+// Returns the index of a declared account, or -1
+static int64_t findAccount(Accounts* accounts, const char* name) {
+  if(accounts->table == NULL) {
+    return -1;
+  }
+  uint32_t entry = accounts->table[nameSlot(accounts, name)];
+  return entry == 0 ? -1 : (int64_t)entry - 1;
+}
+
+static bool declareAccount(Accounts* accounts, const char* name, uint64_t length, const char* key) {
+  if(findAccount(accounts, name) >= 0 || strcmp(name, "clock") == 0) {
+    fprintf(stderr, "Account %s is declared twice\n", name);
+    return false;
+  }
+  if(2 * (accounts->numAccounts + 1) > accounts->mask) {
+    free(accounts->table);
+    uint64_t size = 64;
+    while(size < 4 * (accounts->numAccounts + 1)) {
+      size <<= 1;
+    }
+    accounts->mask = size - 1;
+    accounts->table = calloc(size, sizeof(uint32_t));
+    for(uint64_t a = 0; a < accounts->numAccounts; a++) {
+      accounts->table[nameSlot(accounts, accounts->accounts[a].name)] = a + 1;
+    }
+  }
+  accounts->accounts = reserve(accounts->accounts, &accounts->capacity, accounts->numAccounts + 1, sizeof(Account));
+  Account* account = &accounts->accounts[accounts->numAccounts];
+  sol_memset(account, 0, sizeof(Account));
+  account->name = strdup(name);
+  // Whole pages, so that write-protecting one account leaves the others be
+  uint64_t allocated = (length + pageSize) & ~(pageSize - 1);
+  account->data = aligned_alloc(pageSize, allocated);
+  if(account->data != NULL) {
+    memset(account->data, 0, allocated);
+  }
+  account->length = length;
+  account->lamports = 1;
+  account->lastWriter = -1;
+  if(account->name == NULL || account->data == NULL) {
+    fprintf(stderr, "Out of memory\n");
+    exit(1);
+  }
+  if(key != NULL) {
+    if(!decodeKey(key, &account->key)) {
+      fprintf(stderr, "Invalid key for %s: %s\n", name, key);
+      return false;
+    }
+  }
+  else {
+    // Spread the name's hash over the key with splitmix64
+    uint64_t state = hashName(name);
+    for(int i = 0; i < SIZE_PUBKEY; i += sizeof(uint64_t)) {
+      uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+      z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+      z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+      z ^= z >> 31;
+      sol_memcpy(&account->key.x[i], &z, sizeof(uint64_t));
+    }
+  }
+  accounts->table[nameSlot(accounts, name)] = ++accounts->numAccounts;
+  return true;
+}
+
+// Traces
+// ----------------------------------------------------------------------------
+// The fields of a trace line. Strings point into the line.
+typedef struct {
+  char* account;
+  char* key;
+  uint64_t size;
+  uint64_t slot;
+  char* text;
+  char* data;
+  char* names[MAX_INSTRUCTION_ACCOUNTS];
+  uint64_t numNames;
+} TraceLine;
+
+static char* skipSpace(char* p) {
+  while(*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') {
+    p++;
+  }
+  return p;
+}
+
+static int hexDigit(char c) {
+  if(c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  if(c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  if(c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+// Parses the JSON string at *p in place, leaving *p past it. Returns NULL
+// if it is malformed. \u escapes are only supported below 0x100.
+static char* parseString(char** p) {
+  if(**p != '"') {
+    return NULL;
+  }
+  char* start = ++*p;
+  char* out = start;
+  while(**p != '"') {
+    char c = *(*p)++;
+    if(c == '\0') {
+      return NULL;
+    }
+    if(c == '\\') {
+      c = *(*p)++;
+      switch(c) {
+      case 'n': c = '\n'; break;
+      case 't': c = '\t'; break;
+      case 'r': c = '\r'; break;
+      case 'b': c = '\b'; break;
+      case 'f': c = '\f'; break;
+      case 'u': {
+        int value = 0;
+        for(int i = 0; i < 4; i++) {
+          int digit = hexDigit(*(*p)++);
+          if(digit < 0) {
+            return NULL;
+          }
+          value = value * 16 + digit;
+        }
+        if(value > 0xFF) {
+          return NULL;
+        }
+        c = value;
+        break;
+      }
+      case '"': case '\\': case '/':
+        break;
+      default:
+        return NULL;
+      }
+    }
+    *out++ = c;
+  }
+  (*p)++;
+  *out = '\0';
+  return start;
+}
+
+// Parses a trace line into its fields. Returns false if it is malformed.
+static bool parseTraceLine(char* line, TraceLine* fields) {
+  sol_memset(fields, 0, offsetof(TraceLine, names));
+  fields->numNames = 0;
+  char* p = skipSpace(line);
+  if(*p++ != '{') {
+    return false;
+  }
+  p = skipSpace(p);
+  while(*p != '}') {
+    char* key = parseString(&p);
+    p = skipSpace(p);
+    if(key == NULL || *p++ != ':') {
+      return false;
+    }
+    p = skipSpace(p);
+    if(strcmp(key, "accounts") == 0) {
+      if(*p++ != '[') {
+        return false;
+      }
+      p = skipSpace(p);
+      while(*p != ']') {
+        char* name = parseString(&p);
+        if(name == NULL || fields->numNames == MAX_INSTRUCTION_ACCOUNTS) {
+          return false;
+        }
+        fields->names[fields->numNames++] = name;
+        p = skipSpace(p);
+        if(*p == ',') {
+          p = skipSpace(p + 1);
+        }
+      }
+      p++;
+    }
+    else if(*p == '"') {
+      char* value = parseString(&p);
+      if(value == NULL) {
+        return false;
+      }
+      if(strcmp(key, "account") == 0) {
+        fields->account = value;
+      }
+      else if(strcmp(key, "key") == 0) {
+        fields->key = value;
+      }
+      else if(strcmp(key, "text") == 0) {
+        fields->text = value;
+      }
+      else if(strcmp(key, "data") == 0) {
+        fields->data = value;
+      }
+    }
+    else {
+      char* end;
+      uint64_t value = strtoull(p, &end, 10);
+      if(end == p) {
+        return false;
+      }
+      p = end;
+      if(strcmp(key, "size") == 0) {
+        fields->size = value;
+      }
+      else if(strcmp(key, "slot") == 0) {
+        fields->slot = value;
+      }
+    }
+    p = skipSpace(p);
+    if(*p == ',') {
+      p = skipSpace(p + 1);
+    }
+    else if(*p != '}') {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Windows
+// ----------------------------------------------------------------------------
+typedef struct {
+  uint32_t account; // or CLOCK_ACCOUNT
+  uint8_t flags;
+} AccountRef;
+
+typedef struct {
+  uint32_t from;
+  uint32_t to;
+} Edge;
+
+typedef struct {
+  uint64_t slot;
+  uint64_t dataOffset;
+  uint32_t dataLength;
+  uint32_t numAccounts;
+  uint64_t accountsOffset;
+} Instruction;
+
+// A window of the trace and the graph of its conflicts
+typedef struct {
+  Instruction* instructions;
+  uint64_t numInstructions;
+  uint64_t instructionCapacity;
+  uint8_t* data;
+  uint64_t dataLength;
+  uint64_t dataCapacity;
+  AccountRef* refs;
+  uint64_t numRefs;
+  uint64_t refCapacity;
+  // Edges from an instruction to the later ones that wait for it
+  Edge* edges;
+  uint64_t numEdges;
+  uint64_t edgeCapacity;
+  uint64_t* firstSuccessor; // CSR offsets into successors
+  uint32_t* successors;
+  atomic_uint* waitingOn;
+  uint32_t* touched; // accounts with scheduling state to reset
+  uint64_t numTouched;
+  uint64_t touchedCapacity;
+} Window;
+
+static void resetWindow(Window* window) {
+  window->numInstructions = 0;
+  window->dataLength = 0;
+  window->numRefs = 0;
+  window->numEdges = 0;
+}
+
+// Decodes hex instruction data into the window, replacing {name} with
+// the account's address
+static bool appendHexData(Window* window, Accounts* accounts, char* hex) {
+  while(*hex != '\0') {
+    window->data = reserve(window->data, &window->dataCapacity, window->dataLength + SIZE_PUBKEY, 1);
+    if(*hex == '{') {
+      char* end = strchr(hex, '}');
+      if(end == NULL) {
+        fprintf(stderr, "Unterminated account name in data: %s\n", hex);
+        return false;
+      }
+      *end = '\0';
+      int64_t account = findAccount(accounts, hex + 1);
+      if(account < 0) {
+        fprintf(stderr, "Unknown account in data: %s\n", hex + 1);
+        return false;
+      }
+      sol_memcpy(&window->data[window->dataLength], accounts->accounts[account].key.x, SIZE_PUBKEY);
+      window->dataLength += SIZE_PUBKEY;
+      hex = end + 1;
+      continue;
+    }
+    int high = hexDigit(hex[0]);
+    int low = high < 0 ? -1 : hexDigit(hex[1]);
+    if(low < 0) {
+      fprintf(stderr, "Invalid hex data at: %s\n", hex);
+      return false;
+    }
+    window->data[window->dataLength++] = high * 16 + low;
+    hex += 2;
+  }
+  return true;
+}
+
+// Adds an instruction line to the window
+static bool addInstruction(Window* window, Accounts* accounts, TraceLine* line) {
+  window->instructions = reserve(window->instructions, &window->instructionCapacity,
+                                 window->numInstructions + 1, sizeof(Instruction));
+  Instruction* instruction = &window->instructions[window->numInstructions];
+  instruction->slot = line->slot;
+  instruction->dataOffset = window->dataLength;
+  if(line->text != NULL) {
+    uint64_t length = strlen(line->text);
+    window->data = reserve(window->data, &window->dataCapacity, window->dataLength + length, 1);
+    memcpy(&window->data[window->dataLength], line->text, length);
+    window->dataLength += length;
+  }
+  else if(!appendHexData(window, accounts, line->data)) {
+    return false;
+  }
+  instruction->dataLength = window->dataLength - instruction->dataOffset;
+  if(instruction->dataLength == 0) {
+    fprintf(stderr, "Instructions need data\n");
+    return false;
+  }
+
+  instruction->accountsOffset = window->numRefs;
+  instruction->numAccounts = line->numNames;
+  window->refs = reserve(window->refs, &window->refCapacity, window->numRefs + line->numNames, sizeof(AccountRef));
+  for(uint64_t i = 0; i < line->numNames; i++) {
+    char* name = line->names[i];
+    AccountRef ref = { .account = CLOCK_ACCOUNT, .flags = 0 };
+    char* colon = strchr(name, ':');
+    if(colon != NULL) {
+      for(char* flag = name; flag < colon; flag++) {
+        ref.flags |= *flag == 's' ? ACCOUNT_SIGNER : *flag == 'w' ? ACCOUNT_WRITABLE : 0;
+      }
+      name = colon + 1;
+    }
+    if(strcmp(name, "clock") != 0) {
+      int64_t account = findAccount(accounts, name);
+      if(account < 0) {
+        fprintf(stderr, "Unknown account: %s\n", name);
+        return false;
+      }
+      ref.account = account;
+    }
+    window->refs[window->numRefs++] = ref;
+  }
+  window->numInstructions++;
+  return true;
+}
+
+static void addEdge(Window* window, uint32_t from, uint32_t to) {
+  window->edges = reserve(window->edges, &window->edgeCapacity, window->numEdges + 1, sizeof(Edge));
+  Edge edge = { from, to };
+  window->edges[window->numEdges++] = edge;
+}
+
+// Builds the conflict graph of a window. Readers of an account wait for
+// its last writer, and writers wait for the last writer and every reader
+// since, so any order the graph allows gives the serial result.
+static void buildGraph(Window* window, Accounts* accounts) {
+  window->numTouched = 0;
+  for(uint64_t i = 0; i < window->numInstructions; i++) {
+    Instruction* instruction = &window->instructions[i];
+    for(uint64_t r = 0; r < instruction->numAccounts; r++) {
+      AccountRef* ref = &window->refs[instruction->accountsOffset + r];
+      if(ref->account == CLOCK_ACCOUNT) {
+        continue;
+      }
+      Account* account = &accounts->accounts[ref->account];
+      if(account->lastWriter < 0 && account->numReaders == 0) {
+        window->touched = reserve(window->touched, &window->touchedCapacity, window->numTouched + 1, sizeof(uint32_t));
+        window->touched[window->numTouched++] = ref->account;
+      }
+      if(account->lastWriter >= 0 && account->lastWriter != (int64_t)i) {
+        addEdge(window, account->lastWriter, i);
+      }
+      if(ref->flags & ACCOUNT_WRITABLE) {
+        for(uint64_t k = 0; k < account->numReaders; k++) {
+          if(account->readers[k] != i) {
+            addEdge(window, account->readers[k], i);
+          }
+        }
+        account->numReaders = 0;
+        account->lastWriter = i;
+      }
+      else if(account->lastWriter != (int64_t)i) {
+        account->readers = reserve(account->readers, &account->readerCapacity, account->numReaders + 1,
+                                   sizeof(uint32_t));
+        account->readers[account->numReaders++] = i;
+      }
+    }
+  }
+  for(uint64_t t = 0; t < window->numTouched; t++) {
+    Account* account = &accounts->accounts[window->touched[t]];
+    account->lastWriter = -1;
+    account->numReaders = 0;
+  }
+
+  // Lay the edges out by their first instruction
+  uint64_t n = window->numInstructions;
+  window->firstSuccessor = realloc(window->firstSuccessor, (n + 1) * sizeof(uint64_t));
+  window->successors = realloc(window->successors, (window->numEdges + 1) * sizeof(uint32_t));
+  window->waitingOn = realloc(window->waitingOn, (n + 1) * sizeof(atomic_uint));
+  if(window->firstSuccessor == NULL || window->successors == NULL || window->waitingOn == NULL) {
+    fprintf(stderr, "Out of memory\n");
+    exit(1);
+  }
+  memset(window->firstSuccessor, 0, (n + 1) * sizeof(uint64_t));
+  for(uint64_t i = 0; i < n; i++) {
+    atomic_init(&window->waitingOn[i], 0);
+  }
+  for(uint64_t e = 0; e < window->numEdges; e++) {
+    window->firstSuccessor[window->edges[e].from + 1]++;
+    atomic_fetch_add_explicit(&window->waitingOn[window->edges[e].to], 1, memory_order_relaxed);
+  }
+  for(uint64_t i = 0; i < n; i++) {
+    window->firstSuccessor[i + 1] += window->firstSuccessor[i];
+  }
+  // Filling advances each offset to the next one, so shift them back after
+  for(uint64_t e = 0; e < window->numEdges; e++) {
+    window->successors[window->firstSuccessor[window->edges[e].from]++] = window->edges[e].to;
+  }
+  for(uint64_t i = n; i > 0; i--) {
+    window->firstSuccessor[i] = window->firstSuccessor[i - 1];
+  }
+  window->firstSuccessor[0] = 0;
+}
+
+// Replay
+// ----------------------------------------------------------------------------
+// Latency, failures and log syscalls of one selector
+typedef struct {
+  uint64_t count;
+  uint64_t failed;
+  uint64_t totalNanos;
+  uint64_t maxNanos;
+  uint64_t logs;
+  uint64_t buckets[LATENCY_BUCKETS];
+} SelectorStats;
+
+// Histogram bucket of a latency, 4 per power of two so that percentiles
+// are within 25%
+static uint64_t latencyBucket(uint64_t nanos) {
+  if(nanos < 4) {
+    return nanos;
+  }
+  uint64_t exponent = 63 - __builtin_clzll(nanos);
+  return (exponent - 1) * 4 + ((nanos >> (exponent - 2)) & 3);
+}
+
+static uint64_t bucketNanos(uint64_t bucket) {
+  if(bucket < 4) {
+    return bucket;
+  }
+  return (4 + bucket % 4) << (bucket / 4 - 1);
+}
+
+// Pages of write-protected accounts saved before the running instruction
+// first wrote to them
+typedef struct {
+  uint8_t* start[MAX_INSTRUCTION_ACCOUNTS];
+  uint8_t* end[MAX_INSTRUCTION_ACCOUNTS];
+  uint64_t numRanges;
+  uint8_t* copies;
+  uint8_t** pages;
+  uint64_t numPages;
+  uint64_t capacity; // in pages
+} PageLog;
+
+static _Thread_local PageLog* pageLog;
+
+// SIGSEGV handler that saves and unprotects the page of a tracked account
+// being written to, letting the write go through on return
+static void savePage(int number, siginfo_t* info, void* context) {
+  PageLog* log = pageLog;
+  uint8_t* address = info->si_addr;
+  for(uint64_t r = 0; log != NULL && r < log->numRanges; r++) {
+    if(address >= log->start[r] && address < log->end[r]) {
+      uint8_t* page = log->start[r] + ((address - log->start[r]) & ~(pageSize - 1));
+      memcpy(&log->copies[log->numPages * pageSize], page, pageSize);
+      log->pages[log->numPages++] = page;
+      mprotect(page, pageSize, PROT_READ | PROT_WRITE);
+      return;
+    }
+  }
+  // Any other fault is a real one, so crash as usual
+  signal(SIGSEGV, SIG_DFL);
+}
+
+typedef struct Simulation Simulation;
+
+typedef struct {
+  Simulation* simulation;
+  pthread_t thread;
+  SelectorStats* stats; // indexed by the first byte of the instruction data
+  uint8_t* heap;
+  uint8_t* snapshot; // short writable accounts of the running instruction
+  uint64_t snapshotCapacity;
+  PageLog pages; // and the pages written of long ones
+  uint32_t* released;
+  uint64_t releasedCapacity;
+} Worker;
+
+struct Simulation {
+  Accounts accounts;
+  Window window;
+  Worker* workers;
+  uint64_t numWorkers;
+  // Instructions whose dependencies have all run, in the order released
+  pthread_mutex_t lock;
+  pthread_cond_t ready;
+  uint32_t* queue;
+  uint64_t head;
+  uint64_t tail;
+  uint64_t done;
+};
+
+// Runs an instruction against the accounts, restoring every writable
+// account if it fails
+static void execute(Worker* worker, uint32_t i) {
+  Simulation* simulation = worker->simulation;
+  Window* window = &simulation->window;
+  Instruction* instruction = &window->instructions[i];
+  AccountRef* refs = &window->refs[instruction->accountsOffset];
+  SolAccountInfo infos[MAX_INSTRUCTION_ACCOUNTS];
+  // The slot is the first field of the Clock, the rest are left zero
+  uint64_t clock[5] = { instruction->slot, };
+  uint64_t clockLamports = 1;
+
+  PageLog* log = &worker->pages;
+  log->numRanges = 0;
+  log->numPages = 0;
+  uint64_t trackedPages = 0;
+  uint64_t snapshotLength = 0;
+  for(uint64_t r = 0; r < instruction->numAccounts; r++) {
+    if(refs[r].account == CLOCK_ACCOUNT) {
+      SolAccountInfo info = { (SolPubkey*)&clockSysvarId, &clockLamports, sizeof(clock), (uint8_t*)clock,
+                              &sysvarOwner, 0, false, false, false };
+      infos[r] = info;
+      continue;
+    }
+    Account* account = &simulation->accounts.accounts[refs[r].account];
+    SolAccountInfo info = { &account->key, &account->lamports, account->length, account->data, &programId, 0,
+                            (refs[r].flags & ACCOUNT_SIGNER) != 0, (refs[r].flags & ACCOUNT_WRITABLE) != 0, false };
+    infos[r] = info;
+    if(!(refs[r].flags & ACCOUNT_WRITABLE)) {
+      continue;
+    }
+    // Lamports are always copied, as they live outside the account data
+    worker->snapshot = reserve(worker->snapshot, &worker->snapshotCapacity, snapshotLength + sizeof(uint64_t), 1);
+    sol_memcpy(&worker->snapshot[snapshotLength], &account->lamports, sizeof(uint64_t));
+    snapshotLength += sizeof(uint64_t);
+    if(account->length >= TRACKED_ACCOUNT_LENGTH) {
+      uint64_t length = (account->length + pageSize - 1) & ~(pageSize - 1);
+      log->start[log->numRanges] = account->data;
+      log->end[log->numRanges++] = account->data + length;
+      trackedPages += length / pageSize;
+      continue;
+    }
+    // libc's memcpy, as the SDK's copies a byte at a time
+    worker->snapshot = reserve(worker->snapshot, &worker->snapshotCapacity, snapshotLength + account->length, 1);
+    memcpy(&worker->snapshot[snapshotLength], account->data, account->length);
+    snapshotLength += account->length;
+  }
+  if(trackedPages > log->capacity) {
+    // Grown before protecting anything, as the handler cannot allocate
+    log->copies = realloc(log->copies, trackedPages * pageSize);
+    log->pages = realloc(log->pages, trackedPages * sizeof(uint8_t*));
+    if(log->copies == NULL || log->pages == NULL) {
+      fprintf(stderr, "Out of memory\n");
+      exit(1);
+    }
+    log->capacity = trackedPages;
+  }
+  for(uint64_t r = 0; r < log->numRanges; r++) {
+    mprotect(log->start[r], log->end[r] - log->start[r], PROT_READ);
+  }
+
+  SolParameters params = { infos, instruction->numAccounts, &window->data[instruction->dataOffset],
+                           instruction->dataLength, &programId };
+  Arena scratch;
+  arenaInit(&scratch, worker->heap, HEAP_LENGTH);
+  uint64_t logsBefore = stubLogCount;
+  uint64_t start = nowNanos();
+  uint64_t result = processInstruction(&params, NULL, &scratch);
+  uint64_t nanos = nowNanos() - start;
+
+  for(uint64_t r = 0; r < log->numRanges; r++) {
+    mprotect(log->start[r], log->end[r] - log->start[r], PROT_READ | PROT_WRITE);
+  }
+  if(result != SUCCESS) {
+    for(uint64_t p = 0; p < log->numPages; p++) {
+      memcpy(log->pages[p], &log->copies[p * pageSize], pageSize);
+    }
+    // Restored backwards, so an account passed twice gets its first copy
+    // back last, as the runtime drops every write
+    for(uint64_t r = instruction->numAccounts; r > 0; r--) {
+      if(refs[r - 1].account == CLOCK_ACCOUNT || !(refs[r - 1].flags & ACCOUNT_WRITABLE)) {
+        continue;
+      }
+      Account* account = &simulation->accounts.accounts[refs[r - 1].account];
+      if(account->length < TRACKED_ACCOUNT_LENGTH) {
+        snapshotLength -= account->length;
+        memcpy(account->data, &worker->snapshot[snapshotLength], account->length);
+      }
+      snapshotLength -= sizeof(uint64_t);
+      sol_memcpy(&account->lamports, &worker->snapshot[snapshotLength], sizeof(uint64_t));
+    }
+  }
+
+  SelectorStats* stats = &worker->stats[window->data[instruction->dataOffset]];
+  stats->count++;
+  stats->failed += result != SUCCESS;
+  stats->totalNanos += nanos;
+  stats->maxNanos = nanos > stats->maxNanos ? nanos : stats->maxNanos;
+  stats->logs += stubLogCount - logsBefore;
+  stats->buckets[latencyBucket(nanos)]++;
+}
+
+// Takes instructions off the queue until the window is done. An
+// instruction that releases others runs the first of them itself, which
+// keeps chains of conflicting instructions on one thread.
+static void* runWorker(void* arg) {
+  Worker* worker = arg;
+  pageLog = &worker->pages;
+  Simulation* simulation = worker->simulation;
+  Window* window = &simulation->window;
+  int64_t next = -1;
+  while(true) {
+    if(next < 0) {
+      pthread_mutex_lock(&simulation->lock);
+      while(simulation->head == simulation->tail && simulation->done < window->numInstructions) {
+        pthread_cond_wait(&simulation->ready, &simulation->lock);
+      }
+      if(simulation->head == simulation->tail) {
+        pthread_mutex_unlock(&simulation->lock);
+        return NULL;
+      }
+      next = simulation->queue[simulation->head++];
+      pthread_mutex_unlock(&simulation->lock);
+    }
+
+    uint32_t i = next;
+    execute(worker, i);
+    uint64_t numReleased = 0;
+    for(uint64_t s = window->firstSuccessor[i]; s < window->firstSuccessor[i + 1]; s++) {
+      uint32_t successor = window->successors[s];
+      if(atomic_fetch_sub_explicit(&window->waitingOn[successor], 1, memory_order_acq_rel) == 1) {
+        worker->released = reserve(worker->released, &worker->releasedCapacity, numReleased + 1, sizeof(uint32_t));
+        worker->released[numReleased++] = successor;
+      }
+    }
+
+    next = numReleased > 0 ? (int64_t)worker->released[0] : -1;
+    pthread_mutex_lock(&simulation->lock);
+    for(uint64_t r = 1; r < numReleased; r++) {
+      simulation->queue[simulation->tail++] = worker->released[r];
+    }
+    simulation->done++;
+    if(numReleased > 1 || simulation->done == window->numInstructions) {
+      pthread_cond_broadcast(&simulation->ready);
+    }
+    pthread_mutex_unlock(&simulation->lock);
+  }
+}
+
+// Replays the instructions of the window and empties it. Returns the
+// number of conflicts between them.
+static uint64_t runWindow(Simulation* simulation) {
+  Window* window = &simulation->window;
+  if(window->numInstructions == 0) {
+    return 0;
+  }
+  buildGraph(window, &simulation->accounts);
+  simulation->queue = realloc(simulation->queue, window->numInstructions * sizeof(uint32_t));
+  simulation->head = 0;
+  simulation->tail = 0;
+  simulation->done = 0;
+  for(uint64_t i = 0; i < window->numInstructions; i++) {
+    if(atomic_load_explicit(&window->waitingOn[i], memory_order_relaxed) == 0) {
+      simulation->queue[simulation->tail++] = i;
+    }
+  }
+  for(uint64_t w = 0; w < simulation->numWorkers; w++) {
+    if(pthread_create(&simulation->workers[w].thread, NULL, runWorker, &simulation->workers[w]) != 0) {
+      fprintf(stderr, "Failed to start worker %lu\n", w);
+      exit(1);
+    }
+  }
+  for(uint64_t w = 0; w < simulation->numWorkers; w++) {
+    pthread_join(simulation->workers[w].thread, NULL);
+  }
+  uint64_t numEdges = window->numEdges;
+  resetWindow(window);
+  return numEdges;
+}
+
+// FNV-1a of every account's address, lamports and data, in declaration
+// order, so runs with any number of threads can be compared
+static uint64_t stateChecksum(Accounts* accounts) {
+  uint64_t h = 0xCBF29CE484222325ULL;
+  for(uint64_t a = 0; a < accounts->numAccounts; a++) {
+    Account* account = &accounts->accounts[a];
+    const uint8_t* parts[] = { account->key.x, (const uint8_t*)&account->lamports, account->data };
+    uint64_t lengths[] = { SIZE_PUBKEY, sizeof(uint64_t), account->length };
+    for(int p = 0; p < 3; p++) {
+      for(uint64_t i = 0; i < lengths[p]; i++) {
+        h = (h ^ parts[p][i]) * 0x100000001B3ULL;
+      }
+    }
+  }
+  return h;
+}
+
+static bool writeDump(Accounts* accounts, const char* path) {
+  FILE* out = fopen(path, "wb");
+  if(out == NULL) {
+    perror(path);
+    return false;
+  }
+  for(uint64_t a = 0; a < accounts->numAccounts; a++) {
+    Account* account = &accounts->accounts[a];
+    fwrite(&account->key, sizeof(SolPubkey), 1, out);
+    fwrite(&account->length, sizeof(uint64_t), 1, out);
+    fwrite(account->data, account->length, 1, out);
+  }
+  if(fclose(out) != 0) {
+    perror(path);
+    return false;
+  }
+  return true;
+}
+
+static void printSelectorStats(SelectorStats* stats, uint64_t selector) {
+  char name[8];
+  if(selector >= 0x20 && selector < 0x7F) {
+    snprintf(name, sizeof(name), "%c", (char)selector);
+  }
+  else {
+    snprintf(name, sizeof(name), "0x%02lX", selector);
+  }
+  uint64_t percentiles[2] = { 0, 0 };
+  uint64_t ranks[2] = { (stats->count + 1) / 2, stats->count - stats->count / 100 };
+  uint64_t seen = 0;
+  int p = 0;
+  for(uint64_t b = 0; b < LATENCY_BUCKETS && p < 2; b++) {
+    seen += stats->buckets[b];
+    while(p < 2 && seen >= ranks[p]) {
+      percentiles[p++] = bucketNanos(b);
+    }
+  }
+  printf("  %8s %12lu %10lu %10.0f %10lu %10lu %10lu %8.1f\n", name, stats->count, stats->failed,
+         (double)stats->totalNanos / stats->count, percentiles[0], percentiles[1], stats->maxNanos,
+         (double)stats->logs / stats->count);
+}
+
+static int simulate(const char* path, uint64_t numThreads, const char* dumpPath) {
+  FILE* trace = fopen(path, "r");
+  if(trace == NULL) {
+    perror(path);
+    return 1;
+  }
+  struct sigaction action = { .sa_sigaction = savePage, .sa_flags = SA_SIGINFO };
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGSEGV, &action, NULL);
+
+  static Simulation simulation;
+  simulation.numWorkers = numThreads;
+  simulation.workers = calloc(numThreads, sizeof(Worker));
+  pthread_mutex_init(&simulation.lock, NULL);
+  pthread_cond_init(&simulation.ready, NULL);
+  for(uint64_t w = 0; w < numThreads; w++) {
+    simulation.workers[w].simulation = &simulation;
+    simulation.workers[w].stats = calloc(256, sizeof(SelectorStats));
+    simulation.workers[w].heap = malloc(HEAP_LENGTH);
+    if(simulation.workers[w].stats == NULL || simulation.workers[w].heap == NULL) {
+      fprintf(stderr, "Out of memory\n");
+      return 1;
+    }
+  }
+
+  char* line = NULL;
+  size_t capacity = 0;
+  uint64_t lineNumber = 0;
+  uint64_t numInstructions = 0;
+  uint64_t numEdges = 0;
+  uint64_t firstSlot = UINT64_MAX;
+  uint64_t lastSlot = 0;
+  static TraceLine fields;
+  uint64_t start = nowNanos();
+  while(getline(&line, &capacity, trace) >= 0) {
+    lineNumber++;
+    if(*skipSpace(line) == '\0') {
+      continue;
+    }
+    if(!parseTraceLine(line, &fields)) {
+      fprintf(stderr, "%s:%lu: malformed line\n", path, lineNumber);
+      return 1;
+    }
+    if(fields.account != NULL) {
+      if(!declareAccount(&simulation.accounts, fields.account, fields.size, fields.key)) {
+        fprintf(stderr, "%s:%lu: invalid account\n", path, lineNumber);
+        return 1;
+      }
+      continue;
+    }
+    if((fields.text == NULL) == (fields.data == NULL) || !addInstruction(&simulation.window, &simulation.accounts, &fields)) {
+      fprintf(stderr, "%s:%lu: invalid instruction\n", path, lineNumber);
+      return 1;
+    }
+    numInstructions++;
+    firstSlot = fields.slot < firstSlot ? fields.slot : firstSlot;
+    lastSlot = fields.slot > lastSlot ? fields.slot : lastSlot;
+    if(simulation.window.numInstructions == WINDOW_INSTRUCTIONS) {
+      numEdges += runWindow(&simulation);
+    }
+  }
+  free(line);
+  fclose(trace);
+  numEdges += runWindow(&simulation);
+  double millis = millisSince(start);
+
+  SelectorStats* total = simulation.workers[0].stats;
+  uint64_t failed = 0;
+  for(uint64_t w = 1; w < numThreads; w++) {
+    for(uint64_t s = 0; s < 256; s++) {
+      SelectorStats* stats = &simulation.workers[w].stats[s];
+      total[s].count += stats->count;
+      total[s].failed += stats->failed;
+      total[s].totalNanos += stats->totalNanos;
+      total[s].maxNanos = stats->maxNanos > total[s].maxNanos ? stats->maxNanos : total[s].maxNanos;
+      total[s].logs += stats->logs;
+      for(uint64_t b = 0; b < LATENCY_BUCKETS; b++) {
+        total[s].buckets[b] += stats->buckets[b];
+      }
+    }
+  }
+  for(uint64_t s = 0; s < 256; s++) {
+    failed += total[s].failed;
+  }
+
+  printf("Replayed %lu instructions over %lu accounts on %lu threads in %.1f ms, %.0f instructions/s\n",
+         numInstructions, simulation.accounts.numAccounts, numThreads, millis, numInstructions / (millis / 1000));
+  printf("%lu failed and were rolled back, %.2f conflicts per instruction\n", failed,
+         numInstructions == 0 ? 0.0 : (double)numEdges / numInstructions);
+  if(numInstructions > 0) {
+    double traceSeconds = (double)(lastSlot - firstSlot + 1) * SLOT_MILLIS / 1000;
+    printf("Trace covers %lu slots, %.1f hours of traffic at %d ms per slot, replayed %.0fx faster\n",
+           lastSlot - firstSlot + 1, traceSeconds / 3600, SLOT_MILLIS, traceSeconds / (millis / 1000));
+  }
+  printf("\n  %8s %12s %10s %10s %10s %10s %10s %8s\n", "selector", "count", "failed", "mean ns",
+         "p50 ns", "p99 ns", "max ns", "logs/op");
+  for(uint64_t s = 0; s < 256; s++) {
+    if(total[s].count > 0) {
+      printSelectorStats(&total[s], s);
+    }
+  }
+  printf("\nState checksum %016lx\n", stateChecksum(&simulation.accounts));
+
+  if(dumpPath != NULL) {
+    if(!writeDump(&simulation.accounts, dumpPath)) {
+      return 1;
+    }
+    printf("Wrote %lu accounts to %s\n", simulation.accounts.numAccounts, dumpPath);
+  }
+  return 0;
+}
+
+// Trace generation
+// ----------------------------------------------------------------------------
+// Room for a generated record with its stamp and index entry, doubled so
+// that users who post more than their share do not run out
+#define GENERATED_RECORD_SPACE 320
+#define GENERATED_MAX_BODY 80
+
+static void writeHex(FILE* out, const void* bytes, uint64_t length) {
+  for(uint64_t i = 0; i < length; i++) {
+    fprintf(out, "%02x", ((const uint8_t*)bytes)[i]);
+  }
+}
+
+// Writes a trace of posts, counted posts, replies, likes and reports by
+// users picked uniformly at random. Replies, likes and reports target an
+// earlier post and pass its poster's account writable a quarter of the
+// time, so that their counters are bumped and the replay has conflicts
+// to keep in order.
+static int generateTrace(const char* path, uint64_t users, uint64_t instructions) {
+  if(users == 0) {
+    fprintf(stderr, "At least one user is needed\n");
+    return 1;
+  }
+  FILE* out = fopen(path, "w");
+  if(out == NULL) {
+    perror(path);
+    return 1;
+  }
+  uint64_t size = sizeof(AccountMetadata) + (instructions / users + 1) * GENERATED_RECORD_SPACE;
+  for(uint64_t u = 0; u < users; u++) {
+    fprintf(out, "{\"account\":\"u%lu\",\"size\":%lu}\n", u, size);
+  }
+
+  uint32_t* numPosts = calloc(users, sizeof(uint32_t));
+  uint64_t seed = 1;
+  uint64_t posted = 0;
+  for(uint64_t i = 0; i < instructions; i++) {
+    seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    uint64_t u = (seed >> 33) % users;
+    uint64_t roll = (seed >> 20) % 100;
+    uint8_t selector = posted == 0 || roll < 30 ? POST_SELECTOR :
+                       roll < 55 ? REPLY_SELECTOR : roll < 90 ? LIKE_SELECTOR : REPORT_SELECTOR;
+    bool counted = selector == POST_SELECTOR && (seed & 1);
+    uint8_t first = selector | (counted ? COUNTERS_FLAG : 0);
+
+    fprintf(out, "{\"slot\":%lu,\"data\":\"", i / GENERATED_PER_SLOT);
+    writeHex(out, &first, 1);
+    if(counted) {
+      PostCounters counters = { 0, };
+      writeHex(out, &counters, sizeof(counters));
+    }
+    uint64_t target = 0;
+    bool bump = false;
+    if(selector != POST_SELECTOR) {
+      // The first user with posts at or after a random one
+      seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+      target = (seed >> 33) % users;
+      while(numPosts[target] == 0) {
+        target = (target + 1) % users;
+      }
+      uint32_t index = (seed >> 8) % numPosts[target];
+      fprintf(out, "{u%lu}", target);
+      writeHex(out, &index, sizeof(index));
+      bump = (seed >> 60) % 4 == 0 && target != u;
+    }
+    if(selector != LIKE_SELECTOR) {
+      char body[GENERATED_MAX_BODY];
+      int length = snprintf(body, sizeof(body), "message %lu from u%lu at slot %lu", i, u,
+                            i / GENERATED_PER_SLOT);
+      writeHex(out, body, length);
+    }
+    fprintf(out, "\",\"accounts\":[\"sw:u%lu\"", u);
+    if(bump) {
+      fprintf(out, ",\"w:u%lu\"", target);
+    }
+    fprintf(out, ",\"clock\"]}\n");
+    numPosts[u]++;
+    posted++;
+  }
+  free(numPosts);
+  if(fclose(out) != 0) {
+    perror(path);
+    return 1;
+  }
+  printf("Wrote %lu accounts and %lu instructions to %s\n", users, instructions, path);
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  pageSize = sysconf(_SC_PAGESIZE);
+  if(argc < 2 || argc > 5) {
+    fprintf(stderr, "Usage: %s TRACE [THREADS [DUMP] | generate USERS INSTRUCTIONS]\n", argv[0]);
+    return 1;
+  }
+  if(argc == 5 && strcmp(argv[2], "generate") == 0) {
+    return generateTrace(argv[1], strtoull(argv[3], NULL, 10), strtoull(argv[4], NULL, 10));
+  }
+  uint64_t threads = argc >= 3 ? strtoull(argv[2], NULL, 10) : (uint64_t)sysconf(_SC_NPROCESSORS_ONLN);
+  if(threads == 0 || threads > MAX_THREADS || argc == 5) {
+    fprintf(stderr, "Usage: %s TRACE [THREADS [DUMP] | generate USERS INSTRUCTIONS]\n", argv[0]);
+    return 1;
+  }
+  return simulate(argv[1], threads, argc == 4 ? argv[3] : NULL);
+}
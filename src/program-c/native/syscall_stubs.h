@@ -0,0 +1,32 @@
+/**
+ * @brief Syscall stubs for running the forum program natively
+ *
+ * Include once per host tool, after helloworld.c. Log syscalls are
+ * counted instead of printed so that tools measure the handlers rather
+ * than stdout.
+ */
+#pragma once
+
+#include <stdlib.h>
+
+// Number of log syscalls made since startup by the calling thread
+_Thread_local uint64_t stubLogCount = 0;
+
+void sol_log_(const char* message, uint64_t length) {
+  stubLogCount++;
+}
+
+void sol_log_64_(uint64_t arg1, uint64_t arg2, uint64_t arg3, uint64_t arg4, uint64_t arg5) {
+  stubLogCount++;
+}
+
+void sol_log_pubkey(const SolPubkey* pubkey) {
+  stubLogCount++;
+}
+
+void sol_log_compute_units_() {
+}
+
+void sol_panic_(const char* file, uint64_t length, uint64_t line, uint64_t column) {
+  abort();
+}
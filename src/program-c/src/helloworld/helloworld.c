@@ -6,6 +6,63 @@
 #define OFFSETOF(TYPE, ELEMENT) ((size_t)&(((TYPE *)0)->ELEMENT))
 #define USERNAME_LENGTH 32
 
+// Logging
+// ----------------------------------------------------------------------------
+/*
+Every sol_log costs compute, so logs are compiled in or out by LOG_LEVEL,
+which the makefile sets from its LOG_LEVEL variable:
+
+LOG_LEVEL_NONE   no logs at all
+LOG_LEVEL_ERROR  one line per failure: its numeric code and up to 2 values
+LOG_LEVEL_INFO   failure messages with their details, and petition outcomes
+LOG_LEVEL_DEBUG  everything, including the entrypoint and per-item logs
+
+Error codes are grouped by area: 1xx entrypoint and dispatch, 2xx posts,
+3xx petitions, 4xx batches, 5xx account maintenance. Search this file for
+a code to find the failure it reports.
+*/
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_INFO 2
+#define LOG_LEVEL_DEBUG 3
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_ERROR(code, message) sol_log(message)
+#define LOG_ERROR_64(code, message, a, b) (sol_log(message), sol_log_64(a, b, 0, 0, 0))
+#elif LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(code, message) sol_log_64(code, 0, 0, 0, 0)
+#define LOG_ERROR_64(code, message, a, b) sol_log_64(code, a, b, 0, 0)
+#else
+#define LOG_ERROR(code, message) ((void)0)
+#define LOG_ERROR_64(code, message, a, b) ((void)0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(message) sol_log(message)
+#define LOG_INFO_64(a, b, c, d, e) sol_log_64(a, b, c, d, e)
+#define LOG_INFO_PUBKEY(key) sol_log_pubkey(key)
+#else
+#define LOG_INFO(message) ((void)0)
+#define LOG_INFO_64(a, b, c, d, e) ((void)0)
+#define LOG_INFO_PUBKEY(key) ((void)0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(message) sol_log(message)
+#define LOG_DEBUG_64(a, b, c, d, e) sol_log_64(a, b, c, d, e)
+#define LOG_DEBUG_PUBKEY(key) sol_log_pubkey(key)
+#define LOG_DEBUG_ARRAY(data, length) sol_log_array(data, length)
+#else
+#define LOG_DEBUG(message) ((void)0)
+#define LOG_DEBUG_64(a, b, c, d, e) ((void)0)
+#define LOG_DEBUG_PUBKEY(key) ((void)0)
+#define LOG_DEBUG_ARRAY(data, length) ((void)0)
+#endif
+
 // Structures and constants
 // ----------------------------------------------------------------------------
 /*
@@ -15,24 +72,99 @@ uninitialized
 */
 typedef enum {
   User = 1,
-  Petition = 2
+  Petition = 2,
+  CounterShard = 3,
+  UserPage = 4,
+  PetitionPool = 5
 } AccountType;
 
 // A unique identifier for a single post
 typedef struct {
   SolPubkey poster;
-  uint16_t index;
+  uint32_t index;
 } PostID;
 
+// The post identifier stored in version 1 user account records
+typedef struct {
+  SolPubkey poster;
+  uint16_t index;
+} PostIDV1;
+
 // User account metadata
+// Version 1 accounts end their header before numPosts, and keep their post
+// count in numPostsV1. Every other field has the same offset in both.
 typedef struct {
   uint8_t accountType;
-  uint16_t numPosts;
+  uint8_t version; // USER_VERSION_1 or USER_VERSION_2
+  uint16_t numPostsV1; // post count of version 1 accounts, 0 on version 2
   char username[USERNAME_LENGTH]; // null-terminated if shorter than 32 bytes
+  uint32_t tailOffset; // first byte not used for post data, 0 on legacy accounts
   uint64_t reputation;
+  uint32_t numPosts; // version 2 only
+  uint32_t numPages; // continuation pages, version 2 only
 } AccountMetadata;
 
-// A single petition signature
+_Static_assert(OFFSETOF(AccountMetadata, username) == 4, "username moved");
+_Static_assert(OFFSETOF(AccountMetadata, tailOffset) == 36, "tailOffset moved");
+_Static_assert(OFFSETOF(AccountMetadata, reputation) == 40, "reputation moved");
+_Static_assert(OFFSETOF(AccountMetadata, numPosts) == 48, "numPosts moved");
+_Static_assert(sizeof(AccountMetadata) == 56, "AccountMetadata is not packed");
+
+// User account versions
+// Accounts created before the version byte have 0 in its place
+#define USER_VERSION_1 0
+#define USER_VERSION_2 2
+// Size of the header of version 1 accounts
+#define USER_V1_HEADER_SIZE OFFSETOF(AccountMetadata, numPosts)
+// Version 2 records start at multiples of this
+#define RECORD_ALIGNMENT 4
+
+// Continuation page account data
+// Shares the version, tailOffset and numPosts offsets of AccountMetadata so
+// records and the post index are handled the same way in both.
+typedef struct {
+  uint8_t accountType; // UserPage
+  uint8_t version; // always USER_VERSION_2
+  uint16_t reserved;
+  SolPubkey owner; // the user account whose posts continue here
+  uint32_t tailOffset;
+  uint32_t firstPost; // PostID index of the first post on this page
+  uint32_t page; // 1 for the first continuation page
+  uint32_t numPosts;
+  uint32_t reserved2;
+} UserPageMeta;
+
+_Static_assert(OFFSETOF(UserPageMeta, version) == OFFSETOF(AccountMetadata, version), "page version moved");
+_Static_assert(OFFSETOF(UserPageMeta, tailOffset) == OFFSETOF(AccountMetadata, tailOffset), "page tail moved");
+_Static_assert(OFFSETOF(UserPageMeta, numPosts) == OFFSETOF(AccountMetadata, numPosts), "page count moved");
+_Static_assert(sizeof(UserPageMeta) == sizeof(AccountMetadata), "UserPageMeta is not packed");
+
+// Byte offset of a post record, stored in the post index
+typedef uint32_t PostSlot;
+
+// Set in the post index slot of a record that follows a SlotStamp. Version
+// 2 records start at multiples of RECORD_ALIGNMENT, so the bit is free.
+#define STAMPED_RECORD 0x1
+// Clock slot a record was written in, stored right before its length
+typedef uint64_t SlotStamp;
+
+// Aggregate counters carried by posts created with COUNTERS_FLAG
+typedef struct {
+  uint32_t likes;
+  uint32_t replies;
+  uint32_t reports;
+} PostCounters;
+
+// Counter shard account data
+typedef struct {
+  uint8_t accountType;
+  uint8_t shard;      // this shard's number, below shardCount
+  uint8_t shardCount; // number of shards the poster created for the post
+  PostID post;
+  PostCounters counters;
+} CounterShardMeta;
+
+// A single petition signature in the record layout
 typedef struct {
   SolPubkey signer;
   uint8_t vote;
@@ -41,12 +173,125 @@ typedef struct {
 // Petition account data
 typedef struct {
   uint8_t accountType;
+  uint8_t layout; // PETITION_LAYOUT_*, this header is used from PETITION_LAYOUT_V2
+  uint8_t completed; // PETITION_OPEN, PETITION_SETTLED or PETITION_FINALIZED
+  uint8_t reserved;
   PostID offendingPost;
+  int64_t netTally; // votes for minus votes against
+  uint32_t reputationRequirement;
+  uint16_t numSignatures;
+  uint16_t hashSlots; // size of the voter hash table, 0 on legacy petitions
+} PetitionAccountMeta;
+
+// Header of petitions created before PETITION_LAYOUT_V2
+// Fields from netTally on share the offsets of PetitionAccountMeta.
+typedef struct {
+  uint8_t accountType;
+  uint8_t layout; // PETITION_LAYOUT_RECORDS or PETITION_LAYOUT_COLUMNS
+  PostIDV1 offendingPost;
   uint8_t completed;
+  uint16_t votesFor; // votes against are numSignatures - votesFor
   int64_t netTally;
   uint32_t reputationRequirement;
   uint16_t numSignatures;
-} PetitionAccountMeta;
+  uint16_t hashSlots;
+} PetitionAccountMetaV1;
+
+_Static_assert(OFFSETOF(PetitionAccountMeta, offendingPost) == 4, "offendingPost moved");
+_Static_assert(OFFSETOF(PetitionAccountMeta, netTally) == OFFSETOF(PetitionAccountMetaV1, netTally),
+               "petition headers diverge");
+_Static_assert(OFFSETOF(PetitionAccountMeta, hashSlots) == OFFSETOF(PetitionAccountMetaV1, hashSlots),
+               "petition headers diverge");
+_Static_assert(sizeof(PetitionAccountMeta) == 56, "PetitionAccountMeta is not packed");
+_Static_assert(sizeof(PetitionAccountMetaV1) == 56, "PetitionAccountMetaV1 changed");
+
+// Entry in a petition's voter hash table: signature index + 1, or 0 if empty
+typedef uint16_t PetitionHashSlot;
+
+// Petition layouts
+#define PETITION_LAYOUT_RECORDS 0
+#define PETITION_LAYOUT_COLUMNS 1
+// Columns with the aligned header and a 32-bit offending post index
+#define PETITION_LAYOUT_V2 2
+
+// Petition states
+#define PETITION_OPEN 0
+// Outcome applied to the offender and every voter
+#define PETITION_SETTLED 1
+// Outcome applied to the offender, voters claim their own rewards
+#define PETITION_FINALIZED 2
+
+/*
+Petition account layouts:
+
+Columns (PETITION_LAYOUT_V2 and PETITION_LAYOUT_COLUMNS):
+PetitionAccountMeta | vote bitset | voter hash table | signer keys
+
+Votes are packed one bit per signature into uint64_t words, so tallies
+are a popcount per 64 votes, and signer keys are a contiguous SolPubkey
+array. The bitset starts right after the 8-byte aligned metadata.
+PETITION_LAYOUT_COLUMNS petitions use the PetitionAccountMetaV1 header,
+which only differs in the fields before netTally.
+
+Records (older petitions):
+PetitionAccountMetaV1 | voter hash table | PetitionSignature array
+
+The hash table has HASH_SLOTS_PER_SIGNATURE open-addressed slots per
+signature, so duplicate votes are found in a few probes at any petition
+size. Legacy record petitions (hashSlots == 0) have no table.
+*/
+
+// Petition pool account data, followed by numSlots slots of slotSize bytes
+typedef struct {
+  uint8_t accountType; // PetitionPool
+  uint8_t reserved;
+  uint16_t numSlots;
+  uint16_t firstUnused; // slots from here on have never held a petition
+  uint16_t freeHead; // most recently released slot + 1, 0 if there is none
+  uint32_t slotSize; // PetitionPoolSlot and the petition, a multiple of 8
+  uint32_t openPetitions; // slots currently holding a petition
+} PetitionPoolMeta;
+
+// Header of each petition pool slot, followed by a column layout petition
+typedef struct {
+  uint32_t generation; // bumped every time the slot is allocated
+  uint16_t nextFree; // next released slot + 1 while on the free list
+  uint16_t unclaimed; // rewards of a finalized petition not yet claimed
+} PetitionPoolSlot;
+
+_Static_assert(sizeof(PetitionPoolMeta) == 16, "PetitionPoolMeta is not packed");
+_Static_assert(sizeof(PetitionPoolSlot) == 8, "PetitionPoolSlot is not packed");
+
+/*
+Petition pools:
+
+A petition account is created and funded for a single petition and is
+dead weight once it settles. A pool account instead holds many
+fixed-size slots, each a PetitionPoolSlot header followed by a
+PETITION_LAYOUT_V2 petition, so every petition helper works on a slot
+unchanged. Petitions in a pool are addressed by (pool, slot, generation):
+the generation is bumped whenever a slot is handed out, so instructions
+meant for a recycled slot's previous petition are rejected.
+
+Slots are handed out from the free list first and then from firstUnused
+on, so creating a pool costs the same at any size. A slot goes back on
+the free list as soon as its petition is settled, or once every reward
+of a finalized petition is claimed. Claims need no signature, so anyone
+can claim the remaining rewards of a finalized petition to recycle it.
+Released slots have 0 in the first byte of their petition.
+*/
+
+/*
+Counter shards:
+
+A post's counters live in its poster's account, so every like of a
+popular post would write-lock that one account and serialize behind the
+others. The poster can instead create shardCount shard accounts for the
+post. Each client picks one by hashing its signer key (see
+counterShard()) and passes it as the target account, so likes from
+different users lock different accounts. Readers sum the post's own
+counters and all of its shards.
+*/
 
 /*
 Post format:
@@ -54,16 +299,90 @@ Post format:
 width       name          type          description
 -----------------------------------------------------------------------------
 2           length        uint16_t      size of the rest of the post
-1           typeSelector  uint8_t       type selector (ASCII P, R, L, or X)
+1           typeSelector  uint8_t       type selector (ASCII P, R, L, or X),
+                                        OR COMPRESSED_FLAG if the body is
+                                        compressed (P, R or X only),
+                                        OR COUNTERS_FLAG if counted,
+                                        OR REDACTED_FLAG once redacted
+-----If typeSelector & COUNTERS_FLAG (P, R or X only)------------------------
+12          counters      PostCounters  zero in instructions, bumped by
+                                        replies, likes and reports that
+                                        pass this post's account
 
 The rest is dependent on the value of typeSelector:
 -----If typeSelector == 'P'--------------------------------------------------
 length-1    postBody      uint8_t[]     utf-8 body of the post
 -----If 'R' or 'X'-----------------------------------------------------------
-34          id            PostID        the post referenced by this post
-length-35   postBody      uint8_t[]     utf-8 body of the post
+36          id            PostID        the post referenced by this post
+length-37   postBody      uint8_t[]     utf-8 body of the post
 -----If 'L'------------------------------------------------------------------
-34          id            PostID        the post being liked by this post
+36          id            PostID        the post being liked by this post
+
+Instructions carry the post without its length. Records in version 1
+user accounts hold 34 byte PostIDV1 ids instead.
+*/
+
+/*
+Compressed bodies:
+
+Posts, replies and reports sent with COMPRESSED_FLAG (ASCII Q, S or Y)
+store their body compressed. The program only checks that the body
+decodes to its declared length and stores it as is. Clients compress a
+body when that makes it shorter.
+
+width       name          type          description
+-----------------------------------------------------------------------------
+2           bodyLength    uint16_t      length of the decoded body
+rest        tokens        uint8_t[]     tokens, decoded in order
+
+Tokens:
+0x00-0x7F   literal       t + 1 bytes copied from the tokens that follow
+0x80-0xBF   word          entry t - 0x80 of bodyDictionary
+0xC0-0xFF   match         (t & 0x3F) + MIN_BODY_MATCH bytes copied from
+                          distance bytes back in the decoded body, where
+                          distance is the uint16_t following the token
+                          (1 to the number of bytes decoded so far)
+
+Redaction overwrites the compressed bytes and clears COMPRESSED_FLAG.
+*/
+
+/*
+User account layout:
+
+AccountMetadata | post records --> | free space | <-- post index
+
+Records are appended at tailOffset. The post index is an array of PostSlot
+offsets that grows downward from the end of the account, so the slot for
+post i lives at data_len - (i + 1) * sizeof(PostSlot). Appends and lookups
+by index are constant time. In version 2 accounts every record starts at
+a multiple of RECORD_ALIGNMENT, so record lengths load aligned.
+
+Instructions that pass the Clock sysvar as their last account stamp the
+records they write: the slot is stored as a SlotStamp right before the
+record and its index slot has STAMPED_RECORD set. postOffset() masks the
+flag, so only code that moves records has to carry stamps along. Within
+an account, stamped records are in slot order, which lets per-account
+logs be merged into a global timeline.
+
+Version 1 accounts have the shorter header, a 16-bit post count and
+PostIDV1 ids. Legacy accounts (version 1 with tailOffset == 0) also have
+no index. Both must be upgraded with the migrate instruction before they
+can accept new posts, but can still be read, redacted and counted.
+
+When a user account fills up, the user can open continuation pages, each
+a separate UserPage account with the same layout behind a UserPageMeta
+header. Pages are numbered from 1 and the user account keeps numPages.
+Only the newest page takes new posts, so each page holds a contiguous
+range of PostID indexes starting at its firstPost, and the user account
+holds the posts from 0. Pages are created at the address derived from the
+owner with the seed "page:<number>", so clients compute page addresses
+rather than search for them, and find the page holding a post by its
+firstPost.
+
+Compaction may drop records, leaving a 0 (tombstone) in their index slot,
+and may leave unused gaps between records, so records of indexed
+accounts must be found through the index rather than by walking them.
+Live records always appear in index order.
 */
 
 typedef union {
@@ -74,7 +393,9 @@ typedef union {
 // Storage for a single post of any type
 typedef struct {
   uint16_t length;
-  uint8_t typeSelector;
+  uint8_t typeSelector; // without COUNTERS_FLAG and COMPRESSED_FLAG
+  bool hasCounters;
+  bool compressed; // body uses the compressed body format
   PostID id;
   // Violate const safety with union
   String body;
@@ -97,10 +418,68 @@ typedef struct {
 #define MAX_INSTRUCTION_LENGTH 0xFFFF
 // The size of a new petition account instruction
 // selector + post index
-#define CREATE_PETITION_INSTRUCTION_SIZE (1 + sizeof(uint16_t))
-// The maximum number of slots in a petition
-// (585 as of 4/29/21)
-#define MAX_PETITION_SIZE (HEAP_LENGTH / sizeof(SolAccountInfo))
+#define CREATE_PETITION_INSTRUCTION_SIZE (1 + sizeof(uint32_t))
+// The size of a compaction instruction
+// selector + flags + first post index + post count
+#define COMPACT_INSTRUCTION_SIZE (1 + 1 + 2 * sizeof(uint32_t))
+// Compaction flag that drops like records
+#define COMPACT_DROP_LIKES 0x01
+// The size of a new counter shard instruction
+// selector + post index + shard + shard count
+#define CREATE_SHARD_INSTRUCTION_SIZE (1 + sizeof(uint32_t) + 2)
+// The longest seed createWithSeed accepts
+#define MAX_SEED_LENGTH 32
+// Seed of a continuation page address, followed by the page number
+#define PAGE_SEED_PREFIX "page:"
+// Seed of a counter shard address, followed by the post index, ':' and the
+// shard number
+#define SHARD_SEED_PREFIX "shard:"
+// Voter hash table slots per petition signature (load factor 1/2)
+#define HASH_SLOTS_PER_SIGNATURE 2
+// Bytes stored per signature in the column layout, excluding its vote bit
+#define SIGNATURE_COLUMN_SIZE (sizeof(SolPubkey) + HASH_SLOTS_PER_SIGNATURE * sizeof(PetitionHashSlot))
+// The number of vote bitset words for n signatures
+#define VOTE_WORDS(n) (((uint64_t)(n) + 63) / 64)
+// The size of a petition account that holds n signatures
+#define PETITION_ACCOUNT_SIZE(n) (sizeof(PetitionAccountMeta) + \
+  VOTE_WORDS(n) * sizeof(uint64_t) + (n) * SIGNATURE_COLUMN_SIZE)
+// The maximum number of slots in a petition, as the voter hash table is
+// indexed by uint16_t
+#define MAX_PETITION_SIZE (UINT16_MAX / HASH_SLOTS_PER_SIGNATURE)
+// Bytes of a petition pool slot holding petitions of n signatures
+#define PETITION_SLOT_SIZE(n) ((sizeof(PetitionPoolSlot) + PETITION_ACCOUNT_SIZE(n) + 7) & ~7ULL)
+// Pool slot and generation that follow instructions for pooled petitions
+#define PETITION_REF_SIZE (sizeof(uint16_t) + sizeof(uint32_t))
+#define CREATE_POOL_INSTRUCTION_SIZE (1 + sizeof(uint16_t))
+
+// Compressed bodies
+// Shortest match token, shorter repeats are cheaper as literals
+#define MIN_BODY_MATCH 4
+#define LITERAL_TOKEN_LIMIT 0x80
+#define WORD_TOKEN_LIMIT 0xC0
+#define BODY_WORD_LENGTH 7
+
+// Entry of the static dictionary used by compressed bodies
+typedef struct {
+  uint8_t length;
+  char text[BODY_WORD_LENGTH];
+} BodyWord;
+
+// Common fragments of forum posts. Entries may only be appended, stored
+// bodies refer to them by position.
+static const BodyWord bodyDictionary[WORD_TOKEN_LIMIT - LITERAL_TOKEN_LIMIT] = {
+  {5, " the "}, {5, " and "}, {4, " to "}, {4, " of "}, {3, " a "}, {4, " in "},
+  {4, " is "}, {6, " that "}, {5, " for "}, {4, " it "}, {5, " you "}, {6, " with "},
+  {4, " on "}, {6, " this "}, {4, " be "}, {5, " are "}, {5, " not "}, {6, " have "},
+  {5, " was "}, {5, " but "}, {6, " they "}, {4, " at "}, {4, " or "}, {6, " from "},
+  {4, " my "}, {4, " if "}, {6, " just "}, {6, " what "}, {5, " can "}, {6, " will "},
+  {5, " all "}, {6, " about"}, {4, " we "}, {4, " so "}, {4, " an "}, {6, " like "},
+  {6, " your "}, {6, " would"}, {6, " there"}, {6, " think"}, {5, " post"}, {6, " reply"},
+  {7, "http://"}, {7, "https:/"}, {4, ".com"}, {4, "www."}, {4, "ing "}, {4, "tion"},
+  {3, "ed "}, {3, "er "}, {3, "'s "}, {4, "n't "}, {2, ". "}, {2, ", "},
+  {2, "! "}, {2, "? "}, {3, " I "}, {4, "The "}, {5, "This "}, {2, "I "},
+  {3, "..."}, {2, "\n\n"}, {3, "ly "}, {3, "es "},
+};
 
 // Instruction type selectors
 // Basic forum instructions
@@ -108,30 +487,244 @@ typedef struct {
 #define REPLY_SELECTOR 'R'
 #define LIKE_SELECTOR 'L'
 #define REPORT_SELECTOR 'X'
+#define BATCH_SELECTOR 'B'
+// Set on a post, reply or report selector to reserve PostCounters
+#define COUNTERS_FLAG 0x80
+// Set on the selector of stored records by redaction (lowercases it)
+#define REDACTED_FLAG 0x20
+// Set on a post, reply or report selector whose body is compressed
+#define COMPRESSED_FLAG 0x01
+#define COMPRESSED_POST_SELECTOR (POST_SELECTOR | COMPRESSED_FLAG)
+#define COMPRESSED_REPLY_SELECTOR (REPLY_SELECTOR | COMPRESSED_FLAG)
+#define COMPRESSED_REPORT_SELECTOR (REPORT_SELECTOR | COMPRESSED_FLAG)
 
 // Petition instructions
 #define VOTE_SELECTOR 'V'
 #define CREATE_PETITION_SELECTOR 'C'
 #define PROCESS_PETITION_SELECTOR 'F'
+#define CLAIM_REWARD_SELECTOR 'W'
+#define CREATE_POOL_SELECTOR 'O'
 
 // Misc.
 #define SET_USERNAME_SELECTOR 's'
+#define CREATE_SHARD_SELECTOR 'K'
+#define COMPACT_SELECTOR 'G'
+#define MIGRATE_SELECTOR 'M'
+#define OPEN_PAGE_SELECTOR 'N'
 #define REDACTION_BYTE 'x'
 
 // END structures and constants
 // ----------------------------------------------------------------------------
 
+// Heap arena
+// ----------------------------------------------------------------------------
+/*
+The program heap is HEAP_LENGTH bytes at HEAP_START_ADDRESS, with no
+allocator and nothing ever freed. The entrypoint allocates the account
+array from it first, sized to the instruction's accounts rather than to
+the whole heap, and passes the rest on as scratch space. Allocations
+bump a cursor, are 8-byte aligned and are not zeroed. Each instruction
+gets a fresh arena, and a handler can give back temporary buffers by
+saving arena->next and restoring it afterwards. Petition settlement
+keeps its voter bitmaps there.
+*/
+typedef struct {
+  uint8_t* next;
+  uint8_t* end;
+} Arena;
+
+#define ARENA_ALIGNMENT 8
+
+void arenaInit(Arena* arena, uint8_t* start, uint64_t length) {
+  arena->next = start;
+  arena->end = start + length;
+}
+
+// Returns size bytes of the arena, or NULL if they don't fit
+void* arenaAlloc(Arena* arena, uint64_t size) {
+  uint64_t padding = -(uint64_t)arena->next & (ARENA_ALIGNMENT - 1);
+  if(padding > (uint64_t)(arena->end - arena->next) ||
+     size > (uint64_t)(arena->end - arena->next) - padding) {
+    return NULL;
+  }
+  void* p = arena->next + padding;
+  arena->next += padding + size;
+  return p;
+}
+
+// Program input
+// ----------------------------------------------------------------------------
+/*
+The loader serializes each account as a duplicate marker (the index of
+an earlier account, or NON_DUP_MARKER) followed either by 7 bytes of
+padding or by:
+
+  is_signer, is_writable, executable  uint8_t each
+  padding                             4 bytes
+  key, owner                          SolPubkey each
+  lamports, data_len                  uint64_t each
+  data                                data_len + MAX_PERMITTED_DATA_INCREASE
+  padding                             to a multiple of 8
+  rent_epoch                          uint64_t
+
+The instruction data follows the last account, so finding the selector
+means stepping over every account, but that only reads data_len. The
+entrypoint records where each account starts as it goes, and then
+parses only the accounts the handler uses (see accountsUsed()). Accounts
+past those, such as the voters of a petition being settled, are parsed
+one at a time through instructionAccount().
+*/
+#define NON_DUP_MARKER 0xFF
+#define DUP_ACCOUNT_SIZE 8
+#define ACCOUNT_DATA_LEN_OFFSET (8 + 2 * sizeof(SolPubkey) + sizeof(uint64_t))
+
+typedef struct {
+  const uint8_t* input; // the serialized program input
+  const uint32_t* offsets; // where each account starts in input
+  uint64_t numParsed; // accounts parsed into params->ka by the entrypoint
+} InputReader;
+
+// Parses account i of the input
+void readAccount(const InputReader* reader, uint64_t i, SolAccountInfo* account) {
+  const uint8_t* p = &reader->input[reader->offsets[i]];
+  if(p[0] != NON_DUP_MARKER) {
+    // Duplicates always refer to an earlier account that is not one
+    p = &reader->input[reader->offsets[p[0]]];
+  }
+  account->is_signer = p[1] != 0;
+  account->is_writable = p[2] != 0;
+  account->executable = p[3] != 0;
+  p += 8;
+  account->key = (SolPubkey*)p;
+  p += sizeof(SolPubkey);
+  account->owner = (SolPubkey*)p;
+  p += sizeof(SolPubkey);
+  account->lamports = (uint64_t*)p;
+  p += sizeof(uint64_t);
+  account->data_len = *(uint64_t*)p;
+  p += sizeof(uint64_t);
+  account->data = (uint8_t*)p;
+  p += account->data_len + MAX_PERMITTED_DATA_INCREASE;
+  p = (const uint8_t*)(((uint64_t)p + 7) & ~7ULL);
+  account->rent_epoch = *(uint64_t*)p;
+}
+
+// Returns account i of the instruction. Accounts the entrypoint did not
+// parse are read into *buffer, so the result is only valid until the next
+// call with the same buffer. reader is NULL when params->ka holds every
+// account, as it does in tests.
+SolAccountInfo* instructionAccount(SolParameters* params, const InputReader* reader, uint64_t i,
+                                   SolAccountInfo* buffer) {
+  if(reader == NULL || i < reader->numParsed) {
+    return &params->ka[i];
+  }
+  readAccount(reader, i, buffer);
+  return buffer;
+}
+
+// Number of leading accounts the handler for a selector reads from
+// params->ka. Any further accounts must go through instructionAccount().
+uint64_t accountsUsed(uint8_t selector) {
+  switch(selector) {
+  case SET_USERNAME_SELECTOR:
+  case COMPACT_SELECTOR:
+  case MIGRATE_SELECTOR:
+  case CREATE_POOL_SELECTOR:
+    return 1;
+  case VOTE_SELECTOR:
+  case CREATE_PETITION_SELECTOR:
+  case CLAIM_REWARD_SELECTOR:
+    return 2;
+  case POST_SELECTOR:
+  case REPLY_SELECTOR:
+  case LIKE_SELECTOR:
+  case REPORT_SELECTOR:
+  case POST_SELECTOR | COUNTERS_FLAG:
+  case REPLY_SELECTOR | COUNTERS_FLAG:
+  case REPORT_SELECTOR | COUNTERS_FLAG:
+  case COMPRESSED_POST_SELECTOR:
+  case COMPRESSED_REPLY_SELECTOR:
+  case COMPRESSED_REPORT_SELECTOR:
+  case COMPRESSED_POST_SELECTOR | COUNTERS_FLAG:
+  case COMPRESSED_REPLY_SELECTOR | COUNTERS_FLAG:
+  case COMPRESSED_REPORT_SELECTOR | COUNTERS_FLAG:
+  case CREATE_SHARD_SELECTOR:
+  case OPEN_PAGE_SELECTOR:
+  // The petition, offender and page, voters are read as they are checked
+  case PROCESS_PETITION_SELECTOR:
+    return 3;
+  default:
+    // Batches may name any account
+    return UINT64_MAX;
+  }
+}
+
 // Helper functions 
 // ---------------------------------------------------------------------------- 
-// Returns the offset of the first byte not used for post data
-uint64_t newPostOffset(uint8_t* data, uint64_t length) {
+// Returns true if the user account predates the post index
+bool isLegacyUser(uint8_t* data) {
+  AccountMetadata* meta = (AccountMetadata*)data;
+  return meta->tailOffset == 0;
+}
+
+// Returns true if the user account has the version 2 layout
+bool isCurrentUser(uint8_t* data) {
+  AccountMetadata* meta = (AccountMetadata*)data;
+  return meta->version == USER_VERSION_2;
+}
+
+// Returns the number of posts in a user account of any version
+uint64_t postCount(uint8_t* data) {
+  AccountMetadata* meta = (AccountMetadata*)data;
+  return isCurrentUser(data) ? meta->numPosts : meta->numPostsV1;
+}
+
+// Returns the size of the PostIDs stored in a user account's records
+uint64_t recordIdSize(uint8_t* data) {
+  return isCurrentUser(data) ? sizeof(PostID) : sizeof(PostIDV1);
+}
+
+// Returns the number of continuation pages of a user account of any version
+uint64_t pageCount(uint8_t* data) {
+  AccountMetadata* meta = (AccountMetadata*)data;
+  return isCurrentUser(data) ? meta->numPages : 0;
+}
+
+// Returns the PostID index of the first post stored in a user account or
+// continuation page
+uint64_t firstPostIndex(uint8_t* data) {
+  if(data[0] == UserPage) {
+    return ((UserPageMeta*)data)->firstPost;
+  }
+  return 0;
+}
+
+// Converts a PostID index to the index of the post within a user account
+// or continuation page. Returns false if the post is not stored there.
+bool localPostIndex(uint8_t* data, uint64_t index, uint32_t* local) {
+  uint64_t first = firstPostIndex(data);
+  if(index < first || index - first >= postCount(data)) {
+    return false;
+  }
+  *local = index - first;
+  return true;
+}
+
+// Rounds an offset up to the next record boundary of a version 2 account
+uint64_t alignRecord(uint64_t offset) {
+  return (offset + RECORD_ALIGNMENT - 1) & ~(uint64_t)(RECORD_ALIGNMENT - 1);
+}
+
+// Returns the offset of the first byte not used for post data by walking
+// every record. Only needed for legacy accounts.
+uint64_t legacyPostOffset(uint8_t* data, uint64_t length) {
   // If empty account
   AccountMetadata* meta = (AccountMetadata*)data;
-  if(meta->numPosts == 0) {
-    return sizeof(AccountMetadata);
+  if(meta->numPostsV1 == 0) {
+    return USER_V1_HEADER_SIZE;
   }
   // Else find first space not used by posts
-  uint64_t offset = sizeof(AccountMetadata);
+  uint64_t offset = USER_V1_HEADER_SIZE;
   for(;;) {
     uint16_t advance = *((uint16_t*)&data[offset]);
     // If post length is 0, we've found uninitialized data
@@ -147,62 +740,187 @@ uint64_t newPostOffset(uint8_t* data, uint64_t length) {
   return offset;
 }
 
+// Returns the offset of the first byte not used for post data
+uint64_t newPostOffset(uint8_t* data, uint64_t length) {
+  if(isLegacyUser(data)) {
+    return legacyPostOffset(data, length);
+  }
+  AccountMetadata* meta = (AccountMetadata*)data;
+  return meta->tailOffset;
+}
+
+// Returns the index slot of the post with given index
+PostSlot* postSlot(uint8_t* data, uint64_t length, uint32_t index) {
+  return (PostSlot*)&data[length - ((uint64_t)index + 1) * sizeof(PostSlot)];
+}
+
+// Returns the offset one past the last byte available for post data
+uint64_t postDataEnd(uint8_t* data, uint64_t length) {
+  return length - postCount(data) * sizeof(PostSlot);
+}
+
+// Reads a PostID stored with the given width
+void readPostID(const uint8_t* d, uint64_t idSize, PostID* id) {
+  sol_memcpy(&id->poster, d, sizeof(SolPubkey));
+  if(idSize == sizeof(PostIDV1)) {
+    id->index = *((uint16_t*)&d[sizeof(SolPubkey)]);
+  }
+  else {
+    id->index = *((uint32_t*)&d[sizeof(SolPubkey)]);
+  }
+}
+
 /*
-Parse instruction data into a post struct
+Decodes a compressed post body of given length into out, which must hold
+the bodyLength it declares, or only validates it if out is NULL
+Returns the decoded length, or 0 if the body is malformed
+*/
+uint64_t decompressBody(const uint8_t* body, uint64_t length, uint8_t* out) {
+  if(length < sizeof(uint16_t)) {
+    return 0;
+  }
+  uint64_t declared = *((uint16_t*)body);
+  uint64_t decoded = 0;
+  uint64_t i = sizeof(uint16_t);
+  while(i < length) {
+    uint8_t token = body[i++];
+    const uint8_t* src;
+    uint64_t n;
+    if(token < LITERAL_TOKEN_LIMIT) {
+      n = token + 1;
+      if(n > length - i) {
+        return 0;
+      }
+      src = &body[i];
+      i += n;
+    }
+    else if(token < WORD_TOKEN_LIMIT) {
+      const BodyWord* word = &bodyDictionary[token - LITERAL_TOKEN_LIMIT];
+      n = word->length;
+      src = (const uint8_t*)word->text;
+    }
+    else {
+      if(length - i < sizeof(uint16_t)) {
+        return 0;
+      }
+      uint64_t distance = *((uint16_t*)&body[i]);
+      i += sizeof(uint16_t);
+      if(distance == 0 || distance > decoded) {
+        return 0;
+      }
+      n = token - WORD_TOKEN_LIMIT + MIN_BODY_MATCH;
+      src = out == NULL ? NULL : &out[decoded - distance];
+    }
+    if(n > declared - decoded) {
+      return 0;
+    }
+    if(out != NULL) {
+      // Byte by byte, since matches may overlap the bytes they produce
+      for(uint64_t j = 0; j < n; j++) {
+        out[decoded + j] = src[j];
+      }
+    }
+    decoded += n;
+  }
+  return decoded == declared ? decoded : 0;
+}
+
+/*
+Parse a post whose PostIDs are idSize bytes wide into a post struct
 Returns the number of bytes needed to store the post, or 0 if the 
 post is invalid
 */
-uint64_t parsePost(const uint8_t* d, uint64_t len, Post* p) {
+uint64_t parseRecord(const uint8_t* d, uint64_t len, uint64_t idSize, Post* p) {
   if(len < 2) {
     return 0; // Minimum size of a post is 2 bytes:
               // (selector + 1 character post)
   }
-  p->typeSelector = *d;
+  p->typeSelector = *d & ~(COUNTERS_FLAG | REDACTED_FLAG);
+  p->hasCounters = (*d & COUNTERS_FLAG) != 0;
+  p->compressed = false;
+  switch(p->typeSelector) {
+  case COMPRESSED_POST_SELECTOR:
+  case COMPRESSED_REPLY_SELECTOR:
+  case COMPRESSED_REPORT_SELECTOR:
+    p->typeSelector &= ~COMPRESSED_FLAG;
+    p->compressed = true;
+    break;
+  default:
+    break;
+  }
   p->length = len;
-  switch(*d) {
+  // Counted posts carry their counters between the selector and the rest
+  uint64_t header = 1;
+  if(p->hasCounters) {
+    if(p->typeSelector == LIKE_SELECTOR || len < 1 + sizeof(PostCounters) + 1) {
+      return 0; // Likes never carry counters
+    }
+    header += sizeof(PostCounters);
+  }
+  switch(p->typeSelector) {
   case POST_SELECTOR:
-    p->body.immutable = &d[1]; // Body is just the rest of the post data
-    p->bodyLength = len - 1;
-    return 1 + p->bodyLength + sizeof(uint16_t); // Selector + body + size
+    p->body.immutable = &d[header]; // Body is just the rest of the post data
+    p->bodyLength = len - header;
+    return header + p->bodyLength + sizeof(uint16_t); // Selector + body + size
   case REPLY_SELECTOR:
-    if(len < 1 + sizeof(PostID) + 1) {
-      return 0; // Minimum size of a reply is 36 bytes:
-                // (selector + (32 bytes pubkey + 2 bytes index) 
+    if(len < header + idSize + 1) {
+      return 0; // Minimum size of a reply is 38 bytes:
+                // (selector + (32 bytes pubkey + 4 bytes index) 
                 // + 1 character post)
     }
-    p->id = *((PostID*)&d[1]); // Assume data is already little-endian
-    p->body.immutable = &d[1 + sizeof(PostID)];
-    p->bodyLength = len - 1 - sizeof(PostID);
-    return sizeof(uint16_t) + 1 + sizeof(PostID) + p->bodyLength;
+    readPostID(&d[header], idSize, &p->id); // Assume data is already little-endian
+    p->body.immutable = &d[header + idSize];
+    p->bodyLength = len - header - idSize;
+    return sizeof(uint16_t) + header + idSize + p->bodyLength;
   case LIKE_SELECTOR:
-    if(len != 1 + sizeof(PostID)) {
-      return 0; // Size of a like is 35 bytes:
-                // (selector + (32 bytes pubkey + 2 bytes index))
+    if(len != 1 + idSize) {
+      return 0; // Size of a like is 37 bytes:
+                // (selector + (32 bytes pubkey + 4 bytes index))
     }
-    p->id = *((PostID*)&d[1]);
-    return sizeof(uint16_t) + 1 + sizeof(PostID);
+    readPostID(&d[1], idSize, &p->id);
+    p->bodyLength = 0;
+    return sizeof(uint16_t) + 1 + idSize;
   case REPORT_SELECTOR:
-    if(len < 1 + sizeof(PostID) + 1) {
-      return 0; // Minimum size of a report is 36 bytes:
-                // (selector + (32 bytes pubkey + 2 bytes index) 
+    if(len < header + idSize + 1) {
+      return 0; // Minimum size of a report is 38 bytes:
+                // (selector + (32 bytes pubkey + 4 bytes index) 
                 // + 1 character report reason)
     }
-    p->id = *((PostID*)&d[1]); // Assume data is already little-endian
-    p->body.immutable = &d[1 + sizeof(PostID)];
-    p->bodyLength = len - 1 - sizeof(PostID);
-    return sizeof(uint16_t) + 1 + sizeof(PostID) + p->bodyLength;
+    readPostID(&d[header], idSize, &p->id); // Assume data is already little-endian
+    p->body.immutable = &d[header + idSize];
+    p->bodyLength = len - header - idSize;
+    return sizeof(uint16_t) + header + idSize + p->bodyLength;
   default:
     return 0;
   }
   return 0;
 }
 
+/*
+Parse instruction data into a post struct
+Returns the number of bytes needed to store the post, or 0 if the 
+post is invalid
+*/
+uint64_t parsePost(const uint8_t* d, uint64_t len, Post* p) {
+  uint64_t size = parseRecord(d, len, sizeof(PostID), p);
+  if(size != 0 && p->compressed && decompressBody(p->body.immutable, p->bodyLength, NULL) == 0) {
+    return 0; // Compressed bodies must decode
+  }
+  return size;
+}
+
 // Copy the post represented by a post struct into account memory
 void copyPost(Post* p, uint8_t* account) {
   // Every type of post will copy a selector byte and size
   sol_memcpy(account, &p->length, sizeof(uint16_t));
-  account[2] = p->typeSelector;
+  account[2] = p->compressed ? p->typeSelector | COMPRESSED_FLAG : p->typeSelector;
   account += 3;
+  if(p->hasCounters) {
+    // Counters always start at zero, whatever the instruction held
+    account[-1] |= COUNTERS_FLAG;
+    sol_memset(account, 0, sizeof(PostCounters));
+    account += sizeof(PostCounters);
+  }
   switch(p->typeSelector) {
   case POST_SELECTOR:
     sol_memcpy(account, p->body.immutable, p->bodyLength);
@@ -228,12 +946,189 @@ bool isInitialized(uint8_t* data) {
 void initializeUserAccount(uint8_t* data, uint64_t length) {
   AccountMetadata* meta = (AccountMetadata*)data;
   meta->accountType = User;
+  meta->version = USER_VERSION_2;
+  meta->numPostsV1 = 0;
+  meta->numPosts = 0;
+  meta->numPages = 0;
+  meta->tailOffset = sizeof(AccountMetadata);
   meta->reputation = 5;
 }
 
-// Number of signatures that will fit in the account of given length
+// Number of signatures that will fit in a column layout petition account
+// of given length
 uint64_t signatureCapacity(uint64_t length) {
-  return (length - sizeof(PetitionAccountMeta)) / sizeof(PetitionSignature);
+  if(length < sizeof(PetitionAccountMeta)) {
+    return 0;
+  }
+  // Each signature costs its column bytes plus one vote bit. Rounding the
+  // bitset up to whole words can cost at most one signature.
+  uint64_t capacity = (length - sizeof(PetitionAccountMeta)) * 8 / (SIGNATURE_COLUMN_SIZE * 8 + 1);
+  while(capacity > 0 && PETITION_ACCOUNT_SIZE(capacity) > length) {
+    capacity--;
+  }
+  return capacity;
+}
+
+// Number of signatures that fit in an initialized petition account
+uint64_t petitionCapacity(uint8_t* data, uint64_t length) {
+  PetitionAccountMeta* meta = (PetitionAccountMeta*)data;
+  if(meta->hashSlots == 0) {
+    return (length - sizeof(PetitionAccountMeta)) / sizeof(PetitionSignature);
+  }
+  return meta->hashSlots / HASH_SLOTS_PER_SIGNATURE;
+}
+
+// Returns the vote bitset of a column layout petition
+uint64_t* petitionVoteBits(uint8_t* data) {
+  return (uint64_t*)&data[sizeof(PetitionAccountMeta)];
+}
+
+// Returns the voter hash table of a petition
+PetitionHashSlot* petitionHashTable(uint8_t* data) {
+  PetitionAccountMeta* meta = (PetitionAccountMeta*)data;
+  uint64_t offset = sizeof(PetitionAccountMeta);
+  if(meta->layout != PETITION_LAYOUT_RECORDS) {
+    offset += VOTE_WORDS(meta->hashSlots / HASH_SLOTS_PER_SIGNATURE) * sizeof(uint64_t);
+  }
+  return (PetitionHashSlot*)&data[offset];
+}
+
+// Returns the signature array of a record layout petition
+PetitionSignature* petitionSignatures(uint8_t* data) {
+  PetitionAccountMeta* meta = (PetitionAccountMeta*)data;
+  return (PetitionSignature*)&data[sizeof(PetitionAccountMeta) + meta->hashSlots * sizeof(PetitionHashSlot)];
+}
+
+// Returns the key of the petition's i-th signer
+SolPubkey* petitionSigner(uint8_t* data, uint64_t i) {
+  PetitionAccountMeta* meta = (PetitionAccountMeta*)data;
+  if(meta->layout != PETITION_LAYOUT_RECORDS) {
+    SolPubkey* signers = (SolPubkey*)&petitionHashTable(data)[meta->hashSlots];
+    return &signers[i];
+  }
+  return &petitionSignatures(data)[i].signer;
+}
+
+// Returns the petition's i-th vote
+bool petitionVote(uint8_t* data, uint64_t i) {
+  PetitionAccountMeta* meta = (PetitionAccountMeta*)data;
+  if(meta->layout != PETITION_LAYOUT_RECORDS) {
+    return (petitionVoteBits(data)[i / 64] >> (i % 64)) & 1;
+  }
+  return petitionSignatures(data)[i].vote != 0;
+}
+
+// Counts the set bits of a word
+uint64_t countBits(uint64_t x) {
+  x = x - ((x >> 1) & 0x5555555555555555ULL);
+  x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+  x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+  return (x * 0x0101010101010101ULL) >> 56;
+}
+
+// Returns votes for minus votes against
+int64_t petitionTally(uint8_t* data) {
+  PetitionAccountMeta* meta = (PetitionAccountMeta*)data;
+  int64_t votesFor = 0;
+  if(meta->layout != PETITION_LAYOUT_RECORDS) {
+    // Bits past numSignatures are never set
+    uint64_t* bits = petitionVoteBits(data);
+    for(uint64_t w = 0; w < VOTE_WORDS(meta->numSignatures); w++) {
+      votesFor += countBits(bits[w]);
+    }
+  }
+  else {
+    PetitionSignature* signatures = petitionSignatures(data);
+    for(uint64_t i = 0; i < meta->numSignatures; i++) {
+      votesFor += signatures[i].vote != 0;
+    }
+  }
+  return 2 * votesFor - meta->numSignatures;
+}
+
+// Returns true if the petition uses the PetitionAccountMetaV1 header
+bool isPetitionV1(uint8_t* data) {
+  PetitionAccountMeta* meta = (PetitionAccountMeta*)data;
+  return meta->layout < PETITION_LAYOUT_V2;
+}
+
+// Returns the state of a petition of any layout
+uint8_t* petitionState(uint8_t* data) {
+  if(isPetitionV1(data)) {
+    return &((PetitionAccountMetaV1*)data)->completed;
+  }
+  return &((PetitionAccountMeta*)data)->completed;
+}
+
+// Returns the post a petition of any layout is against
+PostID petitionOffendingPost(uint8_t* data) {
+  if(isPetitionV1(data)) {
+    PetitionAccountMetaV1* meta = (PetitionAccountMetaV1*)data;
+    PostID id = { .poster = meta->offendingPost.poster, .index = meta->offendingPost.index };
+    return id;
+  }
+  return ((PetitionAccountMeta*)data)->offendingPost;
+}
+
+/*
+Petitions keep netTally current as votes are cast, so the outcome can be
+read from the header alone. Version 1 petitions created before the
+counters existed have netTally and votesFor at 0 despite holding votes,
+which breaks the invariant checked here.
+*/
+bool isTallyCurrent(uint8_t* data) {
+  if(!isPetitionV1(data)) {
+    return true;
+  }
+  PetitionAccountMetaV1* meta = (PetitionAccountMetaV1*)data;
+  return meta->netTally == 2 * (int64_t)meta->votesFor - meta->numSignatures;
+}
+
+// Recounts the tally of a petition created before the counters existed
+void ensureTallyCurrent(uint8_t* data) {
+  if(!isTallyCurrent(data)) {
+    PetitionAccountMetaV1* meta = (PetitionAccountMetaV1*)data;
+    meta->netTally = petitionTally(data);
+    meta->votesFor = (meta->netTally + meta->numSignatures) / 2;
+  }
+}
+
+// Returns the hash table slot holding the given voter, or the empty slot
+// where they would be inserted. The petition must not be legacy.
+PetitionHashSlot* findVoterSlot(uint8_t* data, const SolPubkey* voter) {
+  PetitionAccountMeta* meta = (PetitionAccountMeta*)data;
+  PetitionHashSlot* table = petitionHashTable(data);
+  // Keys are ed25519 points, so any 8 of their bytes are well mixed
+  uint64_t slot = *((uint64_t*)voter->x) % meta->hashSlots;
+  while(table[slot] != 0 && !SolPubkey_same(petitionSigner(data, table[slot] - 1), voter)) {
+    slot++;
+    if(slot == meta->hashSlots) {
+      slot = 0;
+    }
+  }
+  return &table[slot];
+}
+
+// Appends a signature to a petition with room for it
+void appendSignature(uint8_t* data, const SolPubkey* signer, bool vote) {
+  PetitionAccountMeta* meta = (PetitionAccountMeta*)data;
+  uint64_t i = meta->numSignatures;
+  if(meta->layout != PETITION_LAYOUT_RECORDS) {
+    uint64_t* word = &petitionVoteBits(data)[i / 64];
+    *word = (*word & ~(1ULL << (i % 64))) | ((uint64_t)vote << (i % 64));
+  }
+  else {
+    petitionSignatures(data)[i].vote = vote;
+  }
+  sol_memcpy(petitionSigner(data, i), signer, sizeof(SolPubkey));
+  meta->numSignatures++;
+  meta->netTally += vote ? 1 : -1;
+  if(isPetitionV1(data)) {
+    ((PetitionAccountMetaV1*)data)->votesFor += vote;
+  }
+  if(meta->hashSlots != 0) {
+    *findVoterSlot(data, signer) = meta->numSignatures;
+  }
 }
 
 // Returns the minimum reputation needed to vote on a petition against
@@ -246,12 +1141,19 @@ void initializePetitionAccount(uint8_t* data, uint64_t length, PostID* offender,
                                uint8_t* offenderData, uint64_t offenderDataLength) {
   PetitionAccountMeta* account = (PetitionAccountMeta*)data;
   account->accountType = Petition;
+  account->layout = PETITION_LAYOUT_V2;
+  account->reserved = 0;
   account->offendingPost = *offender;
   account->numSignatures = 0;
+  account->netTally = 0;
+  account->hashSlots = signatureCapacity(length) * HASH_SLOTS_PER_SIGNATURE;
+  // Clear the vote bitset and hash table
+  sol_memset(&data[sizeof(PetitionAccountMeta)], 0,
+             VOTE_WORDS(signatureCapacity(length)) * sizeof(uint64_t) + account->hashSlots * sizeof(PetitionHashSlot));
   // set reputation requirement so that a majority vote will always win
   AccountMetadata* offenderMeta = (AccountMetadata*)offenderData;
   account->reputationRequirement = votingRequirement(offenderMeta->reputation, signatureCapacity(length));
-  account->completed = 0;
+  account->completed = PETITION_OPEN;
 }
 
 // Returns true if the given user can vote on the given petition
@@ -259,8 +1161,8 @@ bool meetsVotingRequirements(SolAccountInfo* user, SolAccountInfo* petition) {
   AccountMetadata* userMeta = (AccountMetadata*)user->data;
   PetitionAccountMeta* petitionMeta = (PetitionAccountMeta*)petition->data;
   if(!(userMeta->reputation >= petitionMeta->reputationRequirement)) {
-    sol_log("(Reputation you have, reputation needed, 0, 0, 0)");
-    sol_log_64(userMeta->reputation, petitionMeta->reputationRequirement, 0, 0, 0);
+    LOG_INFO("(Reputation you have, reputation needed, 0, 0, 0)");
+    LOG_INFO_64(userMeta->reputation, petitionMeta->reputationRequirement, 0, 0, 0);
     return false;
   }
   return true;
@@ -269,161 +1171,642 @@ bool meetsVotingRequirements(SolAccountInfo* user, SolAccountInfo* petition) {
 // Returns true if the given user has already voted on the given petition
 bool hasVoted(SolAccountInfo* user, SolAccountInfo* petition) {
   PetitionAccountMeta* petitionMeta = (PetitionAccountMeta*)petition->data;
-  PetitionSignature* signatures = (PetitionSignature*)(&petition->data[sizeof(PetitionAccountMeta)]);
+  if(petitionMeta->hashSlots != 0) {
+    return *findVoterSlot(petition->data, user->key) != 0;
+  }
+  // Legacy petitions have no hash table
   for(uint64_t i = 0; i < petitionMeta->numSignatures; i++) {
-    if(SolPubkey_same(&signatures[i].signer, user->key)) {
+    if(SolPubkey_same(petitionSigner(petition->data, i), user->key)) {
       return true;
     }
   }
   return false;
 }
 
-// Gets the byte offset of post with given index
-uint64_t postOffset(uint8_t* data, uint16_t index) {
-  AccountMetadata* meta = (AccountMetadata*)data;
-  uint64_t offset = sizeof(AccountMetadata);
-  for(uint16_t i = 0; i < index; i++) {
-    uint16_t advance = *((uint16_t*)&data[offset]);
-    offset += advance + sizeof(uint16_t);
+// Applies the reward or penalty for one signature of a completed petition
+void applyPetitionReward(AccountMetadata* voterMeta, PetitionAccountMeta* petitionMeta, bool vote) {
+  bool petitionOutcome = petitionMeta->netTally > 0;
+  if(vote == petitionOutcome) {
+    voterMeta->reputation += petitionMeta->reputationRequirement;
   }
-  return offset;
-}
-
-// Replaces the body of a post with ASCII 'x'
-// Will break if the post given doesn't have a body
-void redactPost(SolAccountInfo* offender, uint16_t index) {
-  uint64_t redactedPostOffset = postOffset(offender->data, index);
-  uint16_t redactedPostLength = *(uint16_t*)(&offender->data[redactedPostOffset]);
-  Post redactedPost;
-  if(parsePost(&offender->data[redactedPostOffset + sizeof(uint16_t)], redactedPostLength, &redactedPost) == 0)
-  {
-    sol_log("Failed to parse post from account data, skipping redaction");
-    return;
+  else if(voterMeta->reputation > petitionMeta->reputationRequirement) {
+    voterMeta->reputation -= petitionMeta->reputationRequirement;
   }
-  // Redact the post
-  for(uint16_t i = 0; i < redactedPost.bodyLength; i++) {
-    redactedPost.body.mutable[i] = 'x';
+  else {
+    voterMeta->reputation = 0;
   }
 }
 
-// Processes the outcome of a vote
-// A tie is broken by the petition failing
-// The first account must be the petition account
-// The second account must be the offender's account
-// The rest of the accounts must be the accounts in the petition in the order they appear
-uint64_t processPetitionOutcome(SolParameters* params) {
-  if(params->ka_num < 3) {
-    sol_log("Must provide at least 3 accounts to process a petition, got:");
-    sol_log_64(params->ka_num, 0, 0, 0, 0);
-    return ERROR_NOT_ENOUGH_ACCOUNT_KEYS;
-  }
+// Returns slot i of a petition pool
+PetitionPoolSlot* poolSlot(uint8_t* data, uint64_t i) {
+  PetitionPoolMeta* pool = (PetitionPoolMeta*)data;
+  return (PetitionPoolSlot*)&data[sizeof(PetitionPoolMeta) + i * pool->slotSize];
+}
 
-  // No instruction data is required (aside from the selector)
-  if(params->data_len != 1) {
-    sol_log("No instruction data is necessary for this instruction");
+// Points *petition at the petition in a pool slot
+void slotPetition(SolAccountInfo* poolAccount, PetitionPoolSlot* slot, SolAccountInfo* petition) {
+  *petition = *poolAccount;
+  petition->data = (uint8_t*)&slot[1];
+  petition->data_len = ((PetitionPoolMeta*)poolAccount->data)->slotSize - sizeof(PetitionPoolSlot);
+}
+
+/*
+Resolves the petition an instruction is about. For a petition account,
+refLength must be 0 and *petition is the account itself. For a petition
+pool, ref holds the slot and generation (PETITION_REF_SIZE bytes) and
+*petition is a view of that slot's petition. *slot is the pool slot, or
+NULL for petition accounts.
+*/
+uint64_t resolvePetition(SolAccountInfo* account, const uint8_t* ref, uint64_t refLength,
+                         SolAccountInfo* petition, PetitionPoolSlot** slot) {
+  *slot = NULL;
+  if(account->data_len == 0 || account->data[0] != PetitionPool) {
+    if(refLength != 0) {
+      LOG_ERROR(329, "Only petition pools take a slot and generation");
+      return ERROR_INVALID_INSTRUCTION_DATA;
+    }
+    *petition = *account;
+    return SUCCESS;
+  }
+  if(refLength != PETITION_REF_SIZE) {
+    LOG_ERROR(330, "Petition pools need a slot and generation");
     return ERROR_INVALID_INSTRUCTION_DATA;
   }
 
-  SolAccountInfo* petitionAccount = &params->ka[0];
-  SolAccountInfo* offenderAccount = &params->ka[1];
-  SolAccountInfo* voterAccounts = &params->ka[2];
-
-  if(!isInitialized(petitionAccount->data)) {
-    sol_log("This petition is not initialized");
-    return ERROR_UNINITIALIZED_ACCOUNT;
+  PetitionPoolMeta* pool = (PetitionPoolMeta*)account->data;
+  uint16_t index = *(uint16_t*)ref;
+  uint32_t generation = *(uint32_t*)&ref[sizeof(uint16_t)];
+  PetitionPoolSlot* found = index < pool->firstUnused ? poolSlot(account->data, index) : NULL;
+  // Released slots keep their generation until they are handed out again
+  if(found == NULL || found->generation != generation || ((uint8_t*)&found[1])[0] != Petition) {
+    LOG_ERROR_64(331, "The pool slot does not hold that petition (slot, generation):", index, generation);
+    return ERROR_INVALID_ARGUMENT;
   }
+  *slot = found;
+  slotPetition(account, found, petition);
+  return SUCCESS;
+}
 
-  // Check if the petition is already completed
-  PetitionAccountMeta* petition = (PetitionAccountMeta*)(petitionAccount->data);
-  if(petition->completed) {
-    sol_log("Petition is already completed.");
-    return ERROR_INVALID_ACCOUNT_DATA;
+// Takes a slot of a pool for a new petition, and points *petition at it
+uint64_t allocatePetitionSlot(SolAccountInfo* poolAccount, SolAccountInfo* petition) {
+  PetitionPoolMeta* pool = (PetitionPoolMeta*)poolAccount->data;
+  uint64_t index;
+  PetitionPoolSlot* slot;
+  if(pool->freeHead != 0) {
+    index = pool->freeHead - 1;
+    slot = poolSlot(poolAccount->data, index);
+    pool->freeHead = slot->nextFree;
   }
-  
-  if(petition->numSignatures != signatureCapacity(petitionAccount->data_len)) {
-    sol_log("Petition is not full yet.");
-    sol_log_64(petition->numSignatures, signatureCapacity(petitionAccount->data_len), 0, 0, 0);
+  else if(pool->firstUnused < pool->numSlots) {
+    index = pool->firstUnused++;
+    slot = poolSlot(poolAccount->data, index);
+  }
+  else {
+    LOG_ERROR_64(332, "Every slot of the petition pool is in use:", pool->numSlots, 0);
     return ERROR_INVALID_ACCOUNT_DATA;
   }
+  slot->generation++;
+  slot->nextFree = 0;
+  slot->unclaimed = 0;
+  pool->openPetitions++;
+  LOG_INFO("Petition pool slot, generation:");
+  LOG_INFO_64(index, slot->generation, 0, 0, 0);
+  slotPetition(poolAccount, slot, petition);
+  return SUCCESS;
+}
+
+// Puts a pool slot whose petition is done with back on the free list
+void releasePetitionSlot(SolAccountInfo* poolAccount, PetitionPoolSlot* slot) {
+  PetitionPoolMeta* pool = (PetitionPoolMeta*)poolAccount->data;
+  uint64_t index = ((uint8_t*)slot - &poolAccount->data[sizeof(PetitionPoolMeta)]) / pool->slotSize;
+  ((uint8_t*)&slot[1])[0] = 0;
+  slot->nextFree = pool->freeHead;
+  pool->freeHead = index + 1;
+  pool->openPetitions--;
+}
+
+// Gets the byte offset of post with given index, or 0 if compaction
+// dropped it
+uint64_t postOffset(uint8_t* data, uint64_t length, uint32_t index) {
+  // Version 1 records are not aligned, so their offsets keep every bit
+  if(isCurrentUser(data)) {
+    return *postSlot(data, length, index) & ~STAMPED_RECORD;
+  }
+  if(!isLegacyUser(data)) {
+    return *postSlot(data, length, index);
+  }
+  uint64_t offset = USER_V1_HEADER_SIZE;
+  for(uint32_t i = 0; i < index; i++) {
+    uint16_t advance = *((uint16_t*)&data[offset]);
+    offset += advance + sizeof(uint16_t);
+  }
+  return offset;
+}
+
+// Gets the Clock slot of the post with given index, or 0 if it has no stamp
+uint64_t postStamp(uint8_t* data, uint64_t length, uint32_t index) {
+  if(!isCurrentUser(data) || !(*postSlot(data, length, index) & STAMPED_RECORD)) {
+    return 0;
+  }
+  return *(SlotStamp*)&data[postOffset(data, length, index) - sizeof(SlotStamp)];
+}
+
+// Returns the counters of the post with given PostID index, or NULL if the
+// post is not in this account or page or was created without them
+PostCounters* postCounters(uint8_t* data, uint64_t length, uint32_t index) {
+  uint32_t local;
+  if(!localPostIndex(data, index, &local)) {
+    return NULL;
+  }
+  uint64_t offset = postOffset(data, length, local);
+  if(offset == 0 || !(data[offset + sizeof(uint16_t)] & COUNTERS_FLAG)) {
+    return NULL;
+  }
+  return (PostCounters*)&data[offset + sizeof(uint16_t) + 1];
+}
+
+bool samePost(const PostID* a, const PostID* b) {
+  return a->index == b->index && SolPubkey_same(&a->poster, &b->poster);
+}
+
+#ifndef __bpf__
+// Tests and native tools have no sha256 syscall, so they hash with this
+// plain SHA-256 instead
+static const uint32_t sha256RoundConstants[64] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+#define ROTATE_RIGHT(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+void sha256Block(uint32_t* state, const uint8_t* block) {
+  uint32_t w[64];
+  for(int i = 0; i < 16; i++) {
+    w[i] = (uint32_t)block[4 * i] << 24 | (uint32_t)block[4 * i + 1] << 16 |
+           (uint32_t)block[4 * i + 2] << 8 | block[4 * i + 3];
+  }
+  for(int i = 16; i < 64; i++) {
+    uint32_t s0 = ROTATE_RIGHT(w[i - 15], 7) ^ ROTATE_RIGHT(w[i - 15], 18) ^ (w[i - 15] >> 3);
+    uint32_t s1 = ROTATE_RIGHT(w[i - 2], 17) ^ ROTATE_RIGHT(w[i - 2], 19) ^ (w[i - 2] >> 10);
+    w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+  }
+  uint32_t v[8];
+  for(int i = 0; i < 8; i++) {
+    v[i] = state[i];
+  }
+  for(int i = 0; i < 64; i++) {
+    uint32_t s1 = ROTATE_RIGHT(v[4], 6) ^ ROTATE_RIGHT(v[4], 11) ^ ROTATE_RIGHT(v[4], 25);
+    uint32_t choice = (v[4] & v[5]) ^ (~v[4] & v[6]);
+    uint32_t t1 = v[7] + s1 + choice + sha256RoundConstants[i] + w[i];
+    uint32_t s0 = ROTATE_RIGHT(v[0], 2) ^ ROTATE_RIGHT(v[0], 13) ^ ROTATE_RIGHT(v[0], 22);
+    uint32_t majority = (v[0] & v[1]) ^ (v[0] & v[2]) ^ (v[1] & v[2]);
+    for(int j = 7; j > 0; j--) {
+      v[j] = v[j - 1];
+    }
+    v[4] += t1;
+    v[0] = t1 + s0 + majority;
+  }
+  for(int i = 0; i < 8; i++) {
+    state[i] += v[i];
+  }
+}
+
+uint64_t sol_sha256(const SolBytes* bytes, int bytes_len, const uint8_t* result) {
+  uint32_t state[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+  };
+  uint8_t block[64];
+  uint64_t filled = 0;
+  uint64_t total = 0;
+  for(int i = 0; i < bytes_len; i++) {
+    for(uint64_t j = 0; j < bytes[i].len; j++) {
+      block[filled++] = bytes[i].addr[j];
+      if(filled == sizeof(block)) {
+        sha256Block(state, block);
+        filled = 0;
+      }
+    }
+    total += bytes[i].len;
+  }
+  // Pad with a one bit, zeros and the message length in bits
+  block[filled++] = 0x80;
+  if(filled > sizeof(block) - sizeof(uint64_t)) {
+    while(filled < sizeof(block)) {
+      block[filled++] = 0;
+    }
+    sha256Block(state, block);
+    filled = 0;
+  }
+  while(filled < sizeof(block) - sizeof(uint64_t)) {
+    block[filled++] = 0;
+  }
+  for(int i = 7; i >= 0; i--) {
+    block[filled++] = (uint8_t)((total * 8) >> (8 * i));
+  }
+  sha256Block(state, block);
+  uint8_t* out = (uint8_t*)result;
+  for(int i = 0; i < 8; i++) {
+    out[4 * i] = state[i] >> 24;
+    out[4 * i + 1] = state[i] >> 16;
+    out[4 * i + 2] = state[i] >> 8;
+    out[4 * i + 3] = state[i];
+  }
+  return SUCCESS;
+}
+#endif
+
+// Writes value in decimal at out, returning the number of digits
+uint64_t writeDecimal(uint8_t* out, uint64_t value) {
+  uint8_t digits[20];
+  uint64_t length = 0;
+  do {
+    digits[length++] = '0' + value % 10;
+    value /= 10;
+  } while(value > 0);
+  for(uint64_t i = 0; i < length; i++) {
+    out[i] = digits[length - 1 - i];
+  }
+  return length;
+}
+
+// Gets the address clients derive with PublicKey.createWithSeed(base, seed,
+// programId), the SHA-256 of the three
+void seedAddress(const SolPubkey* base, const uint8_t* seed, uint64_t seedLength,
+                 const SolPubkey* programId, SolPubkey* address) {
+  SolBytes bytes[] = {
+    {base->x, SIZE_PUBKEY},
+    {seed, seedLength},
+    {programId->x, SIZE_PUBKEY},
+  };
+  sol_sha256(bytes, SOL_ARRAY_SIZE(bytes), address->x);
+}
+
+// Gets the address of the poster's continuation page with given number,
+// from the seed "page:<page>"
+void pageAddress(const SolPubkey* poster, uint32_t page, const SolPubkey* programId, SolPubkey* address) {
+  uint8_t seed[MAX_SEED_LENGTH];
+  sol_memcpy(seed, PAGE_SEED_PREFIX, sizeof(PAGE_SEED_PREFIX) - 1);
+  uint64_t length = sizeof(PAGE_SEED_PREFIX) - 1;
+  length += writeDecimal(&seed[length], page);
+  seedAddress(poster, seed, length, programId, address);
+}
+
+// Gets the address of shard number shard of the poster's post with given
+// index, from the seed "shard:<index>:<shard>"
+void shardAddress(const SolPubkey* poster, uint32_t index, uint8_t shard, const SolPubkey* programId,
+                  SolPubkey* address) {
+  uint8_t seed[MAX_SEED_LENGTH];
+  sol_memcpy(seed, SHARD_SEED_PREFIX, sizeof(SHARD_SEED_PREFIX) - 1);
+  uint64_t length = sizeof(SHARD_SEED_PREFIX) - 1;
+  length += writeDecimal(&seed[length], index);
+  seed[length++] = ':';
+  length += writeDecimal(&seed[length], shard);
+  seedAddress(poster, seed, length, programId, address);
+}
+
+// Returns true if the account is an initialized counter shard of the post
+bool isShardOf(SolAccountInfo* account, const PostID* post) {
+  if(account->data_len < sizeof(CounterShardMeta) || account->data[0] != CounterShard) {
+    return false;
+  }
+  CounterShardMeta* shard = (CounterShardMeta*)account->data;
+  return samePost(&shard->post, post);
+}
+
+// Returns true if the account is a continuation page of the poster
+bool isPageOf(SolAccountInfo* account, const SolPubkey* poster) {
+  if(account->data_len < sizeof(UserPageMeta) || account->data[0] != UserPage) {
+    return false;
+  }
+  return SolPubkey_same(&((UserPageMeta*)account->data)->owner, poster);
+}
+
+// Returns the shard a signer should use out of shardCount, using the same
+// key bytes as the petition voter hash
+uint64_t counterShard(const SolPubkey* signer, uint64_t shardCount) {
+  return *((uint64_t*)signer->x) % shardCount;
+}
+
+// Adds the counters of every shard of the given post to total. Accounts
+// that are not shards of that post are skipped, so the caller does not
+// have to filter them first.
+void sumCounterShards(SolAccountInfo* accounts, uint64_t numAccounts, const PostID* post,
+                      PostCounters* total) {
+  for(uint64_t i = 0; i < numAccounts; i++) {
+    if(isShardOf(&accounts[i], post)) {
+      PostCounters* counters = &((CounterShardMeta*)accounts[i].data)->counters;
+      total->likes += counters->likes;
+      total->replies += counters->replies;
+      total->reports += counters->reports;
+    }
+  }
+}
+
+// Replaces the body of the post with given PostID index with ASCII 'x' and
+// flags it as redacted so compaction can shrink it. The offender account
+// is the user account or page holding the post.
+void redactPost(SolAccountInfo* offender, uint32_t index) {
+  uint32_t local;
+  if(!localPostIndex(offender->data, index, &local)) {
+    LOG_INFO("Offending post does not exist, skipping redaction");
+    return;
+  }
+  uint64_t redactedPostOffset = postOffset(offender->data, offender->data_len, local);
+  if(redactedPostOffset == 0) {
+    LOG_INFO("Offending post was compacted away, skipping redaction");
+    return;
+  }
+  uint16_t redactedPostLength = *(uint16_t*)(&offender->data[redactedPostOffset]);
+  Post redactedPost;
+  if(parseRecord(&offender->data[redactedPostOffset + sizeof(uint16_t)], redactedPostLength,
+                 recordIdSize(offender->data), &redactedPost) == 0)
+  {
+    LOG_INFO("Failed to parse post from account data, skipping redaction");
+    return;
+  }
+  // Redact the post
+  for(uint16_t i = 0; i < redactedPost.bodyLength; i++) {
+    redactedPost.body.mutable[i] = REDACTION_BYTE;
+  }
+  // The redacted bytes are not a compressed body anymore
+  uint8_t* selector = &offender->data[redactedPostOffset + sizeof(uint16_t)];
+  *selector = (*selector | REDACTED_FLAG) & ~COMPRESSED_FLAG;
+}
+
+// Copies len bytes to a lower or equal address. The ranges may overlap.
+void moveDown(uint8_t* dst, const uint8_t* src, uint64_t len) {
+  if(dst == src) {
+    return;
+  }
+  for(uint64_t i = 0; i < len; i++) {
+    dst[i] = src[i];
+  }
+}
+
+// Copies len bytes to a higher or equal address. The ranges may overlap.
+void moveUp(uint8_t* dst, const uint8_t* src, uint64_t len) {
+  if(dst == src) {
+    return;
+  }
+  while(len > 0) {
+    len--;
+    dst[len] = src[len];
+  }
+}
+
+// Returns the offset one past the last live record before the given post
+uint64_t liveDataEnd(uint8_t* data, uint64_t length, uint32_t index) {
+  while(index > 0) {
+    index--;
+    uint64_t offset = *postSlot(data, length, index) & ~STAMPED_RECORD;
+    if(offset != 0) {
+      return alignRecord(offset + sizeof(uint16_t) + *((uint16_t*)&data[offset]));
+    }
+  }
+  return sizeof(AccountMetadata);
+}
+
+// Reads the vote of each voter account, which may be given in any order,
+// into a bitmap indexed by account. The bitmap comes from scratch, along
+// with one of the slots already matched so a voter can't be given twice.
+// Both take a bit per signature, so even MAX_PETITION_SIZE fits the heap.
+uint64_t readPetitionVoters(SolParameters* params, const InputReader* reader, uint8_t* data,
+                            uint64_t firstVoter, Arena* scratch, uint64_t** voterVotes) {
+  PetitionAccountMeta* meta = (PetitionAccountMeta*)data;
+  uint64_t* votes = arenaAlloc(scratch, VOTE_WORDS(meta->numSignatures) * sizeof(uint64_t));
+  uint64_t* matched = arenaAlloc(scratch, VOTE_WORDS(meta->numSignatures) * sizeof(uint64_t));
+  if(votes == NULL || matched == NULL) {
+    LOG_ERROR_64(339, "Not enough heap to settle a petition with this many voters:", meta->numSignatures, 0);
+    return ERROR_ACCOUNT_DATA_TOO_SMALL;
+  }
+  sol_memset(votes, 0, VOTE_WORDS(meta->numSignatures) * sizeof(uint64_t));
+  sol_memset(matched, 0, VOTE_WORDS(meta->numSignatures) * sizeof(uint64_t));
+
+  SolAccountInfo voterBuffer;
+  for(uint64_t i = 0; i < meta->numSignatures; i++) {
+    SolAccountInfo* voterAccount = instructionAccount(params, reader, firstVoter + i, &voterBuffer);
+    // Voters are usually given in petition order, so try that slot first
+    uint64_t slot = i;
+    if(!SolPubkey_same(petitionSigner(data, slot), voterAccount->key)) {
+      if(meta->hashSlots != 0) {
+        slot = *findVoterSlot(data, voterAccount->key) - 1;
+      }
+      else {
+        for(slot = 0; slot < meta->numSignatures && !SolPubkey_same(petitionSigner(data, slot), voterAccount->key); slot++);
+      }
+    }
+    if(slot >= meta->numSignatures || (matched[slot / 64] & (1ULL << (slot % 64)))) {
+      LOG_ERROR_64(308, "Voter account parameter is not an unmatched voter of this petition:", i, 0);
+      LOG_INFO_PUBKEY(voterAccount->key);
+      return ERROR_INVALID_ARGUMENT;
+    }
+    matched[slot / 64] |= 1ULL << (slot % 64);
+    votes[i / 64] |= (uint64_t)petitionVote(data, slot) << (i % 64);
+  }
+  *voterVotes = votes;
+  return SUCCESS;
+}
+
+// Processes the outcome of a vote
+// A tie is broken by the petition failing
+// The first account must be the petition account or petition pool, and
+// pooled petitions are named by the slot and generation following the
+// selector
+// The second account must be the offender's account
+// If the offending post is in one of the offender's continuation pages,
+// that page must follow, and the accounts below start one later
+// If only those accounts are given, the petition is finalized and each
+// voter claims their own reward afterwards. Otherwise the rest of the
+// accounts must be the accounts in the petition, in any order, and they
+// are all rewarded or penalized here. Voter accounts are read through the
+// input reader, so their number is not limited by params->ka.
+uint64_t processPetitionOutcome(SolParameters* params, const InputReader* reader, Arena* scratch) {
+  if(params->ka_num < 2) {
+    LOG_ERROR_64(301, "Must provide at least 2 accounts to process a petition, got:", params->ka_num, 0);
+    return ERROR_NOT_ENOUGH_ACCOUNT_KEYS;
+  }
+
+  // No instruction data is required aside from the selector and pool slot
+  if(params->data_len != 1 && params->data_len != 1 + PETITION_REF_SIZE) {
+    LOG_ERROR(302, "Only a pool slot may follow the selector of this instruction");
+    return ERROR_INVALID_INSTRUCTION_DATA;
+  }
+
+  SolAccountInfo petition;
+  PetitionPoolSlot* slot;
+  uint64_t result = resolvePetition(&params->ka[0], &params->data[1], params->data_len - 1, &petition, &slot);
+  if(result != SUCCESS) {
+    return result;
+  }
+  SolAccountInfo* petitionAccount = &petition;
+  SolAccountInfo* offenderAccount = &params->ka[1];
 
-  int64_t voteTally = 0;
+  if(!isInitialized(petitionAccount->data)) {
+    LOG_ERROR(303, "This petition is not initialized");
+    return ERROR_UNINITIALIZED_ACCOUNT;
+  }
+
+  // Check if the petition is already completed
   PetitionAccountMeta* petitionMeta = (PetitionAccountMeta*)petitionAccount->data;
-  PetitionSignature* signatureArray = (PetitionSignature*)&petitionAccount->data[sizeof(PetitionAccountMeta)];
+  if(*petitionState(petitionAccount->data) != PETITION_OPEN) {
+    LOG_ERROR(304, "Petition is already completed.");
+    return ERROR_INVALID_ACCOUNT_DATA;
+  }
+  
+  if(petitionMeta->numSignatures != petitionCapacity(petitionAccount->data, petitionAccount->data_len)) {
+    LOG_ERROR_64(305, "Petition is not full yet.", petitionMeta->numSignatures, petitionCapacity(petitionAccount->data, petitionAccount->data_len));
+    return ERROR_INVALID_ACCOUNT_DATA;
+  }
+
+  PostID offendingPost = petitionOffendingPost(petitionAccount->data);
   // Before modifying anything, reject the transaction if any of the account parameters are incorrect
-  if(!SolPubkey_same(&petitionMeta->offendingPost.poster, offenderAccount->key)) {
-    sol_log("Second account parameter must be the offender's account");
+  if(!SolPubkey_same(&offendingPost.poster, offenderAccount->key)) {
+    LOG_ERROR(306, "Second account parameter must be the offender's account");
     return ERROR_INVALID_ARGUMENT;
   }
-  if(params->ka_num - 2 != petitionMeta->numSignatures) {
-    sol_log("Invalid number of account parameters");
-    sol_log("Expected:");
-    sol_log_64(petitionMeta->numSignatures, 0, 0, 0, 0);
-    sol_log("Got:");
-    sol_log_64(params->ka_num - 2, 0, 0, 0, 0);
+  // The user account is frozen once it has pages, so any later post is in one
+  SolAccountInfo* postAccount = offenderAccount;
+  uint64_t firstVoter = 2;
+  if(pageCount(offenderAccount->data) > 0 && offendingPost.index >= postCount(offenderAccount->data)) {
+    uint32_t local;
+    postAccount = &params->ka[2];
+    firstVoter = 3;
+    if(params->ka_num < 3 || !SolPubkey_same(postAccount->owner, params->program_id) ||
+       !isPageOf(postAccount, offenderAccount->key) ||
+       !localPostIndex(postAccount->data, offendingPost.index, &local)) {
+      LOG_ERROR(328, "Third account parameter must be the offender's page holding the post");
+      return ERROR_INVALID_ARGUMENT;
+    }
+  }
+  SolAccountInfo voterBuffer;
+  bool finalizeOnly = params->ka_num == firstVoter;
+  if(!finalizeOnly && params->ka_num - firstVoter != petitionMeta->numSignatures) {
+    LOG_ERROR_64(307, "Invalid number of voter accounts (expected, got):",
+                 petitionMeta->numSignatures, params->ka_num - firstVoter);
     return ERROR_INVALID_ARGUMENT;
   }
-  for(uint64_t i = 0; i < petitionMeta->numSignatures; i++) {
-    // Check to ensure that the correct accounts were passed in
-    // in the correct order
-    if(!SolPubkey_same(&signatureArray[i].signer, voterAccounts[i].key)) {
-      sol_log("Invalid account parameter for petition slot:");
-      sol_log_64(i, 0, 0, 0, 0);
-      sol_log("Expected:");
-      sol_log_pubkey(&signatureArray[i].signer);
-      sol_log("Got:");
-      sol_log_pubkey(voterAccounts[i].key);
-      return ERROR_INVALID_ARGUMENT;
+  uint64_t* voterVotes = NULL;
+  if(!finalizeOnly) {
+    result = readPetitionVoters(params, reader, petitionAccount->data, firstVoter, scratch, &voterVotes);
+    if(result != SUCCESS) {
+      return result;
     }
   }
 
   // We may complete the petition.
-  petitionMeta->completed = true;
+  *petitionState(petitionAccount->data) = finalizeOnly ? PETITION_FINALIZED : PETITION_SETTLED;
 
-  for(uint64_t i = 0; i < petitionMeta->numSignatures; i++) {
-    if(signatureArray[i].vote) {
-      voteTally++;
-      //sol_log("Counted 1 vote for:");
-    }
-    else {
-      //sol_log("Counted 1 vote against:");
-      voteTally--;
-    }
-    //sol_log_64(signatureArray[i].vote, 0, 0, 0, 0);
-  }
-  
+  ensureTallyCurrent(petitionAccount->data);
+  int64_t voteTally = petitionMeta->netTally;
   bool petitionOutcome = voteTally > 0;
   // The petition succeeds! Redact the post.
   if(petitionOutcome) {
-    sol_log("Petition succeeded!");
-    //sol_assert(SolPubkey_same(offenderAccount->key, &petitionMeta->offendingPost.poster));
-    redactPost(offenderAccount, petitionMeta->offendingPost.index);
+    LOG_INFO("Petition succeeded!");
+    redactPost(postAccount, offendingPost.index);
     AccountMetadata* offenderMeta = (AccountMetadata*)offenderAccount->data;
-    offenderMeta->reputation -= voteTally * petitionMeta->reputationRequirement;
+    uint64_t penalty = voteTally * petitionMeta->reputationRequirement;
+    if(offenderMeta->reputation > penalty) {
+      offenderMeta->reputation -= penalty;
+    }
+    else {
+      offenderMeta->reputation = 0;
+    }
   }
   // The petition failed.
   else {
-    sol_log("Petition failed.");
+    LOG_INFO("Petition failed.");
   }
+  LOG_INFO("Vote tally:");
+  LOG_INFO_64(voteTally, 0, 0, 0, 0);
+
+  if(finalizeOnly) {
+    if(slot != NULL) {
+      slot->unclaimed = petitionMeta->numSignatures;
+    }
+    return SUCCESS;
+  }
+
   // Distribute rewards and penalties
   for(uint64_t i = 0; i < petitionMeta->numSignatures; i++) {
-    AccountMetadata* voterMeta = (AccountMetadata*)&voterAccounts[i].data;
-    if(signatureArray[i].vote == petitionOutcome) {
-      // Reward this user
-      sol_log("Rewarding user:");
-      voterMeta->reputation += petitionMeta->reputationRequirement;
-    }
-    else {
-      // Penalize this user
-      sol_log("Penalizing user:");
-      voterMeta->reputation -= petitionMeta->reputationRequirement;
-    }
-    sol_log_pubkey(&signatureArray[i].signer);
-    sol_log("For this amount of reputation:");
-    sol_log_64(petitionMeta->reputationRequirement, 0, 0, 0, 0);
+    SolAccountInfo* voterAccount = instructionAccount(params, reader, firstVoter + i, &voterBuffer);
+    AccountMetadata* voterMeta = (AccountMetadata*)voterAccount->data;
+    bool vote = (voterVotes[i / 64] >> (i % 64)) & 1;
+    applyPetitionReward(voterMeta, petitionMeta, vote);
+    LOG_DEBUG(vote == petitionOutcome ? "Rewarded user:" : "Penalized user:");
+    LOG_DEBUG_PUBKEY(voterAccount->key);
+    LOG_DEBUG("For this amount of reputation:");
+    LOG_DEBUG_64(petitionMeta->reputationRequirement, 0, 0, 0, 0);
   }
-  sol_log("Vote tally:");
-  sol_log_64(voteTally, 0, 0, 0, 0);
 
+  if(slot != NULL) {
+    releasePetitionSlot(&params->ka[0], slot);
+  }
+  return SUCCESS;
+}
+
+/*
+Reward claim processor
+Expects 2 accounts:
+  -The voter's account
+  -The finalized petition they signed, or its petition pool
+The instruction data is the voter's uint16_t signature index, followed by
+the pool slot and generation for pooled petitions. No signature is
+required, so penalties are applied even if the voter never claims them.
+A claimed slot has its signer key cleared, so it can't be claimed twice.
+The last claim of a pooled petition releases its pool slot.
+*/
+uint64_t claimPetitionReward(SolParameters* params) {
+  if(params->ka_num != 2) {
+    LOG_ERROR_64(309, "2 account parameters are needed to claim a reward, Got:", params->ka_num, 0);
+    return ERROR_NOT_ENOUGH_ACCOUNT_KEYS;
+  }
+
+  if(params->data_len != 1 + sizeof(uint16_t) && params->data_len != 1 + sizeof(uint16_t) + PETITION_REF_SIZE) {
+    LOG_ERROR_64(310, "Claim instructions must be 3 bytes, or 9 for pooled petitions, Got:", params->data_len, 0);
+    return ERROR_INVALID_INSTRUCTION_DATA;
+  }
+  uint16_t index = *(uint16_t*)(&params->data[1]);
+
+  SolAccountInfo petition;
+  PetitionPoolSlot* slot;
+  uint64_t result = resolvePetition(&params->ka[1], &params->data[1 + sizeof(uint16_t)],
+                                    params->data_len - 1 - sizeof(uint16_t), &petition, &slot);
+  if(result != SUCCESS) {
+    return result;
+  }
+  SolAccountInfo* voterAccount = &params->ka[0];
+  SolAccountInfo* petitionAccount = &petition;
+
+  if(!isInitialized(petitionAccount->data) || !isInitialized(voterAccount->data)) {
+    LOG_ERROR(311, "Cannot claim with an uninitialized account");
+    return ERROR_UNINITIALIZED_ACCOUNT;
+  }
+
+  PetitionAccountMeta* petitionMeta = (PetitionAccountMeta*)petitionAccount->data;
+  if(*petitionState(petitionAccount->data) != PETITION_FINALIZED) {
+    LOG_ERROR(312, "Rewards can only be claimed from finalized petitions");
+    return ERROR_INVALID_ACCOUNT_DATA;
+  }
+
+  if(index >= petitionMeta->numSignatures ||
+     !SolPubkey_same(petitionSigner(petitionAccount->data, index), voterAccount->key)) {
+    LOG_ERROR(313, "Signature slot is already claimed or belongs to another voter");
+    return ERROR_INVALID_ARGUMENT;
+  }
+
+  AccountMetadata* voterMeta = (AccountMetadata*)voterAccount->data;
+  applyPetitionReward(voterMeta, petitionMeta, petitionVote(petitionAccount->data, index));
+  sol_memset(petitionSigner(petitionAccount->data, index), 0, sizeof(SolPubkey));
+
+  if(slot != NULL && --slot->unclaimed == 0) {
+    releasePetitionSlot(&params->ka[1], slot);
+  }
   return SUCCESS;
 }
 
@@ -434,7 +1817,7 @@ uint64_t ensureInitializedUser(SolAccountInfo* account) {
   then it is invalid
   */
   if(account->data_len < sizeof(AccountMetadata)) {
-    sol_log("The poster's account is too small to be valid");
+    LOG_ERROR(201, "The poster's account is too small to be valid");
     return ERROR_ACCOUNT_DATA_TOO_SMALL;
   }
 
@@ -448,194 +1831,728 @@ uint64_t ensureInitializedUser(SolAccountInfo* account) {
   return SUCCESS;
 }
 
+// Ensure a user account is signed, initialized and upgraded to version 2 so it can
+// accept new posts
+uint64_t ensurePostableUser(SolAccountInfo* posterAccount) {
+  if(!posterAccount->is_signer) {
+    LOG_ERROR(202, "The poster must sign this instruction");
+    return ERROR_MISSING_REQUIRED_SIGNATURES;
+  }
+
+  // Ensure that the account is initialized
+  uint64_t result = ensureInitializedUser(posterAccount);
+  if(result != SUCCESS) {
+    return result;
+  }
+
+  if(posterAccount->data[0] != User) {
+    LOG_ERROR(214, "Only user accounts can post");
+    return ERROR_INVALID_ACCOUNT_DATA;
+  }
+
+  if(!isCurrentUser(posterAccount->data)) {
+    LOG_ERROR(203, "This account must be migrated before it can accept new posts");
+    return ERROR_INVALID_ACCOUNT_DATA;
+  }
+
+  return SUCCESS;
+}
+
+/*
+Finds the account new posts of the poster, the first account, go to. That
+is the poster's own account until it opens a continuation page, and the
+newest page after that, which must then be the second account.
+*/
+uint64_t findPostAccount(SolParameters* params, SolAccountInfo** postAccount) {
+  SolAccountInfo* posterAccount = &params->ka[0];
+  AccountMetadata* meta = (AccountMetadata*)posterAccount->data;
+  *postAccount = posterAccount;
+  if(meta->numPages == 0) {
+    return SUCCESS;
+  }
+
+  if(params->ka_num < 2) {
+    LOG_ERROR(212, "The poster's newest page must be the second account");
+    return ERROR_NOT_ENOUGH_ACCOUNT_KEYS;
+  }
+  SolAccountInfo* pageAccount = &params->ka[1];
+  if(!SolPubkey_same(pageAccount->owner, params->program_id) ||
+     !isPageOf(pageAccount, posterAccount->key) ||
+     ((UserPageMeta*)pageAccount->data)->page != meta->numPages) {
+    LOG_ERROR(213, "The second account is not the poster's newest page");
+    return ERROR_INVALID_ARGUMENT;
+  }
+  *postAccount = pageAccount;
+  return SUCCESS;
+}
+
+// Appends a post to the tail of an account or page found by
+// findPostAccount() and indexes it, stamped with *clockSlot unless it is
+// NULL. The parsed post is left in postData.
+uint64_t appendPost(SolAccountInfo* posterAccount, const uint8_t* data, uint64_t length,
+                    Post* postData, const uint64_t* clockSlot) {
+  AccountMetadata* meta = (AccountMetadata*)(posterAccount->data);
+  if(firstPostIndex(posterAccount->data) + meta->numPosts >= UINT32_MAX) {
+    LOG_ERROR(204, "This account has reached the maximum number of posts");
+    return ERROR_ACCOUNT_DATA_TOO_SMALL;
+  }
+
+  // Process the post instruction
+
+  LOG_DEBUG("Received post:");
+  LOG_DEBUG_ARRAY(data, length);
+
+  // Find the offset at which a new post would be stored
+  uint64_t newOffset = newPostOffset(posterAccount->data, posterAccount->data_len);
+
+  LOG_DEBUG("Bytes used:");
+  LOG_DEBUG_64(0, 0, 0, 0, newOffset);
+
+  uint64_t bytesNeeded = parsePost(data, length, postData);
+  LOG_DEBUG("Bytes needed:");
+  LOG_DEBUG_64(0, 0, 0, 0, bytesNeeded);
+  if(bytesNeeded == 0) {
+    LOG_ERROR(205, "Invalid instruction");
+    return ERROR_INVALID_INSTRUCTION_DATA;
+  }
+
+  // The free space must be large enough to hold the stamp, the post, its
+  // padding and its index slot
+  uint64_t stampSize = clockSlot != NULL ? sizeof(SlotStamp) : 0;
+  uint64_t newTail = alignRecord(newOffset + stampSize + bytesNeeded);
+  if(newTail + sizeof(PostSlot) > postDataEnd(posterAccount->data, posterAccount->data_len)) {
+    LOG_DEBUG_64(newOffset, bytesNeeded, posterAccount->data_len, 0, 0);
+    LOG_ERROR(206, "Account too small to hold new post");
+    return ERROR_ACCOUNT_DATA_TOO_SMALL;
+  }
+
+  // Finally, copy the actual post into memory
+  if(clockSlot != NULL) {
+    sol_memcpy(&posterAccount->data[newOffset], clockSlot, sizeof(SlotStamp));
+    newOffset += sizeof(SlotStamp);
+  }
+  copyPost(postData, &posterAccount->data[newOffset]);
+  // Index the post and increment post count
+  *postSlot(posterAccount->data, posterAccount->data_len, meta->numPosts) =
+    newOffset | (clockSlot != NULL ? STAMPED_RECORD : 0);
+  meta->tailOffset = newTail;
+  meta->numPosts += 1;
+
+  return SUCCESS;
+}
+
+// Signs a petition on behalf of an initialized user that has signed
+// the instruction
+uint64_t castVote(SolAccountInfo* votingAccount, SolAccountInfo* petitionAccount, bool userVote) {
+  if(!isInitialized(petitionAccount->data)) {
+    LOG_ERROR(314, "Cannot vote on an uninitialized petition");
+    return ERROR_UNINITIALIZED_ACCOUNT;
+  }
+  if(petitionAccount->data[0] != Petition) {
+    LOG_ERROR(327, "Votes can only be cast on petition accounts");
+    return ERROR_INVALID_ACCOUNT_DATA;
+  }
+
+  // Check if the petition is already completed
+  PetitionAccountMeta* petition = (PetitionAccountMeta*)(petitionAccount->data);
+  if(petition->numSignatures >= petitionCapacity(petitionAccount->data, petitionAccount->data_len)) {
+    LOG_ERROR_64(315, "Petition is already full", petition->numSignatures, petitionCapacity(petitionAccount->data, petitionAccount->data_len));
+    return ERROR_INVALID_ACCOUNT_DATA;
+  }
+
+  // Check if the user has already voted on this petition
+  if(hasVoted(votingAccount, petitionAccount)) {
+    LOG_ERROR(316, "This user has already voted on this petition");
+    return ERROR_INVALID_INSTRUCTION_DATA;
+  }
+
+  // Check if the user's account meets the voting requirements
+  if(!meetsVotingRequirements(votingAccount, petitionAccount)) {
+    LOG_ERROR(317, "The user does not have enough reputation to vote on this petition");
+    return ERROR_INVALID_ACCOUNT_DATA;
+  }
+
+  // We can vote!
+  ensureTallyCurrent(petitionAccount->data);
+  appendSignature(petitionAccount->data, votingAccount->key, userVote);
+
+  // If that was the last signature, determine the outcome of the vote
+  // This is now handled in a separate transaction
+  /*
+  if(petition->numSignatures == petitionCapacity(petitionAccount->data, petitionAccount->data_len)) {
+    processPetitionOutcome(petitionAccount, offendingAccount);
+  }
+  */
+
+  return SUCCESS;
+}
+
 // END helper functions 
 // ---------------------------------------------------------------------------- 
 
 // Processing functions for each type of instruction
 
 /*
-Post processor
-Note that a 'post' also includes likes, reports, and replies
+Finds the counters a reply, like or report should bump. The target is the
+account at the given index, and is either the referenced poster's account,
+the poster's page holding the post, or one of the referenced post's counter
+shards. Sets *counters to NULL when there is nothing to update.
+*/
+uint64_t findTargetCounters(SolParameters* params, uint64_t target, Post* post,
+                            PostCounters** counters) {
+  *counters = NULL;
+  SolAccountInfo* targetAccount = &params->ka[target];
+  bool isShard = SolPubkey_same(targetAccount->owner, params->program_id) &&
+                 targetAccount->data_len >= sizeof(CounterShardMeta) &&
+                 targetAccount->data[0] == CounterShard;
+  if(isShard) {
+    if(!isShardOf(targetAccount, &post->id)) {
+      LOG_ERROR(207, "The counter shard belongs to a different post");
+      return ERROR_INVALID_ARGUMENT;
+    }
+    if(targetAccount->is_writable) {
+      *counters = &((CounterShardMeta*)targetAccount->data)->counters;
+    }
+    return SUCCESS;
+  }
+
+  if(!SolPubkey_same(targetAccount->key, &post->id.poster) && !isPageOf(targetAccount, &post->id.poster)) {
+    LOG_ERROR(208, "The target account must be the account or page of the referenced post");
+    return ERROR_INVALID_ARGUMENT;
+  }
+  if(!targetAccount->is_writable) {
+    return SUCCESS;
+  }
+  if(!SolPubkey_same(targetAccount->owner, params->program_id)) {
+    LOG_ERROR(209, "The referenced account does not have the correct program id");
+    return ERROR_INCORRECT_PROGRAM_ID;
+  }
+  if(targetAccount->data_len < USER_V1_HEADER_SIZE ||
+     (targetAccount->data[0] != User && targetAccount->data[0] != UserPage)) {
+    LOG_ERROR(210, "The referenced account is not a user account");
+    return ERROR_INVALID_ACCOUNT_DATA;
+  }
+
+  *counters = postCounters(targetAccount->data, targetAccount->data_len, post->id.index);
+  return SUCCESS;
+}
+
+/*
+Bumps the counters of the post referenced by a reply, like or report.
+The target account is optional: when it is passed at the given index,
+writable, and is either a counter shard of the referenced post or the
+poster's account or page holding the post created with COUNTERS_FLAG,
+the matching counter is incremented.
+*/
+uint64_t countReference(SolParameters* params, uint64_t target, Post* post) {
+  if(post->typeSelector == POST_SELECTOR || params->ka_num <= target) {
+    return SUCCESS;
+  }
+
+  PostCounters* counters;
+  uint64_t result = findTargetCounters(params, target, post, &counters);
+  if(result != SUCCESS || counters == NULL) {
+    return result;
+  }
+  switch(post->typeSelector) {
+  case REPLY_SELECTOR:
+    counters->replies++;
+    break;
+  case LIKE_SELECTOR:
+    counters->likes++;
+    break;
+  case REPORT_SELECTOR:
+    counters->reports++;
+    break;
+  default:
+    break;
+  }
+
+  return SUCCESS;
+}
+
+/*
+Post processor
+Note that a 'post' also includes likes, reports, and replies
+Expects the poster's account, then its newest page if it has any, then
+optionally the account of the post being replied to, liked or reported
+so its counters can be updated. The post is stamped with *clockSlot
+unless it is NULL.
+*/
+uint64_t processPost(SolParameters* params, const uint64_t* clockSlot) {
+  SolAccountInfo* posterAccount = &params->ka[0];
+
+  // Reject any posts that are too long for a uint16_t
+  if(params->data_len > MAX_INSTRUCTION_LENGTH) {
+    LOG_ERROR(211, "The post is too long");
+    return ERROR_INVALID_INSTRUCTION_DATA;
+  }
+
+  uint64_t result = ensurePostableUser(posterAccount);
+  if(result != SUCCESS) {
+    return result;
+  }
+
+  SolAccountInfo* postAccount;
+  result = findPostAccount(params, &postAccount);
+  if(result != SUCCESS) {
+    return result;
+  }
+
+  Post postData;
+  result = appendPost(postAccount, params->data, params->data_len, &postData, clockSlot);
+  if(result != SUCCESS) {
+    return result;
+  }
+
+  return countReference(params, postAccount == posterAccount ? 1 : 2, &postData);
+}
+
+/*
+Vote insruction processor
+Expects 2 accounts:
+  -The account voting
+  -The account containing the petition, or its petition pool
+Only the first must be a signer. The instruction data is the vote byte,
+followed by the pool slot and generation for pooled petitions.
+*/
+uint64_t processVote(SolParameters* params) {
+  if(params->ka_num != 2) {
+    LOG_ERROR_64(318, "2 account parameters are needed to vote, Got:", params->ka_num, 0);
+    return ERROR_NOT_ENOUGH_ACCOUNT_KEYS;
+  }
+
+  // Instruction data is a single byte indicating the boolean vote
+  if(params->data_len != 2 && params->data_len != 2 + PETITION_REF_SIZE) {
+    LOG_ERROR_64(319, "Vote instructions must be 2 bytes, or 8 for pooled petitions, Got:", params->data_len, 0);
+    return ERROR_INVALID_INSTRUCTION_DATA;
+  }
+  bool userVote = params->data[1] != 0;
+
+  SolAccountInfo* votingAccount = &params->ka[0];
+  SolAccountInfo petitionAccount;
+  PetitionPoolSlot* slot;
+
+  if(!votingAccount->is_signer) {
+    LOG_ERROR(320, "The voter must sign this instruction");
+    return ERROR_MISSING_REQUIRED_SIGNATURES;
+  }
+
+  // Ensure that the account is initialized
+  uint64_t result = ensureInitializedUser(votingAccount);
+  if(result != SUCCESS) {
+    return result;
+  }
+
+  result = resolvePetition(&params->ka[1], &params->data[2], params->data_len - 2, &petitionAccount, &slot);
+  if(result != SUCCESS) {
+    return result;
+  }
+  return castVote(votingAccount, &petitionAccount, userVote);
+}
+
+/*
+Process an instruction to initialize a new petition account
+Expects 2 accounts:
+  -The account that will contain the petition (uninitialized), or a
+   petition pool to take a slot from
+  -The account that the petition is against (offending account)
+The petition account or pool must sign. A pool's key is its authority:
+slots only come back once their petition settles, so letting anyone take
+them would let one caller fill the pool with petitions nobody votes on.
+The slot and generation of a pooled petition are logged.
+*/
+uint64_t createPetition(SolParameters* params) {
+  
+  if(params->ka_num != 2) {
+    LOG_ERROR_64(321, "2 account parameters are needed to create a new petition, Got:", params->ka_num, 0);
+    return ERROR_NOT_ENOUGH_ACCOUNT_KEYS;
+  }
+
+  // Valid instruction data is always the same length
+  if(params->data_len != CREATE_PETITION_INSTRUCTION_SIZE) {
+    LOG_ERROR_64(322, "Create petition instructions must be 5 bytes, Got:", params->data_len, 0);
+    return ERROR_INVALID_INSTRUCTION_DATA;
+  }
+
+  SolAccountInfo* petitionAccount = (SolAccountInfo*)&params->ka[0];
+  SolAccountInfo* offendingAccount = (SolAccountInfo*)&params->ka[1];
+  PostID offendingPost;
+  offendingPost.poster = *offendingAccount->key;
+  offendingPost.index = *(uint32_t*)(&params->data[1]);
+
+  if(!petitionAccount->is_signer) {
+    LOG_ERROR(323, "The petition account or pool must sign");
+    return ERROR_MISSING_REQUIRED_SIGNATURES;
+  }
+
+  // Pool slots were sized when the pool was created
+  if(petitionAccount->data[0] == PetitionPool) {
+    SolAccountInfo petition;
+    uint64_t result = allocatePetitionSlot(petitionAccount, &petition);
+    if(result != SUCCESS) {
+      return result;
+    }
+    initializePetitionAccount(petition.data, petition.data_len, &offendingPost, offendingAccount->data, offendingAccount->data_len);
+    return SUCCESS;
+  }
+
+  if(isInitialized(petitionAccount->data)) {
+    LOG_ERROR(324, "Cannot create a petition on an initialized account");
+    return ERROR_INVALID_ACCOUNT_DATA;
+  }
+
+  if(signatureCapacity(petitionAccount->data_len) == 0) {
+    LOG_ERROR(325, "The petition account is too small to hold any signatures");
+    return ERROR_ACCOUNT_DATA_TOO_SMALL;
+  }
+
+  if(signatureCapacity(petitionAccount->data_len) > MAX_PETITION_SIZE) {
+    LOG_ERROR_64(326, "Cannot create a petition with more signature slots than:", MAX_PETITION_SIZE, 0);
+    return ERROR_INVALID_ACCOUNT_DATA;
+  }
+
+  initializePetitionAccount(petitionAccount->data, petitionAccount->data_len, &offendingPost, offendingAccount->data, offendingAccount->data_len);
+
+  return SUCCESS;
+}
+
+/*
+Process an instruction to initialize a petition pool
+Expects 1 account, the pool (uninitialized), which must sign. The pool
+has as many slots of the requested number of signatures as fit in it,
+up to 65535.
+
+Instruction format:
+
+width       name          type          description
+-----------------------------------------------------------------------------
+1           selector      uint8_t       ASCII O
+2           signatures    uint16_t      signature slots of each petition
 */
-uint64_t processPost(SolParameters* params) {
-  SolAccountInfo* posterAccount = &params->ka[0];
+uint64_t createPetitionPool(SolParameters* params) {
+  if(params->ka_num != 1) {
+    LOG_ERROR_64(333, "1 account parameter is needed to create a petition pool, Got:", params->ka_num, 0);
+    return ERROR_NOT_ENOUGH_ACCOUNT_KEYS;
+  }
 
-  // Reject any posts that are too long for a uint16_t
-  if(params->data_len > MAX_INSTRUCTION_LENGTH) {
-    sol_log("The post is too long");
+  if(params->data_len != CREATE_POOL_INSTRUCTION_SIZE) {
+    LOG_ERROR_64(334, "Create pool instructions must be 3 bytes, Got:", params->data_len, 0);
     return ERROR_INVALID_INSTRUCTION_DATA;
   }
+  uint16_t signatures = *(uint16_t*)(&params->data[1]);
 
-  if(!posterAccount->is_signer) {
-    sol_log("The poster must sign this instruction");
+  SolAccountInfo* poolAccount = &params->ka[0];
+  if(!poolAccount->is_signer) {
+    LOG_ERROR(335, "The petition pool account must sign");
     return ERROR_MISSING_REQUIRED_SIGNATURES;
   }
 
-  // Ensure that the account is initialized
-  uint64_t result = ensureInitializedUser(posterAccount);
-  if(result != SUCCESS) {
-    return result;
+  if(isInitialized(poolAccount->data)) {
+    LOG_ERROR(336, "Cannot create a petition pool on an initialized account");
+    return ERROR_INVALID_ACCOUNT_DATA;
   }
 
-  // Process the post instruction
+  if(signatures == 0 || signatures > MAX_PETITION_SIZE) {
+    LOG_ERROR_64(337, "Pooled petitions need between 1 and this many signature slots:", MAX_PETITION_SIZE, 0);
+    return ERROR_INVALID_INSTRUCTION_DATA;
+  }
 
-  //sol_log("Recieved post:");
-  //sol_log_array(params->data, params->data_len);
+  uint64_t slotSize = PETITION_SLOT_SIZE(signatures);
+  if(poolAccount->data_len < sizeof(PetitionPoolMeta) + slotSize) {
+    LOG_ERROR_64(338, "The petition pool account is too small for a slot of size:", slotSize, 0);
+    return ERROR_ACCOUNT_DATA_TOO_SMALL;
+  }
+  uint64_t numSlots = (poolAccount->data_len - sizeof(PetitionPoolMeta)) / slotSize;
+
+  // Slots are set up as they are first handed out
+  PetitionPoolMeta* pool = (PetitionPoolMeta*)poolAccount->data;
+  pool->accountType = PetitionPool;
+  pool->reserved = 0;
+  pool->numSlots = numSlots > 0xFFFF ? 0xFFFF : numSlots;
+  pool->firstUnused = 0;
+  pool->freeHead = 0;
+  pool->slotSize = slotSize;
+  pool->openPetitions = 0;
 
-  // Find the offset at which a new post would be stored
-  uint64_t newOffset = newPostOffset(posterAccount->data, posterAccount->data_len);
+  return SUCCESS;
+}
 
-  //sol_log("Bytes used:");
-  //sol_log_64(0, 0, 0, 0, newOffset);
-  //sol_log("Data to be added:");
+/*
+Compaction processor
+Reclaims space in the poster's indexed account by shrinking redacted
+bodies to a single REDACTION_BYTE and, optionally, dropping like
+records. Records are moved down in index order and their index slots
+updated, so PostIDs stay valid; dropped records leave a tombstone slot.
+Only the given range of posts is compacted so that large accounts can
+be processed over several instructions within the compute budget. Space
+is only returned to the tail once the range reaches the last post.
+Expects 1 account, the poster's, which must sign.
+
+Instruction format:
 
-  Post postData;
-  uint64_t bytesNeeded = parsePost(params->data, params->data_len, &postData);
-  //sol_log_64(0, 0, 0, 0, bytesNeeded);
-  if(bytesNeeded == 0) {
-    sol_log("Invalid instruction");
+width       name          type          description
+-----------------------------------------------------------------------------
+1           selector      uint8_t       ASCII G
+1           flags         uint8_t       COMPACT_DROP_LIKES
+4           first         uint32_t      index of the first post to compact
+4           count         uint32_t      number of posts to compact
+*/
+uint64_t compactPosts(SolParameters* params) {
+  if(params->data_len != COMPACT_INSTRUCTION_SIZE) {
+    LOG_ERROR_64(501, "Compaction instructions must be 10 bytes, Got:", params->data_len, 0);
     return ERROR_INVALID_INSTRUCTION_DATA;
   }
 
-  // The data must be large enough to hold the post
-  if(newOffset + bytesNeeded > posterAccount->data_len) {
-    //sol_log_64(newOffset, bytesNeeded, posterAccount->data_len, 0, 0);
-    sol_log("Account too small to hold new post");
-    return ERROR_ACCOUNT_DATA_TOO_SMALL;
+  SolAccountInfo* posterAccount = &params->ka[0];
+  uint64_t result = ensurePostableUser(posterAccount);
+  if(result != SUCCESS) {
+    return result;
   }
 
-  // Finally, copy the actual post into memory
-  copyPost(&postData, &posterAccount->data[newOffset]);
-  // Increment post count
-  AccountMetadata* meta = (AccountMetadata*)(posterAccount->data);
-  meta->numPosts += 1;
+  uint8_t* data = posterAccount->data;
+  uint64_t length = posterAccount->data_len;
+  AccountMetadata* meta = (AccountMetadata*)data;
+  bool dropLikes = (params->data[1] & COMPACT_DROP_LIKES) != 0;
+  uint32_t first = *((uint32_t*)&params->data[2]);
+  if(first > meta->numPosts) {
+    LOG_ERROR(502, "The first post to compact does not exist");
+    return ERROR_INVALID_INSTRUCTION_DATA;
+  }
+  uint64_t last = (uint64_t)first + *((uint32_t*)&params->data[6]);
+  if(last > meta->numPosts) {
+    last = meta->numPosts;
+  }
+
+  uint64_t cursor = liveDataEnd(data, length, first);
+  for(uint64_t i = first; i < last; i++) {
+    PostSlot* slot = postSlot(data, length, i);
+    if(*slot == 0) {
+      continue;
+    }
+    // Stamps move with their records
+    uint64_t stampSize = (*slot & STAMPED_RECORD) ? sizeof(SlotStamp) : 0;
+    uint8_t* record = &data[*slot & ~STAMPED_RECORD];
+    uint64_t recordLength = sizeof(uint16_t) + *((uint16_t*)record);
+    Post post;
+    if(parsePost(&record[sizeof(uint16_t)], recordLength - sizeof(uint16_t), &post) == 0) {
+      LOG_ERROR_64(503, "Failed to parse post from account data:", i, *slot);
+      return ERROR_INVALID_ACCOUNT_DATA;
+    }
+
+    if(dropLikes && post.typeSelector == LIKE_SELECTOR) {
+      *slot = 0;
+      continue;
+    }
+    // Bodies end their records, so a redacted body shrinks to its first byte
+    if((record[sizeof(uint16_t)] & REDACTED_FLAG) && post.bodyLength > 1) {
+      recordLength -= post.bodyLength - 1;
+      *((uint16_t*)record) = recordLength - sizeof(uint16_t);
+    }
+    moveDown(&data[cursor], record - stampSize, stampSize + recordLength);
+    *slot = (cursor + stampSize) | (*slot & STAMPED_RECORD);
+    cursor = alignRecord(cursor + stampSize + recordLength);
+  }
+
+  // Return the freed space to the tail once every later record has moved
+  if(last == meta->numPosts) {
+    sol_memset(&data[cursor], 0, meta->tailOffset - cursor);
+    meta->tailOffset = cursor;
+  }
 
   return SUCCESS;
 }
 
 /*
-Vote insruction processor
-Expects 2 accounts:
-  -The account voting
-  -The account containing the petition
-Only the first must be a signer.
+Process an instruction to initialize a counter shard for one of the
+poster's posts
+Expects 2 or 3 accounts:
+  -The poster's account, which must sign
+  -The account that will contain the shard (uninitialized)
+  -The poster's page holding the post, if it is in a continuation page
+The shard must be at the address PublicKey.createWithSeed(poster,
+"shard:<index>:<shard>", programId), so clients can read the shards of a
+post without a scan and no other account can be made a shard.
+
+Instruction format:
+
+width       name          type          description
+-----------------------------------------------------------------------------
+1           selector      uint8_t       ASCII K
+4           index         uint32_t      index of the poster's post
+1           shard         uint8_t       shard number, below shardCount
+1           shardCount    uint8_t       number of shards for the post
 */
-uint64_t processVote(SolParameters* params) {
-  if(params->ka_num != 2) {
-    sol_log("2 account parameters are needed to vote, Got:");
-    sol_log_64(params->ka_num, 0, 0, 0, 0);
+uint64_t createCounterShard(SolParameters* params) {
+  if(params->ka_num != 2 && params->ka_num != 3) {
+    LOG_ERROR_64(504, "2 or 3 account parameters are needed to create a counter shard, Got:", params->ka_num, 0);
     return ERROR_NOT_ENOUGH_ACCOUNT_KEYS;
   }
 
-  // Instruction data is a single byte indicating the boolean vote
-  if(params->data_len != 2) {
-    sol_log("Vote instructions must be 2 bytes, Got:");
-    sol_log_64(params->data_len, 0, 0, 0, 0);
+  if(params->data_len != CREATE_SHARD_INSTRUCTION_SIZE) {
+    LOG_ERROR_64(505, "Create shard instructions must be 7 bytes, Got:", params->data_len, 0);
     return ERROR_INVALID_INSTRUCTION_DATA;
   }
-  bool userVote = params->data[1] != 0;
 
-  SolAccountInfo* votingAccount = &params->ka[0];
-  SolAccountInfo* petitionAccount = &params->ka[1];
+  SolAccountInfo* posterAccount = &params->ka[0];
+  SolAccountInfo* shardAccount = &params->ka[1];
 
-  if(!votingAccount->is_signer) {
-    sol_log("The voter must sign this instruction");
+  if(!posterAccount->is_signer) {
+    LOG_ERROR(506, "The poster must sign this instruction");
     return ERROR_MISSING_REQUIRED_SIGNATURES;
   }
 
-  if(!isInitialized(petitionAccount->data)) {
-    sol_log("Cannot vote on an uninitialized petition");
-    return ERROR_UNINITIALIZED_ACCOUNT;
+  if(!SolPubkey_same(shardAccount->owner, params->program_id)) {
+    LOG_ERROR(507, "The shard account does not have the correct program id");
+    return ERROR_INCORRECT_PROGRAM_ID;
   }
 
-  // Ensure that the account is initialized
-  uint64_t result = ensureInitializedUser(votingAccount);
-  if(result != SUCCESS) {
-    return result;
+  if(shardAccount->data_len < sizeof(CounterShardMeta)) {
+    LOG_ERROR(508, "The shard account is too small to be valid");
+    return ERROR_ACCOUNT_DATA_TOO_SMALL;
   }
 
-  // Check if the petition is already completed
-  PetitionAccountMeta* petition = (PetitionAccountMeta*)(petitionAccount->data);
-  if(petition->numSignatures >= signatureCapacity(petitionAccount->data_len)) {
-    sol_log("Petition is already full");
-    sol_log_64(petition->numSignatures, signatureCapacity(petitionAccount->data_len), 0, 0, 0);
+  if(isInitialized(shardAccount->data)) {
+    LOG_ERROR(509, "Cannot create a counter shard on an initialized account");
     return ERROR_INVALID_ACCOUNT_DATA;
   }
 
-  // Check if the user has already voted on this petition
-  if(hasVoted(votingAccount, petitionAccount)) {
-    sol_log("This user has already voted on this petition");
+  uint32_t index = *(uint32_t*)(&params->data[1]);
+  uint8_t shard = params->data[5];
+  uint8_t shardCount = params->data[6];
+  if(shard >= shardCount) {
+    LOG_ERROR(510, "The shard number must be below the shard count");
     return ERROR_INVALID_INSTRUCTION_DATA;
   }
 
-  // Check if the user's account meets the voting requirements
-  if(!meetsVotingRequirements(votingAccount, petitionAccount)) {
-    sol_log("The user does not have enough reputation to vote on this petition");
-    return ERROR_INVALID_ACCOUNT_DATA;
+  SolPubkey expected;
+  shardAddress(posterAccount->key, index, shard, params->program_id, &expected);
+  if(!SolPubkey_same(&expected, shardAccount->key)) {
+    LOG_ERROR(527, "The shard account is not at the address derived from the post and shard number");
+    return ERROR_INVALID_ARGUMENT;
   }
 
-  // We can vote!
-  PetitionSignature* signatureArray = (PetitionSignature*)&petitionAccount->data[sizeof(PetitionAccountMeta)];
-  PetitionSignature userSignature = { .signer = *votingAccount->key, .vote = userVote };
-  sol_memcpy(&signatureArray[petition->numSignatures], &userSignature, sizeof(PetitionSignature));
-  petition->numSignatures++;
-
-  // If that was the last signature, determine the outcome of the vote
-  // This is now handled in a separate transaction
-  /*
-  if(petition->numSignatures == signatureCapacity(petitionAccount->data_len)) {
-    processPetitionOutcome(petitionAccount, offendingAccount);
+  SolAccountInfo* postAccount = params->ka_num == 3 ? &params->ka[2] : posterAccount;
+  bool isPosterPage = postAccount != posterAccount &&
+                      SolPubkey_same(postAccount->owner, params->program_id) &&
+                      isPageOf(postAccount, posterAccount->key);
+  uint32_t local;
+  if(postAccount->data_len < USER_V1_HEADER_SIZE ||
+     (postAccount->data[0] != User && !isPosterPage) ||
+     !localPostIndex(postAccount->data, index, &local)) {
+    LOG_ERROR(511, "The post to shard does not exist");
+    return ERROR_INVALID_ARGUMENT;
   }
-  */
+
+  CounterShardMeta* meta = (CounterShardMeta*)shardAccount->data;
+  meta->accountType = CounterShard;
+  meta->shard = shard;
+  meta->shardCount = shardCount;
+  meta->post.poster = *posterAccount->key;
+  meta->post.index = index;
+  sol_memset(&meta->counters, 0, sizeof(PostCounters));
 
   return SUCCESS;
 }
 
 /*
-Process an instruction to initialize a new petition account
-Expects 2 accounts:
-  -The account that will contain the petition (uninitialized)
-  -The account that the petition is against (offending account)
+Batch instruction processor
+Runs a sequence of posts, replies, likes, reports and votes for the
+first account, which must sign. The account is validated once and every
+post is appended through the same tail cursor, in the account's newest
+page if it has any, which is then the second account. Any petitions
+voted on are passed as further accounts and referenced by their account
+index, followed by the pool slot and generation for pooled petitions.
+If any operation fails the whole instruction fails. Batched operations
+never update the counters of the posts they reference, and every post
+is stamped with *clockSlot unless it is NULL.
+
+Batch format:
+
+width       name          type          description
+-----------------------------------------------------------------------------
+1           selector      uint8_t       ASCII B
+Then repeated until the end of the instruction data:
+2           length        uint16_t      size of the operation
+length      operation     uint8_t[]     a P, R, L or X instruction, or
+                                        V, vote, petition account index
+                                        and optional pool slot
 */
-uint64_t createPetition(SolParameters* params) {
-  
-  if(params->ka_num != 2) {
-    sol_log("2 account parameters are needed to create a new petition, Got:");
-    sol_log_64(params->ka_num, 0, 0, 0, 0);
-    return ERROR_NOT_ENOUGH_ACCOUNT_KEYS;
-  }
+uint64_t processBatch(SolParameters* params, const uint64_t* clockSlot) {
+  SolAccountInfo* userAccount = &params->ka[0];
 
-  // Valid instruction data is always the same length
-  if(params->data_len != CREATE_PETITION_INSTRUCTION_SIZE) {
-    sol_log("Create petition instructions must be 3 bytes, Got:");
-    sol_log_64(params->data_len, 0, 0, 0, 0);
+  if(params->data_len < 1 + sizeof(uint16_t) + 1) {
+    LOG_ERROR(401, "Batch instructions must contain at least one operation");
     return ERROR_INVALID_INSTRUCTION_DATA;
   }
 
-  SolAccountInfo* petitionAccount = (SolAccountInfo*)&params->ka[0];
-  SolAccountInfo* offendingAccount = (SolAccountInfo*)&params->ka[1];
-
-  if(!petitionAccount->is_signer) {
-    sol_log("The petition account must sign");
-    return ERROR_MISSING_REQUIRED_SIGNATURES;
+  uint64_t result = ensurePostableUser(userAccount);
+  if(result != SUCCESS) {
+    return result;
   }
 
-  if(isInitialized(petitionAccount->data)) {
-    sol_log("Cannot create a petition on an initialized account");
-    return ERROR_INVALID_ACCOUNT_DATA;
+  SolAccountInfo* postAccount;
+  result = findPostAccount(params, &postAccount);
+  if(result != SUCCESS) {
+    return result;
   }
 
-  if(signatureCapacity(petitionAccount->data_len) > MAX_PETITION_SIZE) {
-    sol_log("Cannot create a petition with more than:");
-    sol_log_64(MAX_PETITION_SIZE, 0, 0, 0, 0);
-    sol_log("Signature slots");
-    return ERROR_INVALID_ACCOUNT_DATA;
-  }
+  Post postData;
+  uint64_t offset = 1;
+  for(uint64_t i = 0; offset < params->data_len; i++) {
+    if(offset + sizeof(uint16_t) > params->data_len) {
+      LOG_ERROR_64(402, "Truncated batch operation:", i, 0);
+      return ERROR_INVALID_INSTRUCTION_DATA;
+    }
+    uint16_t length = *((uint16_t*)&params->data[offset]);
+    const uint8_t* operation = &params->data[offset + sizeof(uint16_t)];
+    offset += sizeof(uint16_t) + length;
+    if(length == 0 || offset > params->data_len) {
+      LOG_ERROR_64(403, "Truncated batch operation:", i, 0);
+      return ERROR_INVALID_INSTRUCTION_DATA;
+    }
 
-  PostID offendingPost;
-  offendingPost.poster = *offendingAccount->key;
-  offendingPost.index = *(uint16_t*)(&params->data[1]);
-  initializePetitionAccount(petitionAccount->data, petitionAccount->data_len, &offendingPost, offendingAccount->data, offendingAccount->data_len);
+    switch(*operation) {
+    case POST_SELECTOR:
+    case REPLY_SELECTOR:
+    case LIKE_SELECTOR:
+    case REPORT_SELECTOR:
+    case POST_SELECTOR | COUNTERS_FLAG:
+    case REPLY_SELECTOR | COUNTERS_FLAG:
+    case REPORT_SELECTOR | COUNTERS_FLAG:
+    case COMPRESSED_POST_SELECTOR:
+    case COMPRESSED_REPLY_SELECTOR:
+    case COMPRESSED_REPORT_SELECTOR:
+    case COMPRESSED_POST_SELECTOR | COUNTERS_FLAG:
+    case COMPRESSED_REPLY_SELECTOR | COUNTERS_FLAG:
+    case COMPRESSED_REPORT_SELECTOR | COUNTERS_FLAG:
+      result = appendPost(postAccount, operation, length, &postData, clockSlot);
+      break;
+    case VOTE_SELECTOR: {
+      SolAccountInfo petition;
+      PetitionPoolSlot* slot;
+      if((length != 3 && length != 3 + PETITION_REF_SIZE) || operation[2] == 0 || operation[2] >= params->ka_num) {
+        LOG_ERROR(404, "Batched votes must be 3 or 9 bytes and name a petition account");
+        result = ERROR_INVALID_INSTRUCTION_DATA;
+        break;
+      }
+      result = resolvePetition(&params->ka[operation[2]], &operation[3], length - 3, &petition, &slot);
+      if(result == SUCCESS) {
+        result = castVote(userAccount, &petition, operation[1] != 0);
+      }
+      break;
+    }
+    default:
+      LOG_ERROR(405, "Invalid batch operation selector");
+      result = ERROR_INVALID_INSTRUCTION_DATA;
+      break;
+    }
+
+    if(result != SUCCESS) {
+      LOG_ERROR_64(406, "Batch operation failed:", i, 0);
+      return result;
+    }
+  }
 
   return SUCCESS;
 }
@@ -650,15 +2567,14 @@ uint64_t createPetition(SolParameters* params) {
 uint64_t setUsername(SolParameters* params)
 {
   if(params->data_len < 2 || params->data_len > 33) {
-    sol_log("Set username instructions must provide between 2 and 33 bytes of data. Got:");
-    sol_log_64(params->data_len, 0, 0, 0, 0);
+    LOG_ERROR_64(512, "Set username instructions must provide between 2 and 33 bytes of data. Got:", params->data_len, 0);
     return ERROR_INVALID_INSTRUCTION_DATA;
   }
 
   SolAccountInfo* userAccount = &params->ka[0];
 
   if(!userAccount->is_signer) {
-    sol_log("Users must sign off on instructions that set their username.");
+    LOG_ERROR(513, "Users must sign off on instructions that set their username.");
     return ERROR_MISSING_REQUIRED_SIGNATURES;
   }
 
@@ -674,10 +2590,320 @@ uint64_t setUsername(SolParameters* params)
   return SUCCESS;
 }
 
+/*
+Process an instruction to open a continuation page for the poster's posts
+Expects 2 or 3 accounts:
+  -The poster's account, which must sign
+  -The account that will contain the page (uninitialized)
+  -The poster's newest page, if it already has one
+New posts go to the new page from then on, so the poster's account only
+needs to be as large as its own posts. The page must be at the address
+PublicKey.createWithSeed(poster, "page:<number>", programId), so clients
+can find it without a scan and no other account can be opened as a page.
+
+Instruction format:
+
+width       name          type          description
+-----------------------------------------------------------------------------
+1           selector      uint8_t       ASCII N
+*/
+uint64_t openPage(SolParameters* params) {
+  if(params->data_len != 1) {
+    LOG_ERROR(521, "No instruction data is necessary for this instruction");
+    return ERROR_INVALID_INSTRUCTION_DATA;
+  }
+
+  if(params->ka_num < 2) {
+    LOG_ERROR_64(522, "At least 2 account parameters are needed to open a page, Got:", params->ka_num, 0);
+    return ERROR_NOT_ENOUGH_ACCOUNT_KEYS;
+  }
+
+  SolAccountInfo* posterAccount = &params->ka[0];
+  SolAccountInfo* pageAccount = &params->ka[1];
+  uint64_t result = ensurePostableUser(posterAccount);
+  if(result != SUCCESS) {
+    return result;
+  }
+
+  if(!SolPubkey_same(pageAccount->owner, params->program_id)) {
+    LOG_ERROR(523, "The page account does not have the correct program id");
+    return ERROR_INCORRECT_PROGRAM_ID;
+  }
+
+  if(pageAccount->data_len < sizeof(UserPageMeta) + MIN_POST_SIZE + sizeof(PostSlot)) {
+    LOG_ERROR(524, "The page account is too small to hold a post");
+    return ERROR_ACCOUNT_DATA_TOO_SMALL;
+  }
+
+  if(isInitialized(pageAccount->data)) {
+    LOG_ERROR(525, "Cannot open a page on an initialized account");
+    return ERROR_ACCOUNT_ALREADY_INITIALIZED;
+  }
+
+  // Pages live at the address derived from the poster and page number, so
+  // a poster cannot take over some other account as a page
+  AccountMetadata* meta = (AccountMetadata*)posterAccount->data;
+  SolPubkey expected;
+  pageAddress(posterAccount->key, meta->numPages + 1, params->program_id, &expected);
+  if(!SolPubkey_same(&expected, pageAccount->key)) {
+    LOG_ERROR(528, "The page account is not at the address derived from the poster and page number");
+    return ERROR_INVALID_ARGUMENT;
+  }
+
+  // The new page continues from the end of the newest page or account
+  uint64_t firstPost = meta->numPosts;
+  if(meta->numPages > 0) {
+    SolAccountInfo* tailAccount = &params->ka[2];
+    if(params->ka_num < 3 || !SolPubkey_same(tailAccount->owner, params->program_id) ||
+       !isPageOf(tailAccount, posterAccount->key) ||
+       ((UserPageMeta*)tailAccount->data)->page != meta->numPages) {
+      LOG_ERROR(526, "The third account must be the poster's newest page");
+      return ERROR_INVALID_ARGUMENT;
+    }
+    UserPageMeta* tail = (UserPageMeta*)tailAccount->data;
+    firstPost = (uint64_t)tail->firstPost + tail->numPosts;
+  }
+
+  UserPageMeta* page = (UserPageMeta*)pageAccount->data;
+  page->accountType = UserPage;
+  page->version = USER_VERSION_2;
+  page->reserved = 0;
+  page->owner = *posterAccount->key;
+  page->tailOffset = sizeof(UserPageMeta);
+  page->firstPost = firstPost;
+  page->page = meta->numPages + 1;
+  page->numPosts = 0;
+  page->reserved2 = 0;
+  meta->numPages += 1;
+
+  return SUCCESS;
+}
+
+// Returns the size of the rest of a version 1 record once upgraded
+uint64_t upgradedRecordLength(uint8_t* record) {
+  uint64_t length = *((uint16_t*)record);
+  uint8_t typeSelector = record[sizeof(uint16_t)] & ~(COUNTERS_FLAG | REDACTED_FLAG);
+  if(typeSelector == POST_SELECTOR) {
+    return length;
+  }
+  return length + sizeof(PostID) - sizeof(PostIDV1);
+}
+
+// Rewrites the version 1 record at data[from] as a version 2 record at
+// data[to], which must not be below from
+void upgradeRecord(uint8_t* data, uint64_t from, uint64_t to) {
+  uint8_t* record = &data[from];
+  uint64_t length = *((uint16_t*)record);
+  uint64_t newLength = upgradedRecordLength(record);
+  if(newLength == length) {
+    moveUp(&data[to], record, sizeof(uint16_t) + length);
+    return;
+  }
+
+  // Length, selector and counters stay in front of the widened PostID
+  uint64_t header = sizeof(uint16_t) + 1;
+  if(record[sizeof(uint16_t)] & COUNTERS_FLAG) {
+    header += sizeof(PostCounters);
+  }
+  PostID id;
+  readPostID(&record[header], sizeof(PostIDV1), &id);
+  uint64_t bodyOffset = header + sizeof(PostIDV1);
+  moveUp(&data[to + header + sizeof(PostID)], &record[bodyOffset],
+         sizeof(uint16_t) + length - bodyOffset);
+  sol_memcpy(&data[to + header], &id, sizeof(PostID));
+  moveUp(&data[to], record, header);
+  *((uint16_t*)&data[to]) = newLength;
+}
+
+/**
+ * Upgrades a version 1 user account to the version 2 layout in place
+ * 
+ * Expects 1 account parameter, which is the user to migrate. That
+ * user must have signed off on the transaction. Legacy accounts are
+ * indexed first, so there must be sizeof(PostSlot) free bytes per post.
+ * Records only grow and only move up, so they are rewritten from the
+ * last one down in a single pass over the index.
+ */
+uint64_t migrateUser(SolParameters* params)
+{
+  if(params->data_len != 1) {
+    LOG_ERROR(514, "No instruction data is necessary for this instruction");
+    return ERROR_INVALID_INSTRUCTION_DATA;
+  }
+
+  SolAccountInfo* userAccount = &params->ka[0];
+
+  if(!userAccount->is_signer) {
+    LOG_ERROR(515, "Users must sign off on migrating their account.");
+    return ERROR_MISSING_REQUIRED_SIGNATURES;
+  }
+
+  if(userAccount->data_len < USER_V1_HEADER_SIZE || !isInitialized(userAccount->data)) {
+    LOG_ERROR(516, "Cannot migrate an uninitialized account");
+    return ERROR_UNINITIALIZED_ACCOUNT;
+  }
+
+  uint8_t* data = userAccount->data;
+  uint64_t length = userAccount->data_len;
+  AccountMetadata* meta = (AccountMetadata*)data;
+  if(meta->accountType != User) {
+    LOG_ERROR(517, "Only user accounts can be migrated");
+    return ERROR_INVALID_ACCOUNT_DATA;
+  }
+
+  if(isCurrentUser(data)) {
+    LOG_ERROR(518, "This account is already migrated");
+    return ERROR_ACCOUNT_ALREADY_INITIALIZED;
+  }
+
+  uint64_t numPosts = meta->numPostsV1;
+  uint64_t tail = newPostOffset(data, length);
+  if(tail + numPosts * sizeof(PostSlot) > length) {
+    LOG_ERROR(519, "Account too small to hold the post index");
+    return ERROR_ACCOUNT_DATA_TOO_SMALL;
+  }
+
+  // Index every record of a legacy account in order
+  if(isLegacyUser(data)) {
+    uint64_t offset = USER_V1_HEADER_SIZE;
+    for(uint64_t i = 0; i < numPosts; i++) {
+      if(offset >= tail) {
+        LOG_ERROR(520, "Post count does not match the records in this account");
+        return ERROR_INVALID_ACCOUNT_DATA;
+      }
+      *postSlot(data, length, i) = offset;
+      offset += *((uint16_t*)&data[offset]) + sizeof(uint16_t);
+    }
+  }
+
+  // Lay the upgraded records out from the end of the new header. No
+  // record starts below its old offset, so none overwrites another
+  // record before that one has been moved.
+  uint64_t newTail = sizeof(AccountMetadata);
+  for(uint64_t i = 0; i < numPosts; i++) {
+    uint64_t offset = *postSlot(data, length, i);
+    if(offset == 0) {
+      continue;
+    }
+    uint64_t recordLength = sizeof(uint16_t) + upgradedRecordLength(&data[offset]);
+    if(offset < newTail) {
+      offset = newTail;
+    }
+    newTail = alignRecord(alignRecord(offset) + recordLength);
+  }
+  if(newTail + numPosts * sizeof(PostSlot) > length) {
+    LOG_ERROR(519, "Account too small to hold the post index");
+    return ERROR_ACCOUNT_DATA_TOO_SMALL;
+  }
+
+  // Rewrite the records from the last one down, packing each one right
+  // below the next and zeroing whatever is left between them
+  uint64_t next = newTail;
+  for(uint64_t i = numPosts; i > 0; i--) {
+    PostSlot* slot = postSlot(data, length, i - 1);
+    if(*slot == 0) {
+      continue;
+    }
+    uint64_t recordLength = sizeof(uint16_t) + upgradedRecordLength(&data[*slot]);
+    uint64_t offset = (next - recordLength) & ~(uint64_t)(RECORD_ALIGNMENT - 1);
+    upgradeRecord(data, *slot, offset);
+    sol_memset(&data[offset + recordLength], 0, next - offset - recordLength);
+    *slot = offset;
+    next = offset;
+  }
+  sol_memset(&data[USER_V1_HEADER_SIZE], 0, next - USER_V1_HEADER_SIZE);
+
+  meta->version = USER_VERSION_2;
+  meta->numPostsV1 = 0;
+  meta->numPosts = numPosts;
+  meta->numPages = 0;
+  meta->tailOffset = newTail;
+
+  return SUCCESS;
+}
+
+/*
+Reads the instruction data and the accounts its handler uses from the
+serialized input, allocating params->ka and the account offsets from
+heap. The rest of the heap is left for the handler.
+*/
+uint64_t readInput(const uint8_t* input, Arena* heap, SolParameters* params, InputReader* reader) {
+  // The serialized input starts with the number of accounts
+  uint64_t numAccounts = *(uint64_t*)input;
+  uint32_t* offsets = numAccounts <= HEAP_LENGTH / sizeof(uint32_t) ?
+                      arenaAlloc(heap, numAccounts * sizeof(uint32_t)) : NULL;
+
+  // Check to make sure that the number of account parameters hasn't exceeded the heap size
+  if(offsets == NULL) {
+    LOG_ERROR_64(105, "Too many account parameters, Got:", numAccounts, 0);
+    return ERROR_INVALID_ARGUMENT;
+  }
+
+  // Step over the accounts to the instruction data
+  uint64_t offset = sizeof(uint64_t);
+  for(uint64_t i = 0; i < numAccounts; i++) {
+    offsets[i] = offset;
+    if(input[offset] != NON_DUP_MARKER) {
+      offset += DUP_ACCOUNT_SIZE;
+      continue;
+    }
+    uint64_t dataLength = *(uint64_t*)&input[offset + ACCOUNT_DATA_LEN_OFFSET];
+    offset += ACCOUNT_DATA_LEN_OFFSET + sizeof(uint64_t) + dataLength + MAX_PERMITTED_DATA_INCREASE;
+    offset = ((offset + 7) & ~7ULL) + sizeof(uint64_t);
+  }
+
+  params->ka_num = numAccounts;
+  params->data_len = *(uint64_t*)&input[offset];
+  params->data = &input[offset + sizeof(uint64_t)];
+  params->program_id = (SolPubkey*)&input[offset + sizeof(uint64_t) + params->data_len];
+
+  // Parse only the accounts the handler reads from params->ka
+  reader->input = input;
+  reader->offsets = offsets;
+  reader->numParsed = params->data_len == 0 ? numAccounts : accountsUsed(params->data[0]);
+  if(reader->numParsed > numAccounts) {
+    reader->numParsed = numAccounts;
+  }
+  params->ka = arenaAlloc(heap, reader->numParsed * sizeof(SolAccountInfo));
+  if(params->ka == NULL) {
+    LOG_ERROR_64(105, "Too many account parameters, Got:", numAccounts, 0);
+    return ERROR_INVALID_ARGUMENT;
+  }
+  for(uint64_t i = 0; i < reader->numParsed; i++) {
+    readAccount(reader, i, &params->ka[i]);
+  }
+  return SUCCESS;
+}
+
+// Clock sysvar address, SysvarC1ock11111111111111111111111111111111
+static const SolPubkey clockSysvarId = {.x = {
+  6, 167, 213, 23, 24, 199, 116, 201, 40, 86, 99, 152, 105, 29, 94, 182,
+  139, 94, 184, 163, 155, 75, 109, 92, 115, 85, 91, 33, 0, 0, 0, 0
+}};
+
+// If the last account is the Clock sysvar, takes it off the instruction's
+// accounts and returns true with its slot in *slot
+bool takeClockSlot(SolParameters* params, const InputReader* reader, uint64_t* slot) {
+  if(params->ka_num < 2) {
+    return false;
+  }
+  SolAccountInfo buffer;
+  SolAccountInfo* last = instructionAccount(params, reader, params->ka_num - 1, &buffer);
+  if(!SolPubkey_same(last->key, &clockSysvarId) || last->data_len < sizeof(uint64_t)) {
+    return false;
+  }
+  // The slot is the first field of the Clock
+  *slot = *(uint64_t*)last->data;
+  params->ka_num--;
+  return true;
+}
+
 // Main function and entry point
-uint64_t helloworld(SolParameters *params) {
+// Dispatches an instruction, with whatever heap the accounts left over as
+// scratch space. reader is NULL when params->ka holds every account.
+uint64_t processInstruction(SolParameters *params, const InputReader* reader, Arena* scratch) {
   if (params->ka_num < 1) {
-    sol_log("No accounts were included in the instruction");
+    LOG_ERROR(101, "No accounts were included in the instruction");
     return ERROR_NOT_ENOUGH_ACCOUNT_KEYS;
   }
 
@@ -686,44 +2912,81 @@ uint64_t helloworld(SolParameters *params) {
 
   // The account must be owned by the program in order to modify its data
   if (!SolPubkey_same(userAccount->owner, params->program_id)) {
-    sol_log("user's account does not have the correct program id");
+    LOG_ERROR(102, "user's account does not have the correct program id");
     return ERROR_INCORRECT_PROGRAM_ID;
   }
 
+  // A Clock sysvar at the end stamps whatever posts the instruction writes
+  uint64_t clockSlot;
+  const uint64_t* stamp = takeClockSlot(params, reader, &clockSlot) ? &clockSlot : NULL;
+
   // Process the instruction
   switch(*params->data) {
   case POST_SELECTOR:
   case REPLY_SELECTOR:
   case LIKE_SELECTOR:
   case REPORT_SELECTOR:
-    return processPost(params);
+  case POST_SELECTOR | COUNTERS_FLAG:
+  case REPLY_SELECTOR | COUNTERS_FLAG:
+  case REPORT_SELECTOR | COUNTERS_FLAG:
+  case COMPRESSED_POST_SELECTOR:
+  case COMPRESSED_REPLY_SELECTOR:
+  case COMPRESSED_REPORT_SELECTOR:
+  case COMPRESSED_POST_SELECTOR | COUNTERS_FLAG:
+  case COMPRESSED_REPLY_SELECTOR | COUNTERS_FLAG:
+  case COMPRESSED_REPORT_SELECTOR | COUNTERS_FLAG:
+    return processPost(params, stamp);
+  case BATCH_SELECTOR:
+    return processBatch(params, stamp);
   case VOTE_SELECTOR:
     return processVote(params);
   case CREATE_PETITION_SELECTOR:
     return createPetition(params);
   case PROCESS_PETITION_SELECTOR:
-    return processPetitionOutcome(params);
+    return processPetitionOutcome(params, reader, scratch);
+  case CLAIM_REWARD_SELECTOR:
+    return claimPetitionReward(params);
+  case CREATE_POOL_SELECTOR:
+    return createPetitionPool(params);
+  case CREATE_SHARD_SELECTOR:
+    return createCounterShard(params);
+  case COMPACT_SELECTOR:
+    return compactPosts(params);
   case SET_USERNAME_SELECTOR:
     return setUsername(params);
+  case MIGRATE_SELECTOR:
+    return migrateUser(params);
+  case OPEN_PAGE_SELECTOR:
+    return openPage(params);
   default:
-    sol_log("Invalid instruction selector");
+    LOG_ERROR(103, "Invalid instruction selector");
     return ERROR_INVALID_INSTRUCTION_DATA;
   }
 }
 
-extern uint64_t entrypoint(const uint8_t *input) {
-  sol_log("Solana Forum C program entrypoint");
+#ifndef __bpf__
+// Tests and native tools build SolParameters themselves and have no
+// program heap, so their scratch space is a static buffer of the same size
+uint8_t hostHeap[HEAP_LENGTH];
 
-  SolParameters params = (SolParameters){.ka = (SolAccountInfo*)HEAP_START_ADDRESS};
+uint64_t helloworld(SolParameters *params) {
+  Arena scratch;
+  arenaInit(&scratch, hostHeap, sizeof(hostHeap));
+  return processInstruction(params, NULL, &scratch);
+}
+#endif
 
-  if (!sol_deserialize(input, &params, HEAP_LENGTH / sizeof(SolAccountInfo))) {
-    return ERROR_INVALID_ARGUMENT;
-  }
+extern uint64_t entrypoint(const uint8_t *input) {
+  LOG_DEBUG("Solana Forum C program entrypoint");
 
-  // Check to make sure that the number of account parameters hasn't exceeded the heap size
-  if(params.ka_num > (HEAP_LENGTH / sizeof(SolAccountInfo))) {
-    return ERROR_INVALID_ARGUMENT;
+  Arena heap;
+  arenaInit(&heap, (uint8_t*)HEAP_START_ADDRESS, HEAP_LENGTH);
+  SolParameters params;
+  InputReader reader;
+  uint64_t result = readInput(input, &heap, &params, &reader);
+  if(result != SUCCESS) {
+    return result;
   }
 
-  return helloworld(&params);
+  return processInstruction(&params, &reader, &heap);
 }
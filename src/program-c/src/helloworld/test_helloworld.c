@@ -25,19 +25,19 @@ Test(hello, sanity) {
   SolParameters params = {accounts, sizeof(accounts) / sizeof(accounts[0]), instruction_data,
                           sizeof(instruction_data), &program_id};
 
-  // Check offset calculation on blank account
-  cr_assert(sizeof(AccountMetadata) == newPostOffset(data, sizeof(data)));
+  // Check offset calculation on blank account, which reads as version 1
+  cr_assert(USER_V1_HEADER_SIZE == newPostOffset(data, sizeof(data)));
 
   // Check posting and offset calculation
   cr_assert(SUCCESS == helloworld(&params));
-  cr_assert(sizeof(AccountMetadata) + sizeof(instruction_data) + sizeof(uint16_t) 
+  cr_assert(sizeof(AccountMetadata) + alignRecord(sizeof(instruction_data) + sizeof(uint16_t))
             == newPostOffset(data, sizeof(data)));
   Post p;
   cr_assert(sizeof(uint16_t) + sizeof(instruction_data) == parsePost(instruction_data, sizeof(instruction_data), &p));
   AccountMetadata* d = (AccountMetadata*)data;
   cr_assert(1 == d->numPosts);
   cr_assert(SUCCESS == helloworld(&params));
-  cr_assert(sizeof(AccountMetadata) + (sizeof(instruction_data) + sizeof(uint16_t)) * 2
+  cr_assert(sizeof(AccountMetadata) + alignRecord(sizeof(instruction_data) + sizeof(uint16_t)) * 2
             == newPostOffset(data, sizeof(data)));
   cr_assert(2 == d->numPosts);
 }
@@ -59,7 +59,7 @@ Test(hello, reply) {
 
   // Setup account data
   uint64_t lamports = 1;
-  uint8_t data[100] = {0};
+  uint8_t data[128] = {0};
   AccountMetadata* meta = (AccountMetadata*)data;
   initializeUserAccount(data, sizeof(data));
   uint16_t firstPostLength = 5;
@@ -150,12 +150,12 @@ Test(hello, petitionVoteFail) {
   SolParameters params = {accounts, sizeof(accounts) / sizeof(accounts[0]), instruction_data,
                           sizeof(instruction_data), &program_id};
 
-  // Check offset calculation on blank account
-  cr_assert(sizeof(AccountMetadata) == newPostOffset(data, sizeof(data)));
+  // Check offset calculation on blank account, which reads as version 1
+  cr_assert(USER_V1_HEADER_SIZE == newPostOffset(data, sizeof(data)));
 
   // Check posting and offset calculation
   cr_assert(SUCCESS == helloworld(&params));
-  cr_assert(sizeof(AccountMetadata) + sizeof(instruction_data) + sizeof(uint16_t) 
+  cr_assert(sizeof(AccountMetadata) + alignRecord(sizeof(instruction_data) + sizeof(uint16_t))
             == newPostOffset(data, sizeof(data)));
   Post p;
   cr_assert(sizeof(uint16_t) + sizeof(instruction_data) == parsePost(instruction_data, sizeof(instruction_data), &p));
@@ -163,7 +163,7 @@ Test(hello, petitionVoteFail) {
   d->reputation = 5;
   cr_assert(1 == d->numPosts);
   cr_assert(SUCCESS == helloworld(&params));
-  cr_assert(sizeof(AccountMetadata) + (sizeof(instruction_data) + sizeof(uint16_t)) * 2
+  cr_assert(sizeof(AccountMetadata) + alignRecord(sizeof(instruction_data) + sizeof(uint16_t)) * 2
             == newPostOffset(data, sizeof(data)));
   cr_assert(2 == d->numPosts);
 
@@ -172,7 +172,7 @@ Test(hello, petitionVoteFail) {
   SolPubkey petitionKey = { .x = { 3, }};
   PostID offender = { .poster = key, .index = 0 };
   // The petition holds 1 signature
-  uint8_t petitionData[sizeof(PetitionAccountMeta) + (1 * sizeof(PetitionSignature))] = { 0 };
+  uint8_t petitionData[PETITION_ACCOUNT_SIZE(1)] = { 0 };
   initializePetitionAccount(petitionData, sizeof(petitionData), &offender, data, sizeof(data));
   // Vote on the petition
   SolAccountInfo voteAccounts[] = {
@@ -230,19 +230,19 @@ Test(hello, petitionVoteSucceed) {
   SolParameters params = {accounts, sizeof(accounts) / sizeof(accounts[0]), instruction_data,
                           sizeof(instruction_data), &program_id};
 
-  // Check offset calculation on blank account
-  cr_assert(sizeof(AccountMetadata) == newPostOffset(data, sizeof(data)));
+  // Check offset calculation on blank account, which reads as version 1
+  cr_assert(USER_V1_HEADER_SIZE == newPostOffset(data, sizeof(data)));
 
   // Check posting and offset calculation
   cr_assert(SUCCESS == helloworld(&params));
-  cr_assert(sizeof(AccountMetadata) + sizeof(instruction_data) + sizeof(uint16_t) 
+  cr_assert(sizeof(AccountMetadata) + alignRecord(sizeof(instruction_data) + sizeof(uint16_t))
             == newPostOffset(data, sizeof(data)));
   Post p;
   cr_assert(sizeof(uint16_t) + sizeof(instruction_data) == parsePost(instruction_data, sizeof(instruction_data), &p));
   AccountMetadata* d = (AccountMetadata*)data;
   cr_assert(1 == d->numPosts);
   cr_assert(SUCCESS == helloworld(&params));
-  cr_assert(sizeof(AccountMetadata) + (sizeof(instruction_data) + sizeof(uint16_t)) * 2
+  cr_assert(sizeof(AccountMetadata) + alignRecord(sizeof(instruction_data) + sizeof(uint16_t)) * 2
             == newPostOffset(data, sizeof(data)));
   cr_assert(2 == d->numPosts);
 
@@ -251,7 +251,7 @@ Test(hello, petitionVoteSucceed) {
   SolPubkey petitionKey = { .x = { 3, }};
   PostID offender = { .poster = key, .index = 0 };
   // The petition holds 1 signature
-  uint8_t petitionData[sizeof(PetitionAccountMeta) + (1 * sizeof(PetitionSignature))] = { 0 };
+  uint8_t petitionData[PETITION_ACCOUNT_SIZE(1)] = { 0 };
   initializePetitionAccount(petitionData, sizeof(petitionData), &offender, data, sizeof(data));
   // Vote on the petition
   SolAccountInfo voteAccounts[] = {
@@ -287,7 +287,7 @@ Test(hello, petitionVoteSucceed) {
 }
 
 Test(hello, createPetition) {
-  uint8_t instruction_data[] = { 'C', 0, 0 };
+  uint8_t instruction_data[] = { 'C', 0, 0, 0, 0 };
   SolPubkey program_id = {.x = {
                               1,
                           }};
@@ -336,4 +336,1630 @@ Test(hello, createPetition) {
   cr_assert(SolPubkey_same(&offenderKey, &meta->offendingPost.poster));
   sol_log("Offsets of username, numPosts:");
   sol_log_64(OFFSETOF(AccountMetadata, username), OFFSETOF(AccountMetadata, numPosts), sizeof(AccountMetadata), 4, 5);
-}
\ No newline at end of file
+}
+Test(hello, postIndex) {
+  SolPubkey program_id = {.x = {
+                              1,
+                          }};
+  SolPubkey key = {.x = {
+                       2,
+                   }};
+  uint64_t lamports = 1;
+  uint8_t data[128] = {0};
+  SolAccountInfo accounts[] = {{
+      &key,
+      &lamports,
+      sizeof(data),
+      data,
+      &program_id,
+      0,
+      true,
+      true,
+      false,
+  }};
+  SolParameters firstParams = {accounts, SOL_ARRAY_SIZE(accounts), (unsigned char*)"Pfirst",
+                               6, &program_id};
+  SolParameters secondParams = {accounts, SOL_ARRAY_SIZE(accounts), (unsigned char*)"Psecond",
+                                7, &program_id};
+  cr_assert(SUCCESS == helloworld(&firstParams));
+  cr_assert(SUCCESS == helloworld(&secondParams));
+
+  // Each post is indexed from the end of the account
+  AccountMetadata* meta = (AccountMetadata*)data;
+  cr_assert(meta->numPosts == 2);
+  cr_assert(postOffset(data, sizeof(data), 0) == sizeof(AccountMetadata));
+  cr_assert(postOffset(data, sizeof(data), 1) == sizeof(AccountMetadata) + alignRecord(6 + sizeof(uint16_t)));
+  cr_assert(*postSlot(data, sizeof(data), 1) == postOffset(data, sizeof(data), 1));
+  cr_assert(meta->tailOffset == alignRecord(postOffset(data, sizeof(data), 1) + 7 + sizeof(uint16_t)));
+  cr_assert(meta->tailOffset % RECORD_ALIGNMENT == 0);
+  cr_assert(data[postOffset(data, sizeof(data), 1) + sizeof(uint16_t)] == 'P');
+  cr_assert(postDataEnd(data, sizeof(data)) == sizeof(data) - 2 * sizeof(PostSlot));
+
+  // Posts may not overwrite the index
+  uint8_t longPost[sizeof(data) - sizeof(AccountMetadata)] = { 'P' };
+  SolParameters longParams = {accounts, SOL_ARRAY_SIZE(accounts), longPost,
+                              sizeof(data) - meta->tailOffset - 2 * sizeof(PostSlot) - sizeof(uint16_t), &program_id};
+  cr_assert(ERROR_ACCOUNT_DATA_TOO_SMALL == helloworld(&longParams));
+  longParams.data_len -= sizeof(PostSlot);
+  cr_assert(SUCCESS == helloworld(&longParams));
+  cr_assert(meta->tailOffset == postDataEnd(data, sizeof(data)));
+}
+
+// Writes a record to a version 1 account and returns the offset after it
+uint64_t writeRecordV1(uint8_t* data, uint64_t offset, const uint8_t* record, uint16_t length) {
+  sol_memcpy(&data[offset], &length, sizeof(uint16_t));
+  sol_memcpy(&data[offset + sizeof(uint16_t)], record, length);
+  return offset + sizeof(uint16_t) + length;
+}
+
+Test(hello, migrateLegacy) {
+  SolPubkey program_id = {.x = {
+                              1,
+                          }};
+  SolPubkey key = {.x = {
+                       2,
+                   }};
+  uint64_t lamports = 1;
+  uint8_t data[256] = {0};
+  // Build an account in the legacy layout: a post, a like of it and a
+  // counted report of it, with 16-bit PostIDs and no index
+  AccountMetadata* meta = (AccountMetadata*)data;
+  meta->accountType = User;
+  meta->version = USER_VERSION_1;
+  meta->reputation = 5;
+  meta->numPostsV1 = 3;
+  PostIDV1 target = { .poster = key, .index = 0 };
+  uint8_t like[1 + sizeof(PostIDV1)] = { 'L' };
+  sol_memcpy(&like[1], &target, sizeof(PostIDV1));
+  uint8_t report[1 + sizeof(PostCounters) + sizeof(PostIDV1) + 4] = { 'X' | COUNTERS_FLAG };
+  PostCounters counters = { .likes = 1, .replies = 2, .reports = 3 };
+  sol_memcpy(&report[1], &counters, sizeof(PostCounters));
+  sol_memcpy(&report[1 + sizeof(PostCounters)], &target, sizeof(PostIDV1));
+  sol_memcpy(&report[1 + sizeof(PostCounters) + sizeof(PostIDV1)], "spam", 4);
+  uint64_t offset = writeRecordV1(data, USER_V1_HEADER_SIZE, (const uint8_t*)"Ptest", 5);
+  offset = writeRecordV1(data, offset, like, sizeof(like));
+  writeRecordV1(data, offset, report, sizeof(report));
+  SolAccountInfo accounts[] = {{
+      &key,
+      &lamports,
+      sizeof(data),
+      data,
+      &program_id,
+      0,
+      true,
+      true,
+      false,
+  }};
+  cr_assert(isLegacyUser(data));
+  cr_assert(!isCurrentUser(data));
+  cr_assert(postOffset(data, sizeof(data), 1) == USER_V1_HEADER_SIZE + 7);
+  cr_assert(postCounters(data, sizeof(data), 2)->replies == 2);
+
+  // Version 1 accounts can't take new posts until migrated
+  SolParameters postParams = {accounts, SOL_ARRAY_SIZE(accounts), (unsigned char*)"Pnew",
+                              4, &program_id};
+  cr_assert(ERROR_INVALID_ACCOUNT_DATA == helloworld(&postParams));
+
+  SolParameters migrateParams = {accounts, SOL_ARRAY_SIZE(accounts), (unsigned char*)"M",
+                                 1, &program_id};
+  cr_assert(SUCCESS == helloworld(&migrateParams));
+  cr_assert(isCurrentUser(data));
+  cr_assert(!isLegacyUser(data));
+  cr_assert(meta->numPosts == 3);
+  cr_assert(meta->numPostsV1 == 0);
+  cr_assert(meta->reputation == 5);
+
+  // Records are widened and realigned behind the longer header
+  cr_assert(postOffset(data, sizeof(data), 0) == sizeof(AccountMetadata));
+  cr_assert(postOffset(data, sizeof(data), 1) == sizeof(AccountMetadata) + 8);
+  cr_assert(postOffset(data, sizeof(data), 2) == sizeof(AccountMetadata) + 8 + 40);
+  cr_assert(meta->tailOffset == sizeof(AccountMetadata) + 8 + 40 + 56);
+  cr_assert(data[sizeof(AccountMetadata) + 7] == 0);
+  Post p;
+  offset = postOffset(data, sizeof(data), 0);
+  cr_assert(parsePost(&data[offset + sizeof(uint16_t)], *((uint16_t*)&data[offset]), &p) != 0);
+  cr_assert(p.typeSelector == POST_SELECTOR && sol_memcmp(p.body.immutable, "test", 4) == 0);
+  offset = postOffset(data, sizeof(data), 1);
+  cr_assert(parsePost(&data[offset + sizeof(uint16_t)], *((uint16_t*)&data[offset]), &p) != 0);
+  cr_assert(p.typeSelector == LIKE_SELECTOR && p.id.index == 0 && SolPubkey_same(&p.id.poster, &key));
+  offset = postOffset(data, sizeof(data), 2);
+  cr_assert(parsePost(&data[offset + sizeof(uint16_t)], *((uint16_t*)&data[offset]), &p) != 0);
+  cr_assert(p.typeSelector == REPORT_SELECTOR && p.hasCounters && p.id.index == 0);
+  cr_assert(p.bodyLength == 4 && sol_memcmp(p.body.immutable, "spam", 4) == 0);
+  cr_assert(postCounters(data, sizeof(data), 2)->reports == 3);
+  cr_assert(ERROR_ACCOUNT_ALREADY_INITIALIZED == helloworld(&migrateParams));
+
+  cr_assert(SUCCESS == helloworld(&postParams));
+  cr_assert(meta->numPosts == 4);
+  cr_assert(postOffset(data, sizeof(data), 3) == sizeof(AccountMetadata) + 8 + 40 + 56);
+}
+
+Test(hello, migrateIndexed) {
+  SolPubkey program_id = {.x = {
+                              1,
+                          }};
+  SolPubkey key = {.x = {
+                       2,
+                   }};
+  uint64_t lamports = 1;
+  uint8_t data[256] = {0};
+  // An indexed version 1 account after compaction: a tombstone, then a
+  // reply stored past a gap
+  AccountMetadata* meta = (AccountMetadata*)data;
+  meta->accountType = User;
+  meta->version = USER_VERSION_1;
+  meta->reputation = 5;
+  meta->numPostsV1 = 3;
+  PostIDV1 target = { .poster = key, .index = 1 };
+  uint8_t reply[1 + sizeof(PostIDV1) + 5] = { 'R' };
+  sol_memcpy(&reply[1], &target, sizeof(PostIDV1));
+  sol_memcpy(&reply[1 + sizeof(PostIDV1)], "Reply", 5);
+  uint64_t offset = writeRecordV1(data, USER_V1_HEADER_SIZE, (const uint8_t*)"Pfirst", 6);
+  *postSlot(data, sizeof(data), 0) = USER_V1_HEADER_SIZE;
+  *postSlot(data, sizeof(data), 1) = 0;
+  *postSlot(data, sizeof(data), 2) = offset + 3;
+  meta->tailOffset = writeRecordV1(data, offset + 3, reply, sizeof(reply));
+  SolAccountInfo accounts[] = {{
+      &key,
+      &lamports,
+      sizeof(data),
+      data,
+      &program_id,
+      0,
+      true,
+      true,
+      false,
+  }};
+
+  // Version 1 records can still be redacted in place
+  redactPost(&accounts[0], 2);
+  cr_assert(data[offset + 3 + sizeof(uint16_t)] == ('R' | REDACTED_FLAG));
+  cr_assert(sol_memcmp(&data[offset + 3 + sizeof(uint16_t) + 1 + sizeof(PostIDV1)], "xxxxx", 5) == 0);
+
+  SolParameters migrateParams = {accounts, SOL_ARRAY_SIZE(accounts), (unsigned char*)"M",
+                                 1, &program_id};
+  cr_assert(SUCCESS == helloworld(&migrateParams));
+  cr_assert(meta->numPosts == 3);
+  cr_assert(postOffset(data, sizeof(data), 0) == sizeof(AccountMetadata));
+  cr_assert(postOffset(data, sizeof(data), 1) == 0);
+  offset = postOffset(data, sizeof(data), 2);
+  cr_assert(offset % RECORD_ALIGNMENT == 0);
+  cr_assert(offset >= sizeof(AccountMetadata) + 8);
+  cr_assert(meta->tailOffset == alignRecord(offset + sizeof(uint16_t) + sizeof(reply) + 2));
+  Post p;
+  cr_assert(parsePost(&data[offset + sizeof(uint16_t)], *((uint16_t*)&data[offset]), &p) != 0);
+  cr_assert(p.typeSelector == REPLY_SELECTOR && p.id.index == 1 && SolPubkey_same(&p.id.poster, &key));
+  cr_assert(p.bodyLength == 5 && sol_memcmp(p.body.immutable, "xxxxx", 5) == 0);
+  // Nothing is left of the old records between the upgraded ones
+  for(uint64_t i = sizeof(AccountMetadata) + 8; i < offset; i++) {
+    cr_assert(data[i] == 0);
+  }
+}
+
+Test(hello, batch) {
+  SolPubkey program_id = {.x = {
+                              1,
+                          }};
+  SolPubkey key = {.x = {
+                       2,
+                   }};
+  SolPubkey petitionKey = {.x = {
+                       3,
+                   }};
+  uint64_t lamports = 1;
+  uint8_t data[512] = {0};
+  // Petition against a post that another account made
+  uint8_t offenderData[128] = {0};
+  initializeUserAccount(offenderData, sizeof(offenderData));
+  PostID offender = { .poster = petitionKey, .index = 0 };
+  uint8_t petitionData[PETITION_ACCOUNT_SIZE(2)] = { 0 };
+  initializePetitionAccount(petitionData, sizeof(petitionData), &offender, offenderData, sizeof(offenderData));
+  SolAccountInfo accounts[] = {
+    {
+      &key,
+      &lamports,
+      sizeof(data),
+      data,
+      &program_id,
+      0,
+      true,
+      true,
+      false,
+    },
+    {
+      &petitionKey,
+      &lamports,
+      sizeof(petitionData),
+      petitionData,
+      &program_id,
+      0,
+      false,
+      true,
+      false,
+    }
+  };
+
+  // Post, like it twice, reply to it and vote on the petition
+  uint8_t batch[256] = { 'B' };
+  uint64_t length = 1;
+  PostID first = { .poster = key, .index = 0 };
+  uint16_t opLength = 5;
+  sol_memcpy(&batch[length], &opLength, sizeof(uint16_t));
+  sol_memcpy(&batch[length + sizeof(uint16_t)], "Ptest", opLength);
+  length += sizeof(uint16_t) + opLength;
+  for(int i = 0; i < 2; i++) {
+    opLength = 1 + sizeof(PostID);
+    sol_memcpy(&batch[length], &opLength, sizeof(uint16_t));
+    batch[length + sizeof(uint16_t)] = 'L';
+    sol_memcpy(&batch[length + sizeof(uint16_t) + 1], &first, sizeof(PostID));
+    length += sizeof(uint16_t) + opLength;
+  }
+  opLength = 1 + sizeof(PostID) + 5;
+  sol_memcpy(&batch[length], &opLength, sizeof(uint16_t));
+  batch[length + sizeof(uint16_t)] = 'R';
+  sol_memcpy(&batch[length + sizeof(uint16_t) + 1], &first, sizeof(PostID));
+  sol_memcpy(&batch[length + sizeof(uint16_t) + 1 + sizeof(PostID)], "Reply", 5);
+  length += sizeof(uint16_t) + opLength;
+  uint8_t vote[] = { 'V', 1, 1 };
+  opLength = sizeof(vote);
+  sol_memcpy(&batch[length], &opLength, sizeof(uint16_t));
+  sol_memcpy(&batch[length + sizeof(uint16_t)], vote, sizeof(vote));
+  length += sizeof(uint16_t) + opLength;
+
+  SolParameters params = {accounts, SOL_ARRAY_SIZE(accounts), batch, length, &program_id};
+  cr_assert(SUCCESS == helloworld(&params));
+  AccountMetadata* meta = (AccountMetadata*)data;
+  cr_assert(meta->numPosts == 4);
+  cr_assert(data[postOffset(data, sizeof(data), 1) + sizeof(uint16_t)] == 'L');
+  cr_assert(data[postOffset(data, sizeof(data), 3) + sizeof(uint16_t)] == 'R');
+  PetitionAccountMeta* petition = (PetitionAccountMeta*)petitionData;
+  cr_assert(petition->numSignatures == 1);
+
+  // Voting twice in the same petition fails the whole batch
+  cr_assert(ERROR_INVALID_INSTRUCTION_DATA == helloworld(&params));
+
+  // Only posts and votes may be batched, and votes must name a petition
+  uint8_t badBatch[] = { 'B', 3, 0, 'C', 0, 0 };
+  SolParameters badParams = {accounts, SOL_ARRAY_SIZE(accounts), badBatch, sizeof(badBatch), &program_id};
+  cr_assert(ERROR_INVALID_INSTRUCTION_DATA == helloworld(&badParams));
+  uint8_t selfVote[] = { 'B', 3, 0, 'V', 1, 0 };
+  badParams.data = selfVote;
+  cr_assert(ERROR_INVALID_INSTRUCTION_DATA == helloworld(&badParams));
+  uint8_t truncated[] = { 'B', 9, 0, 'P', 'x' };
+  badParams.data = truncated;
+  badParams.data_len = sizeof(truncated);
+  cr_assert(ERROR_INVALID_INSTRUCTION_DATA == helloworld(&badParams));
+}
+
+Test(hello, petitionHashTable) {
+  SolPubkey program_id = {.x = {
+                              1,
+                          }};
+  SolPubkey offenderKey = {.x = {
+                       2,
+                   }};
+  SolPubkey petitionKey = {.x = {
+                       3,
+                   }};
+  uint64_t lamports = 1;
+  uint8_t offenderData[128] = {0};
+  initializeUserAccount(offenderData, sizeof(offenderData));
+  uint8_t petitionData[PETITION_ACCOUNT_SIZE(4)] = {0};
+  uint8_t createData[] = { 'C', 0, 0, 0, 0 };
+  SolAccountInfo createAccounts[] = {
+    {
+      &petitionKey,
+      &lamports,
+      sizeof(petitionData),
+      petitionData,
+      &program_id,
+      0,
+      true,
+      true,
+      false,
+    },
+    {
+      &offenderKey,
+      &lamports,
+      sizeof(offenderData),
+      offenderData,
+      &program_id,
+      0,
+      false,
+      true,
+      false,
+    }
+  };
+  SolParameters createParams = {createAccounts, SOL_ARRAY_SIZE(createAccounts), createData,
+                                sizeof(createData), &program_id};
+  cr_assert(SUCCESS == helloworld(&createParams));
+  PetitionAccountMeta* petition = (PetitionAccountMeta*)petitionData;
+  cr_assert(petition->hashSlots == 4 * HASH_SLOTS_PER_SIGNATURE);
+  cr_assert(petitionCapacity(petitionData, sizeof(petitionData)) == 4);
+
+  // Voters share their leading bytes so they all hash to the same slot
+  SolPubkey voterKeys[4];
+  uint8_t voterData[4][64];
+  for(int i = 0; i < 4; i++) {
+    sol_memset(&voterKeys[i], 0, sizeof(SolPubkey));
+    voterKeys[i].x[31] = i + 1;
+    sol_memset(voterData[i], 0, sizeof(voterData[i]));
+    initializeUserAccount(voterData[i], sizeof(voterData[i]));
+  }
+  uint8_t voteData[] = { 'V', 1 };
+  for(int i = 0; i < 4; i++) {
+    SolAccountInfo voteAccounts[] = {
+      {
+        &voterKeys[i],
+        &lamports,
+        sizeof(voterData[i]),
+        voterData[i],
+        &program_id,
+        0,
+        true,
+        true,
+        false,
+      },
+      createAccounts[0]
+    };
+    SolParameters voteParams = {voteAccounts, SOL_ARRAY_SIZE(voteAccounts), voteData,
+                                sizeof(voteData), &program_id};
+    cr_assert(!hasVoted(&voteAccounts[0], &voteAccounts[1]));
+    cr_assert(SUCCESS == helloworld(&voteParams));
+    cr_assert(hasVoted(&voteAccounts[0], &voteAccounts[1]));
+    // Duplicates are rejected until the petition fills up
+    cr_assert((i < 3 ? ERROR_INVALID_INSTRUCTION_DATA : ERROR_INVALID_ACCOUNT_DATA) == helloworld(&voteParams));
+  }
+  cr_assert(petition->numSignatures == 4);
+  cr_assert(SolPubkey_same(&*petitionSigner(petitionData, 3), &voterKeys[3]));
+
+  // Legacy petitions without a table still detect duplicates
+  uint8_t legacyData[sizeof(PetitionAccountMeta) + 2 * sizeof(PetitionSignature)] = {0};
+  PetitionAccountMeta* legacy = (PetitionAccountMeta*)legacyData;
+  legacy->accountType = Petition;
+  legacy->numSignatures = 1;
+  petitionSignatures(legacyData)[0].signer = voterKeys[1];
+  SolAccountInfo legacyAccount = createAccounts[0];
+  legacyAccount.data = legacyData;
+  legacyAccount.data_len = sizeof(legacyData);
+  SolAccountInfo voter = createAccounts[1];
+  voter.key = &voterKeys[1];
+  cr_assert(petitionCapacity(legacyData, sizeof(legacyData)) == 2);
+  cr_assert(hasVoted(&voter, &legacyAccount));
+  voter.key = &voterKeys[2];
+  cr_assert(!hasVoted(&voter, &legacyAccount));
+
+  // Settlement finds each voter's vote through the table, or by scanning a
+  // legacy petition, whatever order the voters are given in
+  uint64_t heap[8];
+  Arena scratch;
+  uint64_t* votes;
+  SolAccountInfo voters[4];
+  for(int i = 0; i < 4; i++) {
+    voters[i] = createAccounts[1];
+    voters[i].key = &voterKeys[3 - i];
+  }
+  SolParameters settleParams = {voters, SOL_ARRAY_SIZE(voters), (unsigned char*)"F", 1, &program_id};
+  arenaInit(&scratch, (uint8_t*)heap, sizeof(heap));
+  cr_assert(SUCCESS == readPetitionVoters(&settleParams, NULL, petitionData, 0, &scratch, &votes));
+  cr_assert(votes[0] == 0xf);
+  legacy->numSignatures = 2;
+  petitionSignatures(legacyData)[0] = (PetitionSignature){ .signer = voterKeys[0], .vote = 1 };
+  petitionSignatures(legacyData)[1] = (PetitionSignature){ .signer = voterKeys[1], .vote = 0 };
+  settleParams.ka = &voters[2];
+  settleParams.ka_num = 2;
+  arenaInit(&scratch, (uint8_t*)heap, sizeof(heap));
+  cr_assert(SUCCESS == readPetitionVoters(&settleParams, NULL, legacyData, 0, &scratch, &votes));
+  cr_assert(votes[0] == 2);
+  voters[3].key = &voterKeys[2];
+  cr_assert(ERROR_INVALID_ARGUMENT == readPetitionVoters(&settleParams, NULL, legacyData, 0, &scratch, &votes));
+  // A petition too large for the scratch space left is refused
+  arenaInit(&scratch, (uint8_t*)heap, 8);
+  cr_assert(ERROR_ACCOUNT_DATA_TOO_SMALL == readPetitionVoters(&settleParams, NULL, petitionData, 0, &scratch, &votes));
+}
+
+Test(hello, petitionColumns) {
+  uint8_t offenderData[128] = {0};
+  initializeUserAccount(offenderData, sizeof(offenderData));
+  SolPubkey offenderKey = {.x = {
+                       2,
+                   }};
+  PostID offender = { .poster = offenderKey, .index = 0 };
+
+  // Votes span more than one bitset word
+  uint8_t petitionData[PETITION_ACCOUNT_SIZE(70)] = {0};
+  initializePetitionAccount(petitionData, sizeof(petitionData), &offender, offenderData, sizeof(offenderData));
+  PetitionAccountMeta* petition = (PetitionAccountMeta*)petitionData;
+  cr_assert(petition->layout == PETITION_LAYOUT_V2);
+  cr_assert(petitionCapacity(petitionData, sizeof(petitionData)) == 70);
+  cr_assert(signatureCapacity(sizeof(petitionData) - 1) == 69);
+  // Signer keys and packed votes take less room than PetitionSignature records
+  cr_assert(PETITION_ACCOUNT_SIZE(70) - sizeof(PetitionAccountMeta) <
+            70 * (sizeof(PetitionSignature) + HASH_SLOTS_PER_SIGNATURE * sizeof(PetitionHashSlot)));
+
+  int64_t expectedTally = 0;
+  for(uint64_t i = 0; i < 70; i++) {
+    SolPubkey signer = {.x = { i + 10, }};
+    bool vote = i % 3 == 0;
+    appendSignature(petitionData, &signer, vote);
+    expectedTally += vote ? 1 : -1;
+  }
+  cr_assert(petition->numSignatures == 70);
+  cr_assert(petitionTally(petitionData) == expectedTally);
+  for(uint64_t i = 0; i < 70; i++) {
+    cr_assert(petitionVote(petitionData, i) == (i % 3 == 0));
+    cr_assert(petitionSigner(petitionData, i)->x[0] == i + 10);
+  }
+  cr_assert(countBits(petitionVoteBits(petitionData)[0]) == 22);
+  cr_assert(countBits(petitionVoteBits(petitionData)[1]) == 2);
+}
+
+Test(hello, petitionSettlement) {
+  SolPubkey program_id = {.x = {
+                              1,
+                          }};
+  SolPubkey offenderKey = {.x = {
+                       2,
+                   }};
+  SolPubkey petitionKey = {.x = {
+                       3,
+                   }};
+  uint64_t lamports = 1;
+  uint8_t offenderData[128] = {0};
+  SolAccountInfo offenderAccount = {
+      &offenderKey,
+      &lamports,
+      sizeof(offenderData),
+      offenderData,
+      &program_id,
+      0,
+      true,
+      true,
+      false,
+  };
+  SolParameters postParams = {&offenderAccount, 1, (unsigned char*)"Pspam", 5, &program_id};
+  cr_assert(SUCCESS == helloworld(&postParams));
+
+  uint8_t petitionData[PETITION_ACCOUNT_SIZE(3)] = {0};
+  PostID offender = { .poster = offenderKey, .index = 0 };
+  initializePetitionAccount(petitionData, sizeof(petitionData), &offender, offenderData, sizeof(offenderData));
+  PetitionAccountMeta* petition = (PetitionAccountMeta*)petitionData;
+
+  SolPubkey voterKeys[3] = {{.x = { 4, }}, {.x = { 5, }}, {.x = { 6, }}};
+  uint8_t voterData[3][64] = {{0}};
+  SolAccountInfo accounts[5] = {
+    {
+      &petitionKey,
+      &lamports,
+      sizeof(petitionData),
+      petitionData,
+      &program_id,
+      0,
+      false,
+      true,
+      false,
+    },
+    offenderAccount,
+  };
+  uint8_t votes[] = { 1, 1, 0 };
+  for(int i = 0; i < 3; i++) {
+    initializeUserAccount(voterData[i], sizeof(voterData[i]));
+    accounts[2 + i] = offenderAccount;
+    accounts[2 + i].key = &voterKeys[i];
+    accounts[2 + i].data = voterData[i];
+    accounts[2 + i].data_len = sizeof(voterData[i]);
+    SolAccountInfo voteAccounts[] = { accounts[2 + i], accounts[0] };
+    uint8_t voteData[] = { 'V', votes[i] };
+    SolParameters voteParams = {voteAccounts, SOL_ARRAY_SIZE(voteAccounts), voteData,
+                                sizeof(voteData), &program_id};
+    cr_assert(SUCCESS == helloworld(&voteParams));
+  }
+
+  uint64_t requirement = petition->reputationRequirement;
+  // Every voter must be given once, but in any order
+  SolAccountInfo repeated[] = { accounts[0], accounts[1], accounts[2], accounts[3], accounts[2] };
+  SolParameters repeatedParams = {repeated, SOL_ARRAY_SIZE(repeated), (unsigned char*)"F", 1, &program_id};
+  cr_assert(ERROR_INVALID_ARGUMENT == helloworld(&repeatedParams));
+  cr_assert(!petition->completed);
+  SolAccountInfo shuffled[] = { accounts[0], accounts[1], accounts[4], accounts[2], accounts[3] };
+  SolParameters settleParams = {shuffled, SOL_ARRAY_SIZE(shuffled), (unsigned char*)"F", 1, &program_id};
+  cr_assert(SUCCESS == helloworld(&settleParams));
+  cr_assert(petition->completed);
+  // The majority voted for, so the post is redacted and voters on the
+  // winning side are rewarded
+  cr_assert(sol_memcmp(&offenderData[postOffset(offenderData, sizeof(offenderData), 0) + 3], "xxxx", 4) == 0);
+  cr_assert(((AccountMetadata*)offenderData)->reputation == 5 - requirement);
+  cr_assert(((AccountMetadata*)voterData[0])->reputation == 5 + requirement);
+  cr_assert(((AccountMetadata*)voterData[1])->reputation == 5 + requirement);
+  cr_assert(((AccountMetadata*)voterData[2])->reputation == 5 - requirement);
+  cr_assert(ERROR_INVALID_ACCOUNT_DATA == helloworld(&settleParams));
+}
+
+Test(hello, petitionPenaltyClamp) {
+  SolPubkey program_id = {.x = {
+                              1,
+                          }};
+  SolPubkey offenderKey = {.x = {
+                       2,
+                   }};
+  SolPubkey petitionKey = {.x = {
+                       3,
+                   }};
+  uint64_t lamports = 1;
+  uint8_t offenderData[128] = {0};
+  SolAccountInfo offenderAccount = {
+      &offenderKey,
+      &lamports,
+      sizeof(offenderData),
+      offenderData,
+      &program_id,
+      0,
+      true,
+      true,
+      false,
+  };
+  SolParameters postParams = {&offenderAccount, 1, (unsigned char*)"Pspam", 5, &program_id};
+  cr_assert(SUCCESS == helloworld(&postParams));
+
+  uint8_t petitionData[PETITION_ACCOUNT_SIZE(3)] = {0};
+  PostID offender = { .poster = offenderKey, .index = 0 };
+  initializePetitionAccount(petitionData, sizeof(petitionData), &offender, offenderData, sizeof(offenderData));
+  PetitionAccountMeta* petition = (PetitionAccountMeta*)petitionData;
+
+  SolPubkey voterKeys[3] = {{.x = { 4, }}, {.x = { 5, }}, {.x = { 6, }}};
+  uint8_t voterData[3][64] = {{0}};
+  SolAccountInfo accounts[5] = {
+    {
+      &petitionKey,
+      &lamports,
+      sizeof(petitionData),
+      petitionData,
+      &program_id,
+      0,
+      false,
+      true,
+      false,
+    },
+    offenderAccount,
+  };
+  uint8_t votes[] = { 1, 1, 1 };
+  for(int i = 0; i < 3; i++) {
+    initializeUserAccount(voterData[i], sizeof(voterData[i]));
+    accounts[2 + i] = offenderAccount;
+    accounts[2 + i].key = &voterKeys[i];
+    accounts[2 + i].data = voterData[i];
+    accounts[2 + i].data_len = sizeof(voterData[i]);
+    SolAccountInfo voteAccounts[] = { accounts[2 + i], accounts[0] };
+    uint8_t voteData[] = { 'V', votes[i] };
+    SolParameters voteParams = {voteAccounts, SOL_ARRAY_SIZE(voteAccounts), voteData,
+                                sizeof(voteData), &program_id};
+    cr_assert(SUCCESS == helloworld(&voteParams));
+  }
+
+  // The penalty is the tally times the requirement, which exceeds what
+  // the offender has left, so it bottoms out at zero instead of wrapping
+  ((AccountMetadata*)offenderData)->reputation = 3 * petition->reputationRequirement - 1;
+  SolParameters settleParams = {accounts, SOL_ARRAY_SIZE(accounts), (unsigned char*)"F", 1, &program_id};
+  cr_assert(SUCCESS == helloworld(&settleParams));
+  cr_assert(petition->netTally == 3);
+  cr_assert(((AccountMetadata*)offenderData)->reputation == 0);
+}
+
+Test(hello, petitionLiveTally) {
+  uint8_t offenderData[128] = {0};
+  initializeUserAccount(offenderData, sizeof(offenderData));
+  SolPubkey offenderKey = {.x = {
+                       2,
+                   }};
+  PostID offender = { .poster = offenderKey, .index = 0 };
+  uint8_t petitionData[PETITION_ACCOUNT_SIZE(8)] = {0};
+  initializePetitionAccount(petitionData, sizeof(petitionData), &offender, offenderData, sizeof(offenderData));
+  PetitionAccountMeta* petition = (PetitionAccountMeta*)petitionData;
+  cr_assert(sizeof(PetitionAccountMeta) == 56);
+
+  // The counters follow every vote
+  uint8_t votes[] = { 1, 0, 0, 1, 1 };
+  int64_t tally = 0;
+  for(uint64_t i = 0; i < sizeof(votes); i++) {
+    SolPubkey signer = {.x = { i + 10, }};
+    appendSignature(petitionData, &signer, votes[i]);
+    tally += votes[i] ? 1 : -1;
+    cr_assert(petition->netTally == tally);
+    cr_assert(isTallyCurrent(petitionData));
+  }
+  cr_assert(petitionState(petitionData) == &petition->completed);
+  cr_assert(petitionOffendingPost(petitionData).index == 0);
+
+  // Version 1 petitions keep votesFor beside the 16-bit offending post,
+  // and those from before the counters are recounted once
+  PetitionAccountMetaV1* petitionV1 = (PetitionAccountMetaV1*)petitionData;
+  petitionV1->layout = PETITION_LAYOUT_COLUMNS;
+  petitionV1->offendingPost.poster = offenderKey;
+  petitionV1->offendingPost.index = 7;
+  petitionV1->completed = PETITION_OPEN;
+  petitionV1->votesFor = 0;
+  petitionV1->netTally = 0;
+  cr_assert(petitionState(petitionData) == &petitionV1->completed);
+  cr_assert(petitionOffendingPost(petitionData).index == 7);
+  PostID offendingPost = petitionOffendingPost(petitionData);
+  cr_assert(SolPubkey_same(&offendingPost.poster, &offenderKey));
+  cr_assert(!isTallyCurrent(petitionData));
+  ensureTallyCurrent(petitionData);
+  cr_assert(petitionV1->netTally == 1);
+  cr_assert(petitionV1->votesFor == 3);
+  cr_assert(isTallyCurrent(petitionData));
+}
+
+Test(hello, petitionClaims) {
+  SolPubkey program_id = {.x = {
+                              1,
+                          }};
+  SolPubkey offenderKey = {.x = {
+                       2,
+                   }};
+  SolPubkey petitionKey = {.x = {
+                       3,
+                   }};
+  uint64_t lamports = 1;
+  uint8_t offenderData[128] = {0};
+  SolAccountInfo offenderAccount = {
+      &offenderKey,
+      &lamports,
+      sizeof(offenderData),
+      offenderData,
+      &program_id,
+      0,
+      true,
+      true,
+      false,
+  };
+  SolParameters postParams = {&offenderAccount, 1, (unsigned char*)"Pspam", 5, &program_id};
+  cr_assert(SUCCESS == helloworld(&postParams));
+
+  uint8_t petitionData[PETITION_ACCOUNT_SIZE(3)] = {0};
+  PostID offender = { .poster = offenderKey, .index = 0 };
+  initializePetitionAccount(petitionData, sizeof(petitionData), &offender, offenderData, sizeof(offenderData));
+  PetitionAccountMeta* petition = (PetitionAccountMeta*)petitionData;
+  SolAccountInfo petitionAccount = offenderAccount;
+  petitionAccount.key = &petitionKey;
+  petitionAccount.data = petitionData;
+  petitionAccount.data_len = sizeof(petitionData);
+
+  SolPubkey voterKeys[3] = {{.x = { 4, }}, {.x = { 5, }}, {.x = { 6, }}};
+  uint8_t voterData[3][64] = {{0}};
+  SolAccountInfo voterAccounts[3];
+  uint8_t votes[] = { 1, 0, 1 };
+  for(int i = 0; i < 3; i++) {
+    initializeUserAccount(voterData[i], sizeof(voterData[i]));
+    voterAccounts[i] = offenderAccount;
+    voterAccounts[i].key = &voterKeys[i];
+    voterAccounts[i].data = voterData[i];
+    voterAccounts[i].data_len = sizeof(voterData[i]);
+    SolAccountInfo voteAccounts[] = { voterAccounts[i], petitionAccount };
+    uint8_t voteData[] = { 'V', votes[i] };
+    SolParameters voteParams = {voteAccounts, SOL_ARRAY_SIZE(voteAccounts), voteData,
+                                sizeof(voteData), &program_id};
+    cr_assert(SUCCESS == helloworld(&voteParams));
+  }
+
+  // Claims are only accepted once the petition is finalized
+  uint8_t claimData[] = { 'W', 0, 0 };
+  SolAccountInfo claimAccounts[] = { voterAccounts[0], petitionAccount };
+  SolParameters claimParams = {claimAccounts, SOL_ARRAY_SIZE(claimAccounts), claimData,
+                               sizeof(claimData), &program_id};
+  cr_assert(ERROR_INVALID_ACCOUNT_DATA == helloworld(&claimParams));
+
+  // Finalizing only needs the petition and the offender
+  SolAccountInfo finalizeAccounts[] = { petitionAccount, offenderAccount };
+  SolParameters finalizeParams = {finalizeAccounts, SOL_ARRAY_SIZE(finalizeAccounts), (unsigned char*)"F",
+                                  1, &program_id};
+  uint64_t requirement = petition->reputationRequirement;
+  cr_assert(SUCCESS == helloworld(&finalizeParams));
+  cr_assert(petition->completed == PETITION_FINALIZED);
+  cr_assert(((AccountMetadata*)offenderData)->reputation == 5 - requirement);
+  cr_assert(((AccountMetadata*)voterData[1])->reputation == 5);
+  cr_assert(ERROR_INVALID_ACCOUNT_DATA == helloworld(&finalizeParams));
+
+  // Each voter claims their own slot exactly once
+  for(uint16_t i = 0; i < 3; i++) {
+    claimAccounts[0] = voterAccounts[i];
+    sol_memcpy(&claimData[1], &i, sizeof(uint16_t));
+    cr_assert(SUCCESS == helloworld(&claimParams));
+    cr_assert(((AccountMetadata*)voterData[i])->reputation == (votes[i] ? 5 + requirement : 5 - requirement));
+    cr_assert(ERROR_INVALID_ARGUMENT == helloworld(&claimParams));
+  }
+
+  // Another voter's slot can't be claimed
+  claimAccounts[0] = voterAccounts[0];
+  claimData[1] = 1;
+  cr_assert(ERROR_INVALID_ARGUMENT == helloworld(&claimParams));
+}
+
+// Writes the pool slot and generation that address a pooled petition
+void writePetitionRef(uint8_t* ref, uint16_t slot, uint32_t generation) {
+  sol_memcpy(ref, &slot, sizeof(uint16_t));
+  sol_memcpy(&ref[sizeof(uint16_t)], &generation, sizeof(uint32_t));
+}
+
+Test(hello, petitionPool) {
+  SolPubkey program_id = {.x = {
+                              1,
+                          }};
+  SolPubkey offenderKey = {.x = {
+                       2,
+                   }};
+  SolPubkey poolKey = {.x = {
+                       3,
+                   }};
+  uint64_t lamports = 1;
+  uint8_t offenderData[128] = {0};
+  SolAccountInfo offenderAccount = {
+      &offenderKey,
+      &lamports,
+      sizeof(offenderData),
+      offenderData,
+      &program_id,
+      0,
+      true,
+      true,
+      false,
+  };
+  SolParameters postParams = {&offenderAccount, 1, (unsigned char*)"Pspam", 5, &program_id};
+  cr_assert(SUCCESS == helloworld(&postParams));
+
+  // Room for two slots of two signatures, and some slack
+  uint8_t poolData[sizeof(PetitionPoolMeta) + 2 * PETITION_SLOT_SIZE(2) + 100] = {0};
+  SolAccountInfo poolAccount = offenderAccount;
+  poolAccount.key = &poolKey;
+  poolAccount.data = poolData;
+  poolAccount.data_len = sizeof(poolData);
+  uint8_t poolInstruction[] = { 'O', 2, 0 };
+  SolParameters poolParams = {&poolAccount, 1, poolInstruction, sizeof(poolInstruction), &program_id};
+  cr_assert(SUCCESS == helloworld(&poolParams));
+  PetitionPoolMeta* pool = (PetitionPoolMeta*)poolData;
+  cr_assert(pool->accountType == PetitionPool);
+  cr_assert(pool->numSlots == 2);
+  cr_assert(pool->slotSize == PETITION_SLOT_SIZE(2));
+  cr_assert(ERROR_INVALID_ACCOUNT_DATA == helloworld(&poolParams));
+
+  // Petitions take slots without creating accounts, until the pool is full.
+  // The pool is the authority that hands slots out, so it must sign.
+  uint8_t createData[] = { 'C', 0, 0, 0, 0 };
+  SolAccountInfo createAccounts[] = { poolAccount, offenderAccount };
+  createAccounts[0].is_signer = false;
+  SolParameters createParams = {createAccounts, SOL_ARRAY_SIZE(createAccounts), createData,
+                                sizeof(createData), &program_id};
+  cr_assert(ERROR_MISSING_REQUIRED_SIGNATURES == helloworld(&createParams));
+  cr_assert(pool->openPetitions == 0 && pool->firstUnused == 0);
+  createAccounts[0].is_signer = true;
+  cr_assert(SUCCESS == helloworld(&createParams));
+  cr_assert(SUCCESS == helloworld(&createParams));
+  cr_assert(ERROR_INVALID_ACCOUNT_DATA == helloworld(&createParams));
+  cr_assert(pool->openPetitions == 2);
+  for(uint64_t i = 0; i < 2; i++) {
+    PetitionAccountMeta* petition = (PetitionAccountMeta*)&poolSlot(poolData, i)[1];
+    cr_assert(poolSlot(poolData, i)->generation == 1);
+    cr_assert(petition->accountType == Petition);
+    cr_assert(petition->hashSlots == 2 * HASH_SLOTS_PER_SIGNATURE);
+    cr_assert(SolPubkey_same(&petition->offendingPost.poster, &offenderKey));
+  }
+
+  SolPubkey voterKeys[2] = {{.x = { 4, }}, {.x = { 5, }}};
+  uint8_t voterData[2][64] = {{0}};
+  SolAccountInfo voterAccounts[2];
+  for(int i = 0; i < 2; i++) {
+    initializeUserAccount(voterData[i], sizeof(voterData[i]));
+    voterAccounts[i] = offenderAccount;
+    voterAccounts[i].key = &voterKeys[i];
+    voterAccounts[i].data = voterData[i];
+    voterAccounts[i].data_len = sizeof(voterData[i]);
+  }
+
+  // Votes name the slot and its generation
+  uint8_t voteData[2 + PETITION_REF_SIZE] = { 'V', 1 };
+  SolAccountInfo voteAccounts[] = { voterAccounts[0], poolAccount };
+  SolParameters voteParams = {voteAccounts, SOL_ARRAY_SIZE(voteAccounts), voteData,
+                              sizeof(voteData), &program_id};
+  writePetitionRef(&voteData[2], 0, 2);
+  cr_assert(ERROR_INVALID_ARGUMENT == helloworld(&voteParams));
+  writePetitionRef(&voteData[2], 2, 1);
+  cr_assert(ERROR_INVALID_ARGUMENT == helloworld(&voteParams));
+  voteParams.data_len = 2;
+  cr_assert(ERROR_INVALID_INSTRUCTION_DATA == helloworld(&voteParams));
+  voteParams.data_len = sizeof(voteData);
+  for(int slot = 0; slot < 2; slot++) {
+    writePetitionRef(&voteData[2], slot, 1);
+    for(int i = 0; i < 2; i++) {
+      voteAccounts[0] = voterAccounts[i];
+      voteData[1] = i == 0;
+      cr_assert(SUCCESS == helloworld(&voteParams));
+    }
+  }
+  cr_assert(((PetitionAccountMeta*)&poolSlot(poolData, 0)[1])->numSignatures == 2);
+
+  // Settling a tied petition releases its slot straight away
+  uint8_t settleData[1 + PETITION_REF_SIZE] = { 'F' };
+  writePetitionRef(&settleData[1], 0, 1);
+  SolAccountInfo settleAccounts[] = { poolAccount, offenderAccount, voterAccounts[0], voterAccounts[1] };
+  SolParameters settleParams = {settleAccounts, SOL_ARRAY_SIZE(settleAccounts), settleData,
+                                sizeof(settleData), &program_id};
+  cr_assert(SUCCESS == helloworld(&settleParams));
+  cr_assert(pool->openPetitions == 1);
+  cr_assert(pool->freeHead == 1);
+  cr_assert(ERROR_INVALID_ARGUMENT == helloworld(&settleParams));
+
+  // The released slot is reused, and the old reference no longer reaches it
+  cr_assert(SUCCESS == helloworld(&createParams));
+  cr_assert(poolSlot(poolData, 0)->generation == 2);
+  cr_assert(pool->freeHead == 0);
+  cr_assert(pool->openPetitions == 2);
+  cr_assert(ERROR_INVALID_ARGUMENT == helloworld(&settleParams));
+
+  // A finalized petition is released by its last claim
+  uint8_t finalizeData[1 + PETITION_REF_SIZE] = { 'F' };
+  writePetitionRef(&finalizeData[1], 1, 1);
+  SolParameters finalizeParams = {settleAccounts, 2, finalizeData, sizeof(finalizeData), &program_id};
+  cr_assert(SUCCESS == helloworld(&finalizeParams));
+  cr_assert(poolSlot(poolData, 1)->unclaimed == 2);
+  uint8_t claimData[3 + PETITION_REF_SIZE] = { 'W' };
+  writePetitionRef(&claimData[3], 1, 1);
+  SolAccountInfo claimAccounts[] = { voterAccounts[0], poolAccount };
+  SolParameters claimParams = {claimAccounts, SOL_ARRAY_SIZE(claimAccounts), claimData,
+                               sizeof(claimData), &program_id};
+  for(uint16_t i = 0; i < 2; i++) {
+    claimAccounts[0] = voterAccounts[i];
+    sol_memcpy(&claimData[1], &i, sizeof(uint16_t));
+    cr_assert(SUCCESS == helloworld(&claimParams));
+  }
+  cr_assert(pool->openPetitions == 1);
+  cr_assert(pool->freeHead == 2);
+  cr_assert(ERROR_INVALID_ARGUMENT == helloworld(&claimParams));
+
+  // Batched votes on a pooled petition append the slot to the operation
+  uint8_t batchData[1 + 2 + 3 + PETITION_REF_SIZE] = { 'B', 3 + PETITION_REF_SIZE, 0, 'V', 1, 1 };
+  writePetitionRef(&batchData[6], 0, 2);
+  SolAccountInfo batchAccounts[] = { voterAccounts[1], poolAccount };
+  SolParameters batchParams = {batchAccounts, SOL_ARRAY_SIZE(batchAccounts), batchData,
+                               sizeof(batchData), &program_id};
+  cr_assert(SUCCESS == helloworld(&batchParams));
+  cr_assert(((PetitionAccountMeta*)&poolSlot(poolData, 0)[1])->numSignatures == 1);
+}
+
+Test(hello, arena) {
+  uint64_t heap[8];
+  Arena arena;
+  arenaInit(&arena, (uint8_t*)heap, sizeof(heap));
+
+  // Allocations are aligned whatever size came before them
+  uint8_t* a = arenaAlloc(&arena, 3);
+  uint8_t* b = arenaAlloc(&arena, 8);
+  cr_assert(a == (uint8_t*)heap);
+  cr_assert(b == (uint8_t*)&heap[1]);
+
+  // Restoring the cursor gives temporary buffers back
+  uint8_t* mark = arena.next;
+  cr_assert(arenaAlloc(&arena, 6 * sizeof(uint64_t)) == (uint8_t*)&heap[2]);
+  cr_assert(arenaAlloc(&arena, 1) == NULL);
+  arena.next = mark;
+  cr_assert(arenaAlloc(&arena, 1) == (uint8_t*)&heap[2]);
+  cr_assert(arenaAlloc(&arena, 6 * sizeof(uint64_t)) == NULL);
+  cr_assert(arenaAlloc(&arena, 5 * sizeof(uint64_t)) == (uint8_t*)&heap[3]);
+  cr_assert(arenaAlloc(&arena, 0) == (uint8_t*)&heap[8]);
+}
+
+// Serializes accounts and instruction data the way the loader does, with
+// a copy of each account's data. dups[i] is the earlier account that
+// account i duplicates, or NON_DUP_MARKER.
+uint64_t serializeInput(uint8_t* input, SolAccountInfo* accounts, const uint8_t* dups, uint64_t numAccounts,
+                        const uint8_t* data, uint64_t dataLength, const SolPubkey* programId) {
+  uint64_t offset = 0;
+  *(uint64_t*)&input[offset] = numAccounts;
+  offset += sizeof(uint64_t);
+  for(uint64_t i = 0; i < numAccounts; i++) {
+    sol_memset(&input[offset], 0, DUP_ACCOUNT_SIZE);
+    input[offset] = dups[i];
+    if(dups[i] != NON_DUP_MARKER) {
+      offset += DUP_ACCOUNT_SIZE;
+      continue;
+    }
+    input[offset + 1] = accounts[i].is_signer;
+    input[offset + 2] = accounts[i].is_writable;
+    input[offset + 3] = accounts[i].executable;
+    offset += DUP_ACCOUNT_SIZE;
+    sol_memcpy(&input[offset], accounts[i].key, sizeof(SolPubkey));
+    sol_memcpy(&input[offset + sizeof(SolPubkey)], accounts[i].owner, sizeof(SolPubkey));
+    offset += 2 * sizeof(SolPubkey);
+    *(uint64_t*)&input[offset] = *accounts[i].lamports;
+    *(uint64_t*)&input[offset + sizeof(uint64_t)] = accounts[i].data_len;
+    offset += 2 * sizeof(uint64_t);
+    sol_memcpy(&input[offset], accounts[i].data, accounts[i].data_len);
+    offset = (offset + accounts[i].data_len + MAX_PERMITTED_DATA_INCREASE + 7) & ~7ULL;
+    *(uint64_t*)&input[offset] = accounts[i].rent_epoch;
+    offset += sizeof(uint64_t);
+  }
+  *(uint64_t*)&input[offset] = dataLength;
+  sol_memcpy(&input[offset + sizeof(uint64_t)], data, dataLength);
+  offset += sizeof(uint64_t) + dataLength;
+  sol_memcpy(&input[offset], programId, sizeof(SolPubkey));
+  return offset + sizeof(SolPubkey);
+}
+
+Test(hello, lazyInput) {
+  SolPubkey program_id = {.x = {
+                              1,
+                          }};
+  SolPubkey offenderKey = {.x = {
+                       2,
+                   }};
+  SolPubkey petitionKey = {.x = {
+                       3,
+                   }};
+  uint64_t lamports = 1;
+  uint8_t offenderData[128] = {0};
+  SolAccountInfo offenderAccount = {
+      &offenderKey,
+      &lamports,
+      sizeof(offenderData),
+      offenderData,
+      &program_id,
+      0,
+      true,
+      true,
+      false,
+  };
+  SolParameters postParams = {&offenderAccount, 1, (unsigned char*)"Pspam", 5, &program_id};
+  cr_assert(SUCCESS == helloworld(&postParams));
+
+  uint8_t petitionData[PETITION_ACCOUNT_SIZE(3)] = {0};
+  PostID offender = { .poster = offenderKey, .index = 0 };
+  initializePetitionAccount(petitionData, sizeof(petitionData), &offender, offenderData, sizeof(offenderData));
+  SolAccountInfo accounts[5] = { offenderAccount, offenderAccount };
+  accounts[0].key = &petitionKey;
+  accounts[0].data = petitionData;
+  accounts[0].data_len = sizeof(petitionData);
+
+  SolPubkey voterKeys[3] = {{.x = { 4, }}, {.x = { 5, }}, {.x = { 6, }}};
+  uint8_t voterData[3][64] = {{0}};
+  uint8_t votes[] = { 1, 1, 0 };
+  for(int i = 0; i < 3; i++) {
+    initializeUserAccount(voterData[i], sizeof(voterData[i]));
+    accounts[2 + i] = offenderAccount;
+    accounts[2 + i].key = &voterKeys[i];
+    accounts[2 + i].data = voterData[i];
+    accounts[2 + i].data_len = sizeof(voterData[i]);
+    SolAccountInfo voteAccounts[] = { accounts[2 + i], accounts[0] };
+    uint8_t voteData[] = { 'V', votes[i] };
+    SolParameters voteParams = {voteAccounts, SOL_ARRAY_SIZE(voteAccounts), voteData,
+                                sizeof(voteData), &program_id};
+    cr_assert(SUCCESS == helloworld(&voteParams));
+  }
+  uint64_t requirement = ((PetitionAccountMeta*)petitionData)->reputationRequirement;
+
+  // Settling parses the petition, offender and page slot up front, and
+  // each voter only when it is checked
+  static uint8_t input[6 * (DUP_ACCOUNT_SIZE + 128 + MAX_PERMITTED_DATA_INCREASE + 64)];
+  uint8_t dups[] = { NON_DUP_MARKER, NON_DUP_MARKER, NON_DUP_MARKER, NON_DUP_MARKER, NON_DUP_MARKER };
+  serializeInput(input, accounts, dups, SOL_ARRAY_SIZE(accounts), (const uint8_t*)"F", 1, &program_id);
+  uint64_t heapData[1024];
+  Arena heap;
+  arenaInit(&heap, (uint8_t*)heapData, sizeof(heapData));
+  SolParameters params;
+  InputReader reader;
+  cr_assert(SUCCESS == readInput(input, &heap, &params, &reader));
+  cr_assert(params.ka_num == 5);
+  cr_assert(reader.numParsed == 3);
+  cr_assert(params.data_len == 1 && params.data[0] == 'F');
+  cr_assert(SolPubkey_same(params.program_id, &program_id));
+  cr_assert(SolPubkey_same(params.ka[1].key, &offenderKey));
+  cr_assert(params.ka[0].data_len == sizeof(petitionData));
+  cr_assert(SUCCESS == processInstruction(&params, &reader, &heap));
+
+  SolAccountInfo buffer;
+  for(int i = 0; i < 3; i++) {
+    SolAccountInfo* voter = instructionAccount(&params, &reader, 2 + i, &buffer);
+    cr_assert(SolPubkey_same(voter->key, &voterKeys[i]));
+    cr_assert(((AccountMetadata*)voter->data)->reputation == (votes[i] ? 5 + requirement : 5 - requirement));
+  }
+  cr_assert(((AccountMetadata*)params.ka[1].data)->reputation == 5 - requirement);
+
+  // Duplicates resolve to the account they repeat, parsed or not
+  uint8_t usernameDups[] = { NON_DUP_MARKER, NON_DUP_MARKER, 1 };
+  serializeInput(input, &accounts[2], usernameDups, 3, (const uint8_t*)"sbob", 4, &program_id);
+  arenaInit(&heap, (uint8_t*)heapData, sizeof(heapData));
+  cr_assert(SUCCESS == readInput(input, &heap, &params, &reader));
+  cr_assert(reader.numParsed == 1);
+  cr_assert(SolPubkey_same(instructionAccount(&params, &reader, 2, &buffer)->key, &voterKeys[1]));
+  cr_assert(SUCCESS == processInstruction(&params, &reader, &heap));
+  cr_assert(sol_memcmp(((AccountMetadata*)params.ka[0].data)->username, "bob", 4) == 0);
+}
+
+Test(hello, postCounters) {
+  SolPubkey program_id = {.x = {
+                              1,
+                          }};
+  SolPubkey posterKey = {.x = {
+                             2,
+                         }};
+  SolPubkey fanKey = {.x = {
+                          3,
+                      }};
+  uint64_t lamports = 1;
+  uint8_t posterData[256] = {0};
+  uint8_t fanData[512] = {0};
+  SolAccountInfo accounts[] = {{
+      &fanKey,
+      &lamports,
+      sizeof(fanData),
+      fanData,
+      &program_id,
+      0,
+      true,
+      true,
+      false,
+  }, {
+      &posterKey,
+      &lamports,
+      sizeof(posterData),
+      posterData,
+      &program_id,
+      0,
+      false,
+      true,
+      false,
+  }};
+
+  // The poster makes a counted post, then a plain one
+  uint8_t counted[1 + sizeof(PostCounters) + 3] = { POST_SELECTOR | COUNTERS_FLAG };
+  counted[1] = 0xFF; // Counters in the instruction are ignored
+  sol_memcpy(&counted[1 + sizeof(PostCounters)], "hot", 3);
+  SolParameters countedParams = {&accounts[1], 1, counted, sizeof(counted), &program_id};
+  accounts[1].is_signer = true;
+  cr_assert(SUCCESS == helloworld(&countedParams));
+  SolParameters plainParams = {&accounts[1], 1, (unsigned char*)"Pcold", 5, &program_id};
+  cr_assert(SUCCESS == helloworld(&plainParams));
+  accounts[1].is_signer = false;
+  PostCounters* counters = postCounters(posterData, sizeof(posterData), 0);
+  cr_assert(counters != NULL);
+  cr_assert(counters->likes == 0 && counters->replies == 0 && counters->reports == 0);
+  cr_assert(postCounters(posterData, sizeof(posterData), 1) == NULL);
+  cr_assert(postCounters(posterData, sizeof(posterData), 2) == NULL);
+
+  // Like, reply to and report the counted post
+  PostID hot = { .poster = posterKey, .index = 0 };
+  uint8_t like[1 + sizeof(PostID)] = { LIKE_SELECTOR };
+  sol_memcpy(&like[1], &hot, sizeof(PostID));
+  uint8_t reply[1 + sizeof(PostID) + 2] = { REPLY_SELECTOR };
+  sol_memcpy(&reply[1], &hot, sizeof(PostID));
+  sol_memcpy(&reply[1 + sizeof(PostID)], "me", 2);
+  uint8_t report[1 + sizeof(PostID) + 2] = { REPORT_SELECTOR };
+  sol_memcpy(&report[1], &hot, sizeof(PostID));
+  sol_memcpy(&report[1 + sizeof(PostID)], "no", 2);
+  SolParameters likeParams = {accounts, SOL_ARRAY_SIZE(accounts), like, sizeof(like), &program_id};
+  SolParameters replyParams = {accounts, SOL_ARRAY_SIZE(accounts), reply, sizeof(reply), &program_id};
+  SolParameters reportParams = {accounts, SOL_ARRAY_SIZE(accounts), report, sizeof(report), &program_id};
+  cr_assert(SUCCESS == helloworld(&likeParams));
+  cr_assert(SUCCESS == helloworld(&likeParams));
+  cr_assert(SUCCESS == helloworld(&replyParams));
+  cr_assert(SUCCESS == helloworld(&reportParams));
+  cr_assert(counters->likes == 2);
+  cr_assert(counters->replies == 1);
+  cr_assert(counters->reports == 1);
+
+  // The target account is optional and only written when writable
+  likeParams.ka_num = 1;
+  cr_assert(SUCCESS == helloworld(&likeParams));
+  likeParams.ka_num = 2;
+  accounts[1].is_writable = false;
+  cr_assert(SUCCESS == helloworld(&likeParams));
+  accounts[1].is_writable = true;
+  cr_assert(counters->likes == 2);
+
+  // Posts without counters are still referenced normally
+  like[1 + sizeof(SolPubkey)] = 1;
+  cr_assert(SUCCESS == helloworld(&likeParams));
+
+  // The target account must be the referenced poster's
+  accounts[1].key = &fanKey;
+  cr_assert(ERROR_INVALID_ARGUMENT == helloworld(&likeParams));
+  accounts[1].key = &posterKey;
+
+  // Likes never carry counters, and redaction leaves counters intact
+  uint8_t countedLike[1 + sizeof(PostCounters) + sizeof(PostID)] = { LIKE_SELECTOR | COUNTERS_FLAG };
+  SolParameters countedLikeParams = {accounts, 1, countedLike, sizeof(countedLike), &program_id};
+  cr_assert(ERROR_INVALID_INSTRUCTION_DATA == helloworld(&countedLikeParams));
+  redactPost(&accounts[1], 0);
+  cr_assert(counters->likes == 2);
+  cr_assert(posterData[postOffset(posterData, sizeof(posterData), 0) + sizeof(uint16_t) + 1 + sizeof(PostCounters)] == 'x');
+}
+
+Test(hello, counterShards) {
+  SolPubkey program_id = {.x = {
+                              1,
+                          }};
+  SolPubkey posterKey = {.x = {
+                             2,
+                         }};
+  SolPubkey shardKeys[3];
+  shardAddress(&posterKey, 0, 0, &program_id, &shardKeys[0]);
+  shardAddress(&posterKey, 0, 1, &program_id, &shardKeys[1]);
+  shardAddress(&posterKey, 1, 0, &program_id, &shardKeys[2]);
+  SolPubkey fanKeys[2] = {{.x = { 5, }}, {.x = { 6, }}};
+  uint64_t lamports = 1;
+  uint8_t posterData[256] = {0};
+  uint8_t shardData[2][sizeof(CounterShardMeta)] = {{0}};
+  uint8_t fanData[2][256] = {{0}};
+  SolAccountInfo poster = {
+      &posterKey,
+      &lamports,
+      sizeof(posterData),
+      posterData,
+      &program_id,
+      0,
+      true,
+      true,
+      false,
+  };
+  SolAccountInfo shards[2];
+  SolAccountInfo fans[2];
+  for(int i = 0; i < 2; i++) {
+    SolAccountInfo shard = { &shardKeys[i], &lamports, sizeof(shardData[i]), shardData[i], &program_id, 0, false, true, false };
+    SolAccountInfo fan = { &fanKeys[i], &lamports, sizeof(fanData[i]), fanData[i], &program_id, 0, true, true, false };
+    shards[i] = shard;
+    fans[i] = fan;
+  }
+  SolParameters postParams = {&poster, 1, (unsigned char*)"Pviral", 6, &program_id};
+  cr_assert(SUCCESS == helloworld(&postParams));
+
+  // The poster creates 2 shards for post 0
+  uint8_t create[CREATE_SHARD_INSTRUCTION_SIZE] = { CREATE_SHARD_SELECTOR, 0, 0, 0, 0, 0, 2 };
+  for(int i = 0; i < 2; i++) {
+    SolAccountInfo accounts[] = { poster, shards[i] };
+    create[5] = i;
+    SolParameters params = {accounts, SOL_ARRAY_SIZE(accounts), create, sizeof(create), &program_id};
+    cr_assert(SUCCESS == helloworld(&params));
+    cr_assert(ERROR_INVALID_ACCOUNT_DATA == helloworld(&params));
+  }
+  CounterShardMeta* meta = (CounterShardMeta*)shardData[1];
+  cr_assert(meta->accountType == CounterShard);
+  cr_assert(meta->shard == 1 && meta->shardCount == 2);
+  cr_assert(SolPubkey_same(&meta->post.poster, &posterKey) && meta->post.index == 0);
+
+  // Each fan likes through the shard picked from their key
+  PostID viral = { .poster = posterKey, .index = 0 };
+  uint8_t like[1 + sizeof(PostID)] = { LIKE_SELECTOR };
+  sol_memcpy(&like[1], &viral, sizeof(PostID));
+  for(int i = 0; i < 2; i++) {
+    SolAccountInfo accounts[] = { fans[i], shards[counterShard(&fanKeys[i], 2)] };
+    SolParameters params = {accounts, SOL_ARRAY_SIZE(accounts), like, sizeof(like), &program_id};
+    cr_assert(SUCCESS == helloworld(&params));
+  }
+  cr_assert(((CounterShardMeta*)shardData[0])->counters.likes == 1);
+  cr_assert(((CounterShardMeta*)shardData[1])->counters.likes == 1);
+
+  // The read path sums only the shards of the post
+  SolAccountInfo candidates[] = { shards[0], poster, shards[1] };
+  PostCounters total = {0};
+  sumCounterShards(candidates, SOL_ARRAY_SIZE(candidates), &viral, &total);
+  cr_assert(total.likes == 2 && total.replies == 0 && total.reports == 0);
+
+  // A shard of a different post is rejected
+  PostID other = { .poster = posterKey, .index = 1 };
+  sol_memcpy(&like[1], &other, sizeof(PostID));
+  SolAccountInfo accounts[] = { fans[0], shards[0] };
+  SolParameters otherParams = {accounts, SOL_ARRAY_SIZE(accounts), like, sizeof(like), &program_id};
+  cr_assert(ERROR_INVALID_ARGUMENT == helloworld(&otherParams));
+
+  // Shards need a signing poster, an existing post, a valid shard number
+  // and the address derived from them. spare is at the address of shard 0
+  // of post 1, which does not exist.
+  uint8_t spareData[sizeof(CounterShardMeta)] = {0};
+  SolAccountInfo spare = { &shardKeys[2], &lamports, sizeof(spareData), spareData, &program_id, 0, false, true, false };
+  SolAccountInfo createAccounts[] = { poster, spare };
+  SolParameters createParams = {createAccounts, SOL_ARRAY_SIZE(createAccounts), create, sizeof(create), &program_id};
+  create[5] = 2;
+  cr_assert(ERROR_INVALID_INSTRUCTION_DATA == helloworld(&createParams));
+  create[5] = 0;
+  create[1] = 1;
+  cr_assert(ERROR_INVALID_ARGUMENT == helloworld(&createParams));
+  create[1] = 0;
+  cr_assert(ERROR_INVALID_ARGUMENT == helloworld(&createParams));
+  cr_assert(!isInitialized(spareData));
+  createAccounts[0].is_signer = false;
+  cr_assert(ERROR_MISSING_REQUIRED_SIGNATURES == helloworld(&createParams));
+}
+
+Test(hello, compaction) {
+  SolPubkey program_id = {.x = {
+                              1,
+                          }};
+  SolPubkey key = {.x = {
+                       2,
+                   }};
+  uint64_t lamports = 1;
+  uint8_t data[512] = {0};
+  SolAccountInfo accounts[] = {{
+      &key,
+      &lamports,
+      sizeof(data),
+      data,
+      &program_id,
+      0,
+      true,
+      true,
+      false,
+  }};
+  AccountMetadata* meta = (AccountMetadata*)data;
+
+  // Post, like, reply to post 0, then another post
+  PostID target = { .poster = key, .index = 0 };
+  uint8_t like[1 + sizeof(PostID)] = { LIKE_SELECTOR };
+  sol_memcpy(&like[1], &target, sizeof(PostID));
+  uint8_t reply[1 + sizeof(PostID) + 5] = { REPLY_SELECTOR };
+  sol_memcpy(&reply[1], &target, sizeof(PostID));
+  sol_memcpy(&reply[1 + sizeof(PostID)], "reply", 5);
+  SolParameters posts[] = {
+    {accounts, 1, (unsigned char*)"Pa rude post", 12, &program_id},
+    {accounts, 1, like, sizeof(like), &program_id},
+    {accounts, 1, reply, sizeof(reply), &program_id},
+    {accounts, 1, (unsigned char*)"Plast", 5, &program_id},
+  };
+  for(int i = 0; i < 4; i++) {
+    cr_assert(SUCCESS == helloworld(&posts[i]));
+  }
+  uint64_t tail = meta->tailOffset;
+
+  redactPost(&accounts[0], 0);
+  cr_assert(data[sizeof(AccountMetadata) + sizeof(uint16_t)] == (POST_SELECTOR | REDACTED_FLAG));
+
+  // Compacting part of the account moves records but keeps the tail
+  uint8_t compact[COMPACT_INSTRUCTION_SIZE] = { COMPACT_SELECTOR, COMPACT_DROP_LIKES, 0, 0, 0, 0, 2, 0, 0, 0 };
+  SolParameters compactParams = {accounts, 1, compact, sizeof(compact), &program_id};
+  cr_assert(SUCCESS == helloworld(&compactParams));
+  cr_assert(postOffset(data, sizeof(data), 0) == sizeof(AccountMetadata));
+  cr_assert(*(uint16_t*)&data[sizeof(AccountMetadata)] == 2);
+  cr_assert(postOffset(data, sizeof(data), 1) == 0);
+  cr_assert(meta->tailOffset == tail);
+
+  // Compacting the rest returns the space to the tail
+  compact[2] = 2;
+  cr_assert(SUCCESS == helloworld(&compactParams));
+  cr_assert(postOffset(data, sizeof(data), 2) == sizeof(AccountMetadata) + alignRecord(sizeof(uint16_t) + 2));
+  cr_assert(meta->tailOffset < tail);
+  cr_assert(meta->tailOffset == alignRecord(postOffset(data, sizeof(data), 3) + sizeof(uint16_t) + 5));
+  cr_assert(meta->numPosts == 4);
+
+  // PostIDs still resolve to the same posts
+  Post post;
+  uint64_t offset = postOffset(data, sizeof(data), 2);
+  cr_assert(parsePost(&data[offset + sizeof(uint16_t)], *(uint16_t*)&data[offset], &post) != 0);
+  cr_assert(post.typeSelector == REPLY_SELECTOR && post.id.index == 0);
+  cr_assert(!sol_memcmp(post.body.immutable, "reply", 5));
+  offset = postOffset(data, sizeof(data), 3);
+  cr_assert(!sol_memcmp(&data[offset + sizeof(uint16_t)], "Plast", 5));
+  cr_assert(data[meta->tailOffset] == 0);
+
+  // New posts keep their own index, and dropped posts cannot be redacted
+  cr_assert(SUCCESS == helloworld(&posts[3]));
+  cr_assert(meta->numPosts == 5);
+  cr_assert(postOffset(data, sizeof(data), 4) == alignRecord(offset + sizeof(uint16_t) + 5));
+  redactPost(&accounts[0], 1);
+  cr_assert(postOffset(data, sizeof(data), 1) == 0);
+
+  // The range must start at an existing post
+  compact[2] = 6;
+  cr_assert(ERROR_INVALID_INSTRUCTION_DATA == helloworld(&compactParams));
+}
+
+Test(hello, slotStamps) {
+  SolPubkey program_id = {.x = {
+                              1,
+                          }};
+  SolPubkey key = {.x = {
+                       2,
+                   }};
+  SolPubkey sysvarOwner = {.x = {
+                       3,
+                   }};
+  uint64_t lamports = 1;
+  uint8_t data[512] = {0};
+  uint64_t clock[5] = { 1000 };
+  SolAccountInfo accounts[] = {
+    {
+      &key,
+      &lamports,
+      sizeof(data),
+      data,
+      &program_id,
+      0,
+      true,
+      true,
+      false,
+    },
+    {
+      (SolPubkey*)&clockSysvarId,
+      &lamports,
+      sizeof(clock),
+      (uint8_t*)clock,
+      &sysvarOwner,
+      0,
+      false,
+      false,
+      false,
+    }
+  };
+  AccountMetadata* meta = (AccountMetadata*)data;
+
+  // A post without the Clock has no stamp
+  SolParameters unstamped = {accounts, 1, (unsigned char*)"Pfirst", 6, &program_id};
+  cr_assert(SUCCESS == helloworld(&unstamped));
+  cr_assert(postStamp(data, sizeof(data), 0) == 0);
+  cr_assert(postOffset(data, sizeof(data), 0) == sizeof(AccountMetadata));
+
+  // With the Clock last, the slot goes right before the record
+  SolParameters stamped = {accounts, 2, (unsigned char*)"Psecond", 7, &program_id};
+  cr_assert(SUCCESS == helloworld(&stamped));
+  uint64_t offset = postOffset(data, sizeof(data), 1);
+  cr_assert(offset % RECORD_ALIGNMENT == 0);
+  cr_assert(*postSlot(data, sizeof(data), 1) == (offset | STAMPED_RECORD));
+  cr_assert(*(SlotStamp*)&data[offset - sizeof(SlotStamp)] == 1000);
+  cr_assert(postStamp(data, sizeof(data), 1) == 1000);
+  cr_assert(!sol_memcmp(&data[offset + sizeof(uint16_t)], "Psecond", 7));
+  cr_assert(meta->tailOffset == alignRecord(offset + sizeof(uint16_t) + 7));
+
+  // Batched posts share the slot of their instruction
+  clock[0] = 1001;
+  uint8_t batch[32] = { BATCH_SELECTOR };
+  uint64_t length = 1;
+  for(int i = 0; i < 2; i++) {
+    uint16_t opLength = 5;
+    sol_memcpy(&batch[length], &opLength, sizeof(uint16_t));
+    sol_memcpy(&batch[length + sizeof(uint16_t)], i == 0 ? "Pbat0" : "Pbat1", opLength);
+    length += sizeof(uint16_t) + opLength;
+  }
+  SolParameters batchParams = {accounts, 2, batch, length, &program_id};
+  cr_assert(SUCCESS == helloworld(&batchParams));
+  cr_assert(meta->numPosts == 4);
+  cr_assert(postStamp(data, sizeof(data), 2) == 1001);
+  cr_assert(postStamp(data, sizeof(data), 3) == 1001);
+  cr_assert(!sol_memcmp(&data[postOffset(data, sizeof(data), 3) + sizeof(uint16_t)], "Pbat1", 5));
+
+  // Redacting a stamped post leaves its stamp alone
+  redactPost(&accounts[0], 1);
+  cr_assert(data[offset + sizeof(uint16_t)] == (POST_SELECTOR | REDACTED_FLAG));
+  cr_assert(postStamp(data, sizeof(data), 1) == 1000);
+
+  // Compaction moves stamps along with their records
+  uint8_t compact[COMPACT_INSTRUCTION_SIZE] = { COMPACT_SELECTOR, 0, 0, 0, 0, 0, 4, 0, 0, 0 };
+  SolParameters compactParams = {accounts, 1, compact, sizeof(compact), &program_id};
+  uint64_t tail = meta->tailOffset;
+  cr_assert(SUCCESS == helloworld(&compactParams));
+  cr_assert(meta->tailOffset < tail);
+  cr_assert(postStamp(data, sizeof(data), 0) == 0);
+  cr_assert(postStamp(data, sizeof(data), 1) == 1000);
+  cr_assert(postStamp(data, sizeof(data), 2) == 1001);
+  cr_assert(postStamp(data, sizeof(data), 3) == 1001);
+  offset = postOffset(data, sizeof(data), 2);
+  cr_assert(offset % RECORD_ALIGNMENT == 0);
+  cr_assert(!sol_memcmp(&data[offset + sizeof(uint16_t)], "Pbat0", 5));
+  cr_assert(meta->tailOffset == alignRecord(postOffset(data, sizeof(data), 3) + sizeof(uint16_t) + 5));
+
+  // A Clock that is the only account is not taken for one
+  SolParameters clockOnly = {&accounts[1], 1, (unsigned char*)"Pnope", 5, &program_id};
+  cr_assert(ERROR_INCORRECT_PROGRAM_ID == helloworld(&clockOnly));
+}
+
+Test(hello, compressedBodies) {
+  SolPubkey program_id = {.x = {
+                              1,
+                          }};
+  SolPubkey key = {.x = {
+                       2,
+                   }};
+  uint64_t lamports = 1;
+  uint8_t data[256] = {0};
+  SolAccountInfo accounts[] = {{
+      &key,
+      &lamports,
+      sizeof(data),
+      data,
+      &program_id,
+      0,
+      true,
+      true,
+      false,
+  }};
+
+  // "hello", the " the " word, a 10 byte match 10 back, then "hello!"
+  const char text[] = "hello the hello the hello!";
+  uint8_t post[] = { COMPRESSED_POST_SELECTOR, sizeof(text) - 1, 0,
+                     4, 'h', 'e', 'l', 'l', 'o', LITERAL_TOKEN_LIMIT, WORD_TOKEN_LIMIT + 10 - MIN_BODY_MATCH, 10, 0,
+                     5, 'h', 'e', 'l', 'l', 'o', '!' };
+  SolParameters postParams = {accounts, 1, post, sizeof(post), &program_id};
+  cr_assert(SUCCESS == helloworld(&postParams));
+  uint64_t offset = postOffset(data, sizeof(data), 0);
+  cr_assert(data[offset + sizeof(uint16_t)] == 'Q');
+  Post p;
+  cr_assert(parsePost(&data[offset + sizeof(uint16_t)], *(uint16_t*)&data[offset], &p) != 0);
+  cr_assert(p.typeSelector == POST_SELECTOR && p.compressed);
+  uint8_t decoded[sizeof(text) - 1];
+  cr_assert(decompressBody(p.body.immutable, p.bodyLength, decoded) == sizeof(decoded));
+  cr_assert(sol_memcmp(decoded, text, sizeof(decoded)) == 0);
+
+  // Counted replies and reports may be compressed too
+  PostID target = { .poster = key, .index = 0 };
+  uint8_t reply[1 + sizeof(PostCounters) + sizeof(PostID) + 5] = { COMPRESSED_REPLY_SELECTOR | COUNTERS_FLAG };
+  sol_memcpy(&reply[1 + sizeof(PostCounters)], &target, sizeof(PostID));
+  uint8_t replyBody[] = { 4, 0, LITERAL_TOKEN_LIMIT + 57 }; // "The "
+  sol_memcpy(&reply[1 + sizeof(PostCounters) + sizeof(PostID)], replyBody, sizeof(replyBody));
+  SolParameters replyParams = {accounts, 1, reply, sizeof(reply) - 2, &program_id};
+  cr_assert(SUCCESS == helloworld(&replyParams));
+  offset = postOffset(data, sizeof(data), 1);
+  cr_assert(parsePost(&data[offset + sizeof(uint16_t)], *(uint16_t*)&data[offset], &p) != 0);
+  cr_assert(p.typeSelector == REPLY_SELECTOR && p.compressed && p.hasCounters && p.id.index == 0);
+  cr_assert(decompressBody(p.body.immutable, p.bodyLength, decoded) == 4);
+  cr_assert(sol_memcmp(decoded, "The ", 4) == 0);
+
+  // Bodies must decode to exactly their declared length
+  post[1] += 1;
+  cr_assert(ERROR_INVALID_INSTRUCTION_DATA == helloworld(&postParams));
+  post[1] -= 2;
+  cr_assert(ERROR_INVALID_INSTRUCTION_DATA == helloworld(&postParams));
+  post[1] += 1;
+  postParams.data_len -= 1;
+  cr_assert(ERROR_INVALID_INSTRUCTION_DATA == helloworld(&postParams));
+  postParams.data_len += 1;
+  // Matches may not reach before the start of the body
+  post[11] = 11;
+  cr_assert(ERROR_INVALID_INSTRUCTION_DATA == helloworld(&postParams));
+  post[11] = 0;
+  cr_assert(ERROR_INVALID_INSTRUCTION_DATA == helloworld(&postParams));
+  post[11] = 10;
+  cr_assert(SUCCESS == helloworld(&postParams));
+
+  // Redaction leaves a plain body behind
+  redactPost(&accounts[0], 0);
+  offset = postOffset(data, sizeof(data), 0);
+  cr_assert(data[offset + sizeof(uint16_t)] == (POST_SELECTOR | REDACTED_FLAG));
+  cr_assert(parsePost(&data[offset + sizeof(uint16_t)], *(uint16_t*)&data[offset], &p) != 0);
+  cr_assert(!p.compressed && p.body.immutable[0] == REDACTION_BYTE);
+}
+
+Test(hello, seedAddresses) {
+  // Page and shard addresses match PublicKey.createWithSeed on the client
+  SolPubkey program_id = {.x = { 1, }};
+  SolPubkey poster = {.x = { 2, }};
+  SolPubkey address;
+  pageAddress(&poster, 1, &program_id, &address);
+  uint8_t page1[] = {
+    0x34, 0xf7, 0x2f, 0xca, 0x71, 0xd5, 0xde, 0x9b, 0x52, 0x99, 0x29, 0x1a, 0xdf, 0xc6, 0xd2, 0xd6,
+    0x9a, 0x0d, 0x47, 0x82, 0x43, 0xbf, 0x48, 0x25, 0x3e, 0x67, 0x79, 0x49, 0x82, 0x89, 0x95, 0x90,
+  };
+  cr_assert(sol_memcmp(address.x, page1, sizeof(page1)) == 0);
+  pageAddress(&poster, 12, &program_id, &address);
+  uint8_t page12[] = {
+    0x35, 0x96, 0xf4, 0xb2, 0x9f, 0x9d, 0x0c, 0x0e, 0x06, 0x17, 0xb9, 0x19, 0xd1, 0x5a, 0x6f, 0x03,
+    0xee, 0x0f, 0xb5, 0x27, 0x3a, 0x10, 0x6b, 0xb4, 0x46, 0x06, 0xf3, 0xf1, 0x64, 0x8f, 0x9d, 0xfc,
+  };
+  cr_assert(sol_memcmp(address.x, page12, sizeof(page12)) == 0);
+  shardAddress(&poster, 305, 7, &program_id, &address);
+  uint8_t shard[] = {
+    0x94, 0x32, 0xbb, 0x35, 0x92, 0xb4, 0xb2, 0x3b, 0x3b, 0xc0, 0x08, 0x11, 0x30, 0x04, 0x36, 0xf3,
+    0x92, 0x3c, 0x2c, 0x6e, 0x29, 0x19, 0x11, 0x7a, 0x89, 0x65, 0x93, 0x15, 0xac, 0x61, 0xb6, 0xf0,
+  };
+  cr_assert(sol_memcmp(address.x, shard, sizeof(shard)) == 0);
+
+  // Input spanning more than one block
+  uint8_t input[100];
+  sol_memset(input, 'a', sizeof(input));
+  SolBytes bytes[] = {{input, 30}, {&input[30], 70}};
+  uint8_t hash[SHA256_RESULT_LENGTH];
+  sol_sha256(bytes, SOL_ARRAY_SIZE(bytes), hash);
+  uint8_t expected[] = {
+    0x28, 0x16, 0x59, 0x78, 0x88, 0xe4, 0xa0, 0xd3, 0xa3, 0x6b, 0x82, 0xb8, 0x33, 0x16, 0xab, 0x32,
+    0x68, 0x0e, 0xb8, 0xf0, 0x0f, 0x8c, 0xd3, 0xb9, 0x04, 0xd6, 0x81, 0x24, 0x6d, 0x28, 0x5a, 0x0e,
+  };
+  cr_assert(sol_memcmp(hash, expected, sizeof(expected)) == 0);
+}
+
+Test(hello, pages) {
+  SolPubkey program_id = {.x = {
+                              1,
+                          }};
+  SolPubkey key = {.x = {
+                       2,
+                   }};
+  SolPubkey pageKeys[2];
+  pageAddress(&key, 1, &program_id, &pageKeys[0]);
+  pageAddress(&key, 2, &program_id, &pageKeys[1]);
+  SolPubkey fanKey = {.x = {
+                       5,
+                   }};
+  uint64_t lamports = 1;
+  uint8_t data[128] = {0};
+  uint8_t pageData[2][128] = {{0}};
+  uint8_t fanData[256] = {0};
+  SolAccountInfo poster = { &key, &lamports, sizeof(data), data, &program_id, 0, true, true, false };
+  SolAccountInfo pages[2];
+  for(int i = 0; i < 2; i++) {
+    SolAccountInfo page = { &pageKeys[i], &lamports, sizeof(pageData[i]), pageData[i], &program_id, 0, false, true, false };
+    pages[i] = page;
+  }
+  SolAccountInfo fan = { &fanKey, &lamports, sizeof(fanData), fanData, &program_id, 0, true, true, false };
+  AccountMetadata* meta = (AccountMetadata*)data;
+
+  SolParameters firstParams = {&poster, 1, (unsigned char*)"Pfirst", 6, &program_id};
+  cr_assert(SUCCESS == helloworld(&firstParams));
+
+  // Open the first page, which continues after the account's own post. It
+  // must be at the address derived for page 1.
+  SolAccountInfo openAccounts[] = { poster, pages[1], pages[0] };
+  SolParameters openParams = {openAccounts, 2, (unsigned char*)"N", 1, &program_id};
+  cr_assert(ERROR_INVALID_ARGUMENT == helloworld(&openParams));
+  cr_assert(!isInitialized(pageData[1]) && meta->numPages == 0);
+  openAccounts[1] = pages[0];
+  cr_assert(SUCCESS == helloworld(&openParams));
+  cr_assert(ERROR_ACCOUNT_ALREADY_INITIALIZED == helloworld(&openParams));
+  UserPageMeta* page = (UserPageMeta*)pageData[0];
+  cr_assert(meta->numPages == 1);
+  cr_assert(page->accountType == UserPage && page->page == 1 && page->firstPost == 1);
+  cr_assert(SolPubkey_same(&page->owner, &key));
+
+  // New posts must go to the newest page
+  uint8_t counted[1 + sizeof(PostCounters) + 4] = { POST_SELECTOR | COUNTERS_FLAG };
+  sol_memcpy(&counted[1 + sizeof(PostCounters)], "page", 4);
+  SolParameters rootParams = {&poster, 1, counted, sizeof(counted), &program_id};
+  cr_assert(ERROR_NOT_ENOUGH_ACCOUNT_KEYS == helloworld(&rootParams));
+  SolAccountInfo wrongAccounts[] = { poster, poster };
+  SolParameters wrongParams = {wrongAccounts, 2, counted, sizeof(counted), &program_id};
+  cr_assert(ERROR_INVALID_ARGUMENT == helloworld(&wrongParams));
+  SolAccountInfo postAccounts[] = { poster, pages[0] };
+  SolParameters pageParams = {postAccounts, 2, counted, sizeof(counted), &program_id};
+  cr_assert(SUCCESS == helloworld(&pageParams));
+  cr_assert(meta->numPosts == 1);
+  cr_assert(page->numPosts == 1);
+  cr_assert(postOffset(pageData[0], sizeof(pageData[0]), 0) == sizeof(UserPageMeta));
+
+  // PostIDs resolve across pages: post 1 is the first post of page 1
+  uint32_t local;
+  cr_assert(localPostIndex(pageData[0], 1, &local) && local == 0);
+  cr_assert(!localPostIndex(pageData[0], 0, &local));
+  cr_assert(!localPostIndex(data, 1, &local));
+  cr_assert(postCounters(data, sizeof(data), 1) == NULL);
+  uint8_t like[1 + sizeof(PostID)] = { LIKE_SELECTOR };
+  PostID target = { .poster = key, .index = 1 };
+  sol_memcpy(&like[1], &target, sizeof(PostID));
+  SolAccountInfo likeAccounts[] = { fan, pages[0] };
+  SolParameters likeParams = {likeAccounts, 2, like, sizeof(like), &program_id};
+  cr_assert(SUCCESS == helloworld(&likeParams));
+  cr_assert(postCounters(pageData[0], sizeof(pageData[0]), 1)->likes == 1);
+  SolAccountInfo badLikeAccounts[] = { fan, pages[1] };
+  likeParams.ka = badLikeAccounts;
+  cr_assert(ERROR_INVALID_ARGUMENT == helloworld(&likeParams));
+
+  // The second page needs the first to know where it starts
+  openAccounts[1] = pages[1];
+  cr_assert(ERROR_INVALID_ARGUMENT == helloworld(&openParams));
+  openParams.ka_num = 3;
+  cr_assert(SUCCESS == helloworld(&openParams));
+  cr_assert(((UserPageMeta*)pageData[1])->firstPost == 2);
+  cr_assert(((UserPageMeta*)pageData[1])->page == 2);
+  cr_assert(ERROR_INVALID_ARGUMENT == helloworld(&pageParams));
+
+  // A petition against a post in a page redacts it there
+  uint8_t petitionData[PETITION_ACCOUNT_SIZE(1)] = {0};
+  SolPubkey petitionKey = {.x = {
+                       6,
+                   }};
+  initializePetitionAccount(petitionData, sizeof(petitionData), &target, data, sizeof(data));
+  appendSignature(petitionData, &fanKey, true);
+  SolAccountInfo petition = { &petitionKey, &lamports, sizeof(petitionData), petitionData, &program_id, 0, false, true, false };
+  SolAccountInfo outcomeAccounts[] = { petition, poster, pages[0] };
+  SolParameters outcomeParams = {outcomeAccounts, 2, (unsigned char*)"F", 1, &program_id};
+  cr_assert(ERROR_INVALID_ARGUMENT == helloworld(&outcomeParams));
+  outcomeParams.ka_num = 3;
+  cr_assert(SUCCESS == helloworld(&outcomeParams));
+  cr_assert(*petitionState(petitionData) == PETITION_FINALIZED);
+  uint64_t offset = postOffset(pageData[0], sizeof(pageData[0]), 0);
+  cr_assert(pageData[0][offset + sizeof(uint16_t)] & REDACTED_FLAG);
+  cr_assert(sol_memcmp(&pageData[0][offset + sizeof(uint16_t) + 1 + sizeof(PostCounters)], "xxxx", 4) == 0);
+}
@@ -0,0 +1,418 @@
+//! Compute unit budgets of the C forum program
+//!
+//! Loads dist/program/helloworld.so, as built by `npm run build:program-c`,
+//! into a local bank and runs every instruction type at several account and
+//! petition sizes. The units each one consumes are compared against
+//! tests/compute_budgets.txt, so a change that makes an instruction more
+//! expensive fails here and the new budget shows up in review.
+//!
+//! Accounts are filled through the program itself rather than built here,
+//! so the cases follow the program's layout without copying it. Run with
+//! UPDATE_COMPUTE_BUDGETS=1 to rewrite the budgets from the units measured.
+//! A case without a budget fails, so new cases are measured before they
+//! pass.
+//!
+//! compute_budgets.txt has no budgets yet, so every case fails until they
+//! are measured where the BPF toolchain is installed:
+//! `npm run build:program-c`, then
+//! `UPDATE_COMPUTE_BUDGETS=1 npm run test:compute-units`. CI runs it once
+//! the measured budgets are committed.
+
+use log::{Level, Log, Metadata, Record};
+use solana_program_test::{BanksClient, ProgramTest};
+use solana_sdk::{
+    account::Account,
+    bpf_loader,
+    hash::Hash,
+    instruction::{AccountMeta, Instruction},
+    pubkey::Pubkey,
+    rent::Rent,
+    signature::{Keypair, Signer},
+    sysvar,
+    transaction::Transaction,
+};
+use std::{
+    collections::BTreeMap,
+    fs,
+    path::PathBuf,
+    sync::{Arc, Mutex},
+};
+
+// User account sizes, filled halfway with posts before measuring
+const ACCOUNT_SIZES: &[usize] = &[1_024, 10_240, 102_400];
+// sizeof(AccountMetadata) in helloworld.c, the header ahead of the posts
+const ACCOUNT_HEADER_SIZE: usize = 56;
+// Room a post takes beyond its body: the record header, the Clock stamp
+// and the index slot, rounded up
+const POST_OVERHEAD: usize = 24;
+// Petition sizes in signatures, all cast before the petition is finalized
+const PETITION_SIZES: &[usize] = &[2, 16, 128];
+// Body length of the posts that fill accounts and of the measured posts
+const BODY_LENGTH: usize = 96;
+// Most posts written per fill transaction, within the transaction size limit
+const FILL_BATCH: usize = 8;
+// Voters get accounts of this size, enough for the header alone
+const VOTER_ACCOUNT_SIZE: usize = 256;
+// Updated budgets leave this much room over the units measured
+const BUDGET_HEADROOM_PERCENT: u64 = 10;
+
+// Selectors, as defined in helloworld.c
+const POST: u8 = b'P';
+const REPLY: u8 = b'R';
+const LIKE: u8 = b'L';
+const REPORT: u8 = b'X';
+const BATCH: u8 = b'B';
+const VOTE: u8 = b'V';
+const CREATE_PETITION: u8 = b'C';
+const PROCESS_PETITION: u8 = b'F';
+const SET_USERNAME: u8 = b's';
+
+// Size of a petition account holding n signatures, mirroring
+// PETITION_ACCOUNT_SIZE in helloworld.c: the header, the vote bitset and a
+// column of signer keys and hash slots
+fn petition_account_size(n: usize) -> usize {
+    56 + (n + 63) / 64 * 8 + n * (32 + 2 * 2)
+}
+
+// Collects the runtime's log, where the BPF loader reports the units each
+// program invocation consumed
+struct RuntimeLog {
+    messages: Arc<Mutex<Vec<String>>>,
+}
+
+impl Log for RuntimeLog {
+    fn enabled(&self, metadata: &Metadata) -> bool {
+        metadata.level() <= Level::Debug
+    }
+
+    fn log(&self, record: &Record) {
+        let message = record.args().to_string();
+        if message.contains(" consumed ") {
+            self.messages.lock().unwrap().push(message);
+        }
+    }
+
+    fn flush(&self) {}
+}
+
+struct Forum {
+    banks_client: BanksClient,
+    payer: Keypair,
+    recent_blockhash: Hash,
+    program_id: Pubkey,
+    messages: Arc<Mutex<Vec<String>>>,
+}
+
+impl Forum {
+    // Runs the instructions in one transaction, panicking if it fails, and
+    // returns the units consumed by the last program invocation
+    async fn run(&mut self, name: &str, instructions: &[Instruction], signers: &[&Keypair]) -> u64 {
+        self.messages.lock().unwrap().clear();
+        let mut transaction = Transaction::new_with_payer(instructions, Some(&self.payer.pubkey()));
+        let mut keypairs = vec![&self.payer];
+        keypairs.extend_from_slice(signers);
+        transaction.sign(&keypairs, self.recent_blockhash);
+        if let Err(error) = self.banks_client.process_transaction(transaction).await {
+            panic!("{} failed: {:?}", name, error);
+        }
+        let messages = self.messages.lock().unwrap();
+        let consumed = messages.last().and_then(|message| {
+            message
+                .split(" consumed ")
+                .nth(1)?
+                .split_whitespace()
+                .next()?
+                .parse()
+                .ok()
+        });
+        consumed.unwrap_or_else(|| panic!("{}: the runtime did not log the units consumed", name))
+    }
+
+    fn instruction(&self, data: Vec<u8>, accounts: Vec<AccountMeta>) -> Instruction {
+        Instruction {
+            program_id: self.program_id,
+            accounts,
+            data,
+        }
+    }
+
+    // The poster signs, and the Clock stamps what it writes
+    fn post(&self, poster: &Keypair, data: Vec<u8>) -> Instruction {
+        self.instruction(
+            data,
+            vec![
+                AccountMeta::new(poster.pubkey(), true),
+                AccountMeta::new_readonly(sysvar::clock::id(), false),
+            ],
+        )
+    }
+}
+
+fn add_account(program_test: &mut ProgramTest, key: Pubkey, size: usize, owner: Pubkey) {
+    program_test.add_account(
+        key,
+        Account {
+            lamports: Rent::default().minimum_balance(size),
+            data: vec![0; size],
+            owner,
+            ..Account::default()
+        },
+    );
+}
+
+// Post body, distinct per tag so that no two transactions are identical
+fn body(tag: usize) -> Vec<u8> {
+    let mut body = format!("post {} ", tag).into_bytes();
+    body.resize(BODY_LENGTH, b'b');
+    body
+}
+
+fn post(tag: usize) -> Vec<u8> {
+    let mut data = vec![POST];
+    data.extend_from_slice(&body(tag));
+    data
+}
+
+// A reply, like or report of post index of poster
+fn reference(selector: u8, poster: &Pubkey, index: u32, tag: usize) -> Vec<u8> {
+    let mut data = vec![selector];
+    data.extend_from_slice(poster.as_ref());
+    data.extend_from_slice(&index.to_le_bytes());
+    if selector != LIKE {
+        data.extend_from_slice(&body(tag));
+    }
+    data
+}
+
+// count posts in one batch instruction
+fn post_batch(tag: usize, count: usize) -> Vec<u8> {
+    let mut data = vec![BATCH];
+    for i in 0..count {
+        let mut post = vec![POST];
+        post.extend_from_slice(&body(tag + i));
+        data.extend_from_slice(&(post.len() as u16).to_le_bytes());
+        data.extend_from_slice(&post);
+    }
+    data
+}
+
+fn budgets_path() -> PathBuf {
+    PathBuf::from(env!("CARGO_MANIFEST_DIR")).join("tests/compute_budgets.txt")
+}
+
+// Budgets by case name, from lines of "SELECTOR SIZE UNITS"
+fn read_budgets() -> BTreeMap<String, u64> {
+    let text = fs::read_to_string(budgets_path()).expect("tests/compute_budgets.txt");
+    let mut budgets = BTreeMap::new();
+    for line in text.lines().map(str::trim) {
+        if line.is_empty() || line.starts_with('#') {
+            continue;
+        }
+        let fields: Vec<&str> = line.split_whitespace().collect();
+        let units = fields
+            .get(2)
+            .and_then(|units| units.parse().ok())
+            .unwrap_or_else(|| panic!("Malformed budget: {}", line));
+        budgets.insert(format!("{} {}", fields[0], fields[1]), units);
+    }
+    budgets
+}
+
+fn write_budgets(measured: &[(String, u64)]) {
+    let mut text = String::from(
+        "# Compute unit budgets of the C program, checked by tests/compute_units.rs\n\
+         # Regenerate with UPDATE_COMPUTE_BUDGETS=1 after reviewing the change in units\n\
+         # selector  size  units\n",
+    );
+    for (case, units) in measured {
+        let budget = (units * (100 + BUDGET_HEADROOM_PERCENT) / 100 + 99) / 100 * 100;
+        text.push_str(&format!("{} {}\n", case, budget));
+    }
+    fs::write(budgets_path(), text).expect("tests/compute_budgets.txt");
+}
+
+// Ignored by default, as it needs the C program built rather than the Rust
+// one that `cargo test-bpf` builds. Run it with
+// `npm run test:compute-units`, which passes --ignored, once the C program
+// is in dist/program.
+#[tokio::test]
+#[ignore]
+async fn test_compute_units() {
+    let messages = Arc::new(Mutex::new(Vec::new()));
+    // Installed first, so the program test's own logger setup leaves it be
+    log::set_boxed_logger(Box::new(RuntimeLog {
+        messages: messages.clone(),
+    }))
+    .expect("logger");
+    log::set_max_level(log::LevelFilter::Debug);
+
+    let program_path =
+        PathBuf::from(env!("CARGO_MANIFEST_DIR")).join("../../dist/program/helloworld.so");
+    let program = fs::read(&program_path).unwrap_or_else(|_| {
+        panic!(
+            "{} not found, build it with npm run build:program-c",
+            program_path.display()
+        )
+    });
+
+    let program_id = Pubkey::new_unique();
+    let mut program_test = ProgramTest::default();
+    program_test.add_account(
+        program_id,
+        Account {
+            lamports: Rent::default().minimum_balance(program.len()).max(1),
+            data: program,
+            owner: bpf_loader::id(),
+            executable: true,
+            ..Account::default()
+        },
+    );
+
+    let posters: Vec<Keypair> = ACCOUNT_SIZES.iter().map(|_| Keypair::new()).collect();
+    for (poster, &size) in posters.iter().zip(ACCOUNT_SIZES) {
+        add_account(&mut program_test, poster.pubkey(), size, program_id);
+    }
+    // Each petition has its own offender, whose reputation it alone changes
+    let offenders: Vec<Keypair> = PETITION_SIZES.iter().map(|_| Keypair::new()).collect();
+    for offender in &offenders {
+        add_account(
+            &mut program_test,
+            offender.pubkey(),
+            ACCOUNT_SIZES[0],
+            program_id,
+        );
+    }
+    let petitions: Vec<Keypair> = PETITION_SIZES.iter().map(|_| Keypair::new()).collect();
+    let mut voters = Vec::new();
+    for (petition, &size) in petitions.iter().zip(PETITION_SIZES) {
+        add_account(
+            &mut program_test,
+            petition.pubkey(),
+            petition_account_size(size),
+            program_id,
+        );
+        let petition_voters: Vec<Keypair> = (0..size).map(|_| Keypair::new()).collect();
+        for voter in &petition_voters {
+            add_account(
+                &mut program_test,
+                voter.pubkey(),
+                VOTER_ACCOUNT_SIZE,
+                program_id,
+            );
+        }
+        voters.push(petition_voters);
+    }
+
+    let (banks_client, payer, recent_blockhash) = program_test.start().await;
+    let mut forum = Forum {
+        banks_client,
+        payer,
+        recent_blockhash,
+        program_id,
+        messages,
+    };
+    let mut measured = Vec::new();
+    let mut tag = 0;
+
+    // Posts and reactions by users whose accounts are half full
+    for (poster, &size) in posters.iter().zip(ACCOUNT_SIZES) {
+        // Even the smallest account takes a few posts, so fill in batches
+        // of up to FILL_BATCH rather than whole ones
+        let mut remaining = (size / 2 - ACCOUNT_HEADER_SIZE) / (BODY_LENGTH + POST_OVERHEAD);
+        while remaining > 0 {
+            let count = remaining.min(FILL_BATCH);
+            let fill = forum.post(poster, post_batch(tag, count));
+            forum.run("fill", &[fill], &[poster]).await;
+            remaining -= count;
+            tag += count;
+        }
+        let key = poster.pubkey();
+        let cases = vec![
+            (POST, post(tag)),
+            (REPLY, reference(REPLY, &key, 0, tag + 1)),
+            (LIKE, reference(LIKE, &key, 0, tag + 2)),
+            (REPORT, reference(REPORT, &key, 0, tag + 3)),
+            (SET_USERNAME, format!("suser{}", size).into_bytes()),
+        ];
+        tag += cases.len();
+        for (selector, data) in cases {
+            let name = format!("{} {}", selector as char, size);
+            let instruction = forum.post(poster, data);
+            let units = forum.run(&name, &[instruction], &[poster]).await;
+            measured.push((name, units));
+        }
+    }
+
+    // Petitions against a post, from creation through the last vote to
+    // finalizing them once full
+    for (i, &size) in PETITION_SIZES.iter().enumerate() {
+        let (offender, petition) = (&offenders[i], &petitions[i]);
+        let offending = forum.post(offender, post(tag + i));
+        forum.run("offending post", &[offending], &[offender]).await;
+
+        let mut data = vec![CREATE_PETITION];
+        data.extend_from_slice(&0u32.to_le_bytes());
+        let create = forum.instruction(
+            data,
+            vec![
+                AccountMeta::new(petition.pubkey(), true),
+                AccountMeta::new_readonly(offender.pubkey(), false),
+            ],
+        );
+        let name = format!("{} {}", CREATE_PETITION as char, size);
+        let units = forum.run(&name, &[create], &[petition]).await;
+        measured.push((name, units));
+
+        for (v, voter) in voters[i].iter().enumerate() {
+            let vote = forum.instruction(
+                vec![VOTE, (v % 3 != 0 || v + 1 == size) as u8],
+                vec![
+                    AccountMeta::new(voter.pubkey(), true),
+                    AccountMeta::new(petition.pubkey(), false),
+                ],
+            );
+            let name = format!("{} {}", VOTE as char, size);
+            let units = forum.run(&name, &[vote], &[voter]).await;
+            if v + 1 == size {
+                measured.push((name, units));
+            }
+        }
+
+        // Finalizing alone, without the voters' accounts
+        let process = forum.instruction(
+            vec![PROCESS_PETITION],
+            vec![
+                AccountMeta::new(petition.pubkey(), false),
+                AccountMeta::new(offender.pubkey(), false),
+            ],
+        );
+        let name = format!("{} {}", PROCESS_PETITION as char, size);
+        let units = forum.run(&name, &[process], &[]).await;
+        measured.push((name, units));
+    }
+
+    if std::env::var("UPDATE_COMPUTE_BUDGETS").is_ok() {
+        write_budgets(&measured);
+        return;
+    }
+    let budgets = read_budgets();
+    let mut over = Vec::new();
+    println!("{:<12} {:>10} {:>10}", "case", "units", "budget");
+    for (case, units) in &measured {
+        let budget = budgets.get(case).copied();
+        println!(
+            "{:<12} {:>10} {:>10}",
+            case,
+            units,
+            budget.map_or("none".into(), |b| b.to_string())
+        );
+        if budget.map_or(true, |budget| *units > budget) {
+            over.push(case.as_str());
+        }
+    }
+    assert!(
+        over.is_empty(),
+        "Over budget or without one: {}. Rerun with UPDATE_COMPUTE_BUDGETS=1 if the increase is intended.",
+        over.join(", ")
+    );
+}